@@ -36,6 +36,9 @@
 #endif
 
 #include "polkitmatelistener.h"
+#include "polkitmateprofiler.h"
+#include "polkitmateuserhistory.h"
+#include "polkitmatewarmup.h"
 
 /* session management support for auto-restart */
 #define SM_DBUS_NAME      "org.gnome.SessionManager"
@@ -43,6 +46,9 @@
 #define SM_DBUS_INTERFACE "org.gnome.SessionManager"
 #define SM_CLIENT_DBUS_INTERFACE "org.gnome.SessionManager.ClientPrivate"
 
+/* longest we hold up the end of the session, in milliseconds */
+#define SHUTDOWN_TIMEOUT 2000
+
 /* the Authority */
 static PolkitAuthority *authority = NULL;
 
@@ -63,6 +69,11 @@ static GDBusProxy      *client_proxy = NULL;
 
 static  GMainLoop *loop;
 
+static PolkitAgentListener *listener = NULL;
+
+/* monotonic time the session end was signalled, 0 before that */
+static gint64 shutdown_started = 0;
+
 static void
 revoke_tmp_authz_cb (GObject      *source_object,
                      GAsyncResult *res,
@@ -269,47 +280,101 @@ on_authority_changed (PolkitAuthority *authority,
 }
 
 static void
-stop_cb (void)
+quit_after_shutdown (void)
 {
+        g_debug ("Handled the end of the session in %.1f ms",
+                 (g_get_monotonic_time () - shutdown_started) / 1000.0);
         g_main_loop_quit (loop);
 }
 
 static gboolean
-end_session_response (gboolean is_okay, const gchar *reason)
+shutdown_timeout_cb (gpointer user_data)
 {
-        GVariant *res;
+        g_warning ("Session manager did not answer within %d ms, exiting anyway",
+                   SHUTDOWN_TIMEOUT);
+        quit_after_shutdown ();
+        return G_SOURCE_REMOVE;
+}
+
+static gboolean
+shutdown_idle_cb (gpointer user_data)
+{
+        quit_after_shutdown ();
+        return G_SOURCE_REMOVE;
+}
+
+/* answers all outstanding requests and kills the helpers right away, so
+ * that nothing is left for the main loop but sending out the replies */
+static void
+begin_shutdown (void)
+{
+        if (shutdown_started > 0)
+                return;
+        shutdown_started = g_get_monotonic_time ();
+
+        if (listener != NULL)
+                polkit_mate_listener_shutdown (POLKIT_MATE_LISTENER (listener));
+
+        g_timeout_add (SHUTDOWN_TIMEOUT, shutdown_timeout_cb, NULL);
+}
+
+static void
+stop_cb (void)
+{
+        begin_shutdown ();
+        /* let the completions queued by the shutdown run first */
+        g_idle_add_full (G_PRIORITY_LOW, shutdown_idle_cb, NULL, NULL);
+}
+
+static void
+end_session_response_cb (GObject      *source_object,
+                         GAsyncResult *res,
+                         gpointer      user_data)
+{
+        gboolean quit = GPOINTER_TO_INT (user_data);
+        GVariant *ret;
         GError *error = NULL;
 
-        res = g_dbus_proxy_call_sync (client_proxy,
-                                      "EndSessionResponse",
-                                      g_variant_new ("(bs)",
-                                                     is_okay,
-                                                     reason),
-                                      G_DBUS_CALL_FLAGS_NONE,
-                                      -1, /* timeout */
-                                      NULL, /* GCancellable */
-                                      &error);
-        if (! res) {
+        ret = g_dbus_proxy_call_finish (G_DBUS_PROXY (source_object), res, &error);
+        if (! ret) {
                 g_warning ("Failed to call EndSessionResponse: %s", error->message);
                 g_error_free (error);
-                return FALSE;
+        } else {
+                g_variant_unref (ret);
         }
 
-        g_variant_unref (res);
-        return TRUE;
+        if (quit)
+                quit_after_shutdown ();
+}
+
+/* never blocks; the session manager waits for the answer, not us */
+static void
+end_session_response (gboolean is_okay, const gchar *reason, gboolean quit)
+{
+        g_dbus_proxy_call (client_proxy,
+                           "EndSessionResponse",
+                           g_variant_new ("(bs)",
+                                          is_okay,
+                                          reason),
+                           G_DBUS_CALL_FLAGS_NONE,
+                           SHUTDOWN_TIMEOUT,
+                           NULL, /* GCancellable */
+                           end_session_response_cb,
+                           GINT_TO_POINTER (quit));
 }
 
 static void
 query_end_session_cb (void)
 {
-        end_session_response (TRUE, "");
+        /* the logout may still be cancelled, so keep serving requests */
+        end_session_response (TRUE, "", FALSE);
 }
 
 static void
 end_session_cb (void)
 {
-        end_session_response (TRUE, "");
-        g_main_loop_quit (loop);
+        begin_shutdown ();
+        end_session_response (TRUE, "", TRUE);
 }
 
 static void
@@ -395,15 +460,44 @@ register_client_to_gnome_session (void)
         return TRUE;
 }
 
+static gint opt_max_dialogs = 0;
+static gint opt_max_requests = 0;
+static gint opt_max_requests_per_caller = 0;
+static gint opt_dismissal_window = -1;
+static gint opt_helper_warm_interval = -1;
+static gint opt_helper_idle_timeout = -1;
+static gint opt_max_attempts = 0;
+static gint opt_retry_backoff = -1;
+static gboolean opt_parallel_factors = FALSE;
+
+static const GOptionEntry option_entries[] = {
+  { "max-dialogs", 0, 0, G_OPTION_ARG_INT, &opt_max_dialogs,
+    N_("Maximum number of authentication dialogs shown at the same time"), N_("N") },
+  { "max-requests", 0, 0, G_OPTION_ARG_INT, &opt_max_requests,
+    N_("Maximum number of outstanding authentication requests"), N_("N") },
+  { "max-requests-per-caller", 0, 0, G_OPTION_ARG_INT, &opt_max_requests_per_caller,
+    N_("Maximum number of outstanding authentication requests per process"), N_("N") },
+  { "dismissal-window", 0, 0, G_OPTION_ARG_INT, &opt_dismissal_window,
+    N_("Seconds during which a dismissed request is not asked again, 0 to disable"), N_("SECONDS") },
+  { "helper-warm-interval", 0, 0, G_OPTION_ARG_INT, &opt_helper_warm_interval,
+    N_("Seconds between reading the authentication helper into the page cache, 0 to disable"), N_("SECONDS") },
+  { "helper-idle-timeout", 0, 0, G_OPTION_ARG_INT, &opt_helper_idle_timeout,
+    N_("Seconds after the last request to keep the authentication helper warm"), N_("SECONDS") },
+  { "max-attempts", 0, 0, G_OPTION_ARG_INT, &opt_max_attempts,
+    N_("Number of attempts the user gets to authenticate"), N_("N") },
+  { "retry-backoff", 0, 0, G_OPTION_ARG_INT, &opt_retry_backoff,
+    N_("Milliseconds to wait after a failed attempt, doubled on each further failure"), N_("MILLISECONDS") },
+  { "parallel-factors", 0, 0, G_OPTION_ARG_NONE, &opt_parallel_factors,
+    N_("Offer the password while waiting on a fingerprint reader or smart card"), NULL },
+  { NULL }
+};
+
 int
 main (int argc, char **argv)
 {
   gint ret;
-  PolkitAgentListener *listener;
   GError *error;
 
-  gtk_init (&argc, &argv);
-
   loop = NULL;
   authority = NULL;
   listener = NULL;
@@ -416,6 +510,14 @@ main (int argc, char **argv)
 #endif
   textdomain (GETTEXT_PACKAGE);
 
+  error = NULL;
+  if (!gtk_init_with_args (&argc, &argv, NULL, option_entries, GETTEXT_PACKAGE, &error))
+    {
+      g_printerr ("%s\n", error != NULL ? error->message : "Cannot open display");
+      g_clear_error (&error);
+      return 1;
+    }
+
   loop = g_main_loop_new (NULL, FALSE);
 
   error = NULL;
@@ -431,7 +533,26 @@ main (int argc, char **argv)
                     G_CALLBACK (on_authority_changed),
                     NULL);
 
-  listener = polkit_mate_listener_new ();
+  listener = polkit_mate_listener_new (authority);
+  if (opt_max_dialogs > 0)
+    g_object_set (listener, "max-dialogs", (guint) opt_max_dialogs, NULL);
+  if (opt_max_requests > 0)
+    g_object_set (listener, "max-requests", (guint) opt_max_requests, NULL);
+  if (opt_max_requests_per_caller > 0)
+    g_object_set (listener, "max-requests-per-subject", (guint) opt_max_requests_per_caller, NULL);
+  if (opt_dismissal_window >= 0)
+    g_object_set (listener, "dismissal-window", (guint) opt_dismissal_window, NULL);
+  if (opt_helper_warm_interval >= 0)
+    g_object_set (listener, "helper-warm-interval", (guint) opt_helper_warm_interval, NULL);
+  if (opt_helper_idle_timeout >= 0)
+    g_object_set (listener, "helper-idle-timeout", (guint) opt_helper_idle_timeout, NULL);
+  if (opt_max_attempts > 0)
+    g_object_set (listener, "max-attempts", (guint) opt_max_attempts, NULL);
+  if (opt_retry_backoff >= 0)
+    g_object_set (listener, "retry-backoff",
+                  (guint) MIN (opt_retry_backoff, POLKIT_MATE_LISTENER_MAX_RETRY_BACKOFF), NULL);
+  if (opt_parallel_factors)
+    g_object_set (listener, "parallel-factors", TRUE, NULL);
 
   error = NULL;
   session = polkit_unix_session_new_for_process_sync (getpid (), NULL, &error);
@@ -457,10 +578,30 @@ main (int argc, char **argv)
 
   update_temporary_authorization_icon (authority);
 
+  /* the first dialog of the session should not be slower than the rest */
+  polkit_mate_warmup_start ();
+
   register_client_to_gnome_session();
 
   g_main_loop_run (loop);
 
+  /* the cancelled requests are answered on the system bus; make sure the
+   * replies leave before we do */
+  if (shutdown_started > 0)
+    {
+      GDBusConnection *connection;
+
+      connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL);
+      if (connection != NULL)
+        {
+          g_dbus_connection_flush_sync (connection, NULL, NULL);
+          g_object_unref (connection);
+        }
+    }
+
+  polkit_mate_profiler_flush (polkit_mate_profiler_get_default ());
+  polkit_mate_user_history_flush (polkit_mate_user_history_get_default ());
+
   ret = 0;
 
  out:
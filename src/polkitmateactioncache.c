@@ -0,0 +1,331 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <polkit/polkit.h>
+
+#include "polkitmateactioncache.h"
+
+struct _PolkitMateActionCache
+{
+  GObject parent_instance;
+
+  PolkitAuthority *authority;
+  gulong changed_id;
+
+  /* action_id -> PolkitActionDescription; NULL until the first enumeration finished */
+  GHashTable *index;
+
+  gboolean refresh_in_progress;
+  gboolean refresh_pending;
+
+  /* lookups waiting for the first enumeration to finish */
+  GList *waiting_tasks;
+
+  /* lookups that missed the index, waiting for an enumeration that
+   * started after them; the action may just have been installed */
+  GList *missed_tasks;
+  GList *retry_tasks;
+};
+
+struct _PolkitMateActionCacheClass
+{
+  GObjectClass parent_class;
+};
+
+G_DEFINE_TYPE (PolkitMateActionCache, polkit_mate_action_cache, G_TYPE_OBJECT);
+
+static void refresh (PolkitMateActionCache *cache);
+static void lookup_in_index (PolkitMateActionCache *cache,
+                             GTask                  *task);
+static void complete_tasks (PolkitMateActionCache  *cache,
+                            GList                 **tasks);
+
+static void
+polkit_mate_action_cache_init (PolkitMateActionCache *cache)
+{
+}
+
+static void
+polkit_mate_action_cache_finalize (GObject *object)
+{
+  PolkitMateActionCache *cache;
+
+  cache = POLKIT_MATE_ACTION_CACHE (object);
+
+  if (cache->changed_id > 0)
+    g_signal_handler_disconnect (cache->authority, cache->changed_id);
+  g_object_unref (cache->authority);
+  if (cache->index != NULL)
+    g_hash_table_unref (cache->index);
+
+  if (G_OBJECT_CLASS (polkit_mate_action_cache_parent_class)->finalize != NULL)
+    G_OBJECT_CLASS (polkit_mate_action_cache_parent_class)->finalize (object);
+}
+
+static void
+polkit_mate_action_cache_class_init (PolkitMateActionCacheClass *klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = polkit_mate_action_cache_finalize;
+}
+
+/* takes ownership of @action_descs */
+static GHashTable *
+build_index (GList *action_descs)
+{
+  GHashTable *index;
+  GList *l;
+
+  index = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_object_unref);
+  for (l = action_descs; l != NULL; l = l->next)
+    {
+      PolkitActionDescription *action_desc = POLKIT_ACTION_DESCRIPTION (l->data);
+
+      /* the key is owned by the value */
+      g_hash_table_replace (index,
+                            (gpointer) polkit_action_description_get_action_id (action_desc),
+                            action_desc);
+    }
+  g_list_free (action_descs);
+
+  return index;
+}
+
+static void
+set_index (PolkitMateActionCache *cache,
+           GHashTable             *index)
+{
+  if (cache->index != NULL)
+    g_hash_table_unref (cache->index);
+  cache->index = index;
+}
+
+static void
+enumerate_actions_cb (GObject      *source_object,
+                      GAsyncResult *res,
+                      gpointer      user_data)
+{
+  PolkitMateActionCache *cache = POLKIT_MATE_ACTION_CACHE (user_data);
+  GList *action_descs;
+  GError *error;
+
+  cache->refresh_in_progress = FALSE;
+
+  error = NULL;
+  action_descs = polkit_authority_enumerate_actions_finish (POLKIT_AUTHORITY (source_object),
+                                                            res,
+                                                            &error);
+  if (error != NULL)
+    {
+      g_warning ("Error enumerating actions: %s", error->message);
+      g_error_free (error);
+    }
+  else
+    {
+      set_index (cache, build_index (action_descs));
+    }
+
+  /* complete the lookups that arrived before the index was ready, and
+   * those that missed before this enumeration started */
+  complete_tasks (cache, &cache->waiting_tasks);
+  complete_tasks (cache, &cache->retry_tasks);
+
+  /* the authority changed again while we were enumerating */
+  if (cache->refresh_pending)
+    refresh (cache);
+
+  g_object_unref (cache);
+}
+
+static void
+refresh (PolkitMateActionCache *cache)
+{
+  if (cache->refresh_in_progress)
+    {
+      cache->refresh_pending = TRUE;
+      return;
+    }
+
+  cache->refresh_in_progress = TRUE;
+  cache->refresh_pending = FALSE;
+
+  /* this enumeration sees whatever was installed before the lookups missed */
+  cache->retry_tasks = g_list_concat (cache->retry_tasks, cache->missed_tasks);
+  cache->missed_tasks = NULL;
+
+  /* the old index keeps serving lookups until the new one is ready */
+  polkit_authority_enumerate_actions (cache->authority,
+                                      NULL, /* GCancellable* */
+                                      enumerate_actions_cb,
+                                      g_object_ref (cache));
+}
+
+static void
+on_authority_changed (PolkitAuthority *authority,
+                      gpointer         user_data)
+{
+  PolkitMateActionCache *cache = POLKIT_MATE_ACTION_CACHE (user_data);
+
+  refresh (cache);
+}
+
+/**
+ * polkit_mate_action_cache_new:
+ * @authority: A #PolkitAuthority.
+ *
+ * Creates a cache of the action descriptions known to @authority, indexed by
+ * action id. The cache is filled asynchronously and rebuilt in the background
+ * whenever @authority emits #PolkitAuthority::changed.
+ *
+ * Returns: A new #PolkitMateActionCache.
+ **/
+PolkitMateActionCache *
+polkit_mate_action_cache_new (PolkitAuthority *authority)
+{
+  PolkitMateActionCache *cache;
+
+  cache = POLKIT_MATE_ACTION_CACHE (g_object_new (POLKIT_MATE_TYPE_ACTION_CACHE, NULL));
+
+  cache->authority = g_object_ref (authority);
+  cache->changed_id = g_signal_connect (cache->authority,
+                                        "changed",
+                                        G_CALLBACK (on_authority_changed),
+                                        cache);
+
+  refresh (cache);
+
+  return cache;
+}
+
+static void
+lookup_in_index (PolkitMateActionCache *cache,
+                 GTask                  *task)
+{
+  PolkitActionDescription *action_desc;
+  const gchar *action_id;
+
+  action_id = g_task_get_task_data (task);
+  action_desc = g_hash_table_lookup (cache->index, action_id);
+  if (action_desc == NULL)
+    {
+      g_task_return_new_error (task,
+                               POLKIT_ERROR,
+                               POLKIT_ERROR_FAILED,
+                               "No description for action %s",
+                               action_id);
+      return;
+    }
+
+  g_task_return_pointer (task, g_object_ref (action_desc), g_object_unref);
+}
+
+static void
+complete_tasks (PolkitMateActionCache  *cache,
+                GList                 **tasks)
+{
+  while (*tasks != NULL)
+    {
+      GTask *task = G_TASK ((*tasks)->data);
+
+      *tasks = g_list_delete_link (*tasks, *tasks);
+      if (cache->index != NULL)
+        lookup_in_index (cache, task);
+      else
+        g_task_return_new_error (task,
+                                 POLKIT_ERROR,
+                                 POLKIT_ERROR_FAILED,
+                                 "Unable to enumerate actions");
+      g_object_unref (task);
+    }
+}
+
+/**
+ * polkit_mate_action_cache_lookup:
+ * @cache: A #PolkitMateActionCache.
+ * @action_id: The action to look up.
+ * @cancellable: (allow-none): A #GCancellable or %NULL.
+ * @callback: Function to call when the description is available.
+ * @user_data: Data to pass to @callback.
+ *
+ * Asynchronously looks up the description for @action_id. Once the initial
+ * enumeration has finished this is a plain hash lookup; requests arriving
+ * before that are completed as soon as the index is ready. An action that
+ * is not in the index is looked up again after a fresh enumeration, and
+ * only fails if it is still unknown then.
+ **/
+void
+polkit_mate_action_cache_lookup (PolkitMateActionCache *cache,
+                                 const gchar            *action_id,
+                                 GCancellable           *cancellable,
+                                 GAsyncReadyCallback     callback,
+                                 gpointer                user_data)
+{
+  GTask *task;
+
+  task = g_task_new (G_OBJECT (cache), cancellable, callback, user_data);
+  g_task_set_source_tag (task, polkit_mate_action_cache_lookup);
+  g_task_set_task_data (task, g_strdup (action_id), g_free);
+
+  if (cache->index == NULL)
+    {
+      /* completed by the initial enumeration; retry it only if it failed */
+      cache->waiting_tasks = g_list_append (cache->waiting_tasks, task);
+      if (!cache->refresh_in_progress)
+        refresh (cache);
+      return;
+    }
+
+  if (!g_hash_table_contains (cache->index, action_id))
+    {
+      cache->missed_tasks = g_list_append (cache->missed_tasks, task);
+      refresh (cache);
+      return;
+    }
+
+  lookup_in_index (cache, task);
+  g_object_unref (task);
+}
+
+/**
+ * polkit_mate_action_cache_lookup_finish:
+ * @cache: A #PolkitMateActionCache.
+ * @res: A #GAsyncResult obtained from the #GAsyncReadyCallback passed to polkit_mate_action_cache_lookup().
+ * @error: (allow-none): Return location for error or %NULL.
+ *
+ * Finishes looking up an action description.
+ *
+ * Returns: A #PolkitActionDescription (free with g_object_unref()) or %NULL
+ *          if @error is set.
+ **/
+PolkitActionDescription *
+polkit_mate_action_cache_lookup_finish (PolkitMateActionCache *cache,
+                                        GAsyncResult           *res,
+                                        GError                **error)
+{
+  GTask *task = G_TASK (res);
+
+  g_warn_if_fail (g_task_get_source_tag (task) == polkit_mate_action_cache_lookup);
+
+  return g_task_propagate_pointer (task, error);
+}
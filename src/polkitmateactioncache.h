@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __POLKIT_MATE_ACTION_CACHE_H
+#define __POLKIT_MATE_ACTION_CACHE_H
+
+#include <gio/gio.h>
+#include <polkit/polkit.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POLKIT_MATE_TYPE_ACTION_CACHE          (polkit_mate_action_cache_get_type())
+#define POLKIT_MATE_ACTION_CACHE(o)            (G_TYPE_CHECK_INSTANCE_CAST ((o), POLKIT_MATE_TYPE_ACTION_CACHE, PolkitMateActionCache))
+#define POLKIT_MATE_ACTION_CACHE_CLASS(k)      (G_TYPE_CHECK_CLASS_CAST((k), POLKIT_MATE_TYPE_ACTION_CACHE, PolkitMateActionCacheClass))
+#define POLKIT_MATE_ACTION_CACHE_GET_CLASS(o)  (G_TYPE_INSTANCE_GET_CLASS ((o), POLKIT_MATE_TYPE_ACTION_CACHE, PolkitMateActionCacheClass))
+#define POLKIT_MATE_IS_ACTION_CACHE(o)         (G_TYPE_CHECK_INSTANCE_TYPE ((o), POLKIT_MATE_TYPE_ACTION_CACHE))
+#define POLKIT_MATE_IS_ACTION_CACHE_CLASS(k)   (G_TYPE_CHECK_CLASS_TYPE ((k), POLKIT_MATE_TYPE_ACTION_CACHE))
+
+typedef struct _PolkitMateActionCache PolkitMateActionCache;
+typedef struct _PolkitMateActionCacheClass PolkitMateActionCacheClass;
+
+GType                     polkit_mate_action_cache_get_type      (void) G_GNUC_CONST;
+PolkitMateActionCache   *polkit_mate_action_cache_new           (PolkitAuthority        *authority);
+void                      polkit_mate_action_cache_lookup        (PolkitMateActionCache *cache,
+                                                                   const gchar            *action_id,
+                                                                   GCancellable           *cancellable,
+                                                                   GAsyncReadyCallback     callback,
+                                                                   gpointer                user_data);
+PolkitActionDescription  *polkit_mate_action_cache_lookup_finish (PolkitMateActionCache *cache,
+                                                                   GAsyncResult           *res,
+                                                                   GError                **error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __POLKIT_MATE_ACTION_CACHE_H */
@@ -37,14 +37,27 @@
 
 #include <glib/gi18n-lib.h>
 #include <gtk/gtk.h>
+#include <cairo-gobject.h>
 
 #include "polkitmateauthenticationdialog.h"
-
-#define RESPONSE_USER_SELECTED 1001
+#include "polkitmatesecretbuffer.h"
+#include "polkitmateuserlistmodel.h"
 
 struct _PolkitMateAuthenticationDialogPrivate
 {
-  GtkWidget *user_combobox;
+  /* the parts of the widget tree that depend on the request, see bind() */
+  GtkWidget *image;
+  GtkWidget *message_label;
+  GtkWidget *secondary_label;
+  GtkWidget *details_expander;
+  GtkWidget *details_grid;
+
+  /* the user picker, only shown when there is a choice */
+  GtkWidget *user_picker;
+  GtkWidget *user_search_entry;
+  GtkWidget *user_view;
+  gulong user_selection_changed_id;
+  gulong user_row_inserted_id;
   GtkWidget *prompt_label;
   GtkWidget *password_entry;
   GtkWidget *auth_button;
@@ -52,6 +65,10 @@ struct _PolkitMateAuthenticationDialogPrivate
   GtkWidget *info_label;
   GtkWidget *grid_password;
 
+  /* entries for the prompts expected after the current one, see
+   * polkit_mate_authentication_dialog_add_followup_prompt() */
+  GPtrArray *followup_entries;
+
   gchar *message;
   gchar *action_id;
   gchar *vendor;
@@ -62,11 +79,39 @@ struct _PolkitMateAuthenticationDialogPrivate
   gchar **users;
   gchar *selected_user;
 
-  gboolean is_running;
+  PolkitMateUserListModel *user_model;
 
-  GtkListStore *store;
+  /* stops filling the user list and loading pictures for it */
+  GCancellable *avatar_cancellable;
+
+  /* state of the error animation */
+  guint shake_source_id;
+  gint shake_step;
+  gint shake_x;
+  gint shake_y;
+
+  /* how far to cascade the window from the centre of the screen */
+  guint stack_position;
 };
 
+/* a hidden, realized dialog waiting for the next request, see
+ * polkit_mate_authentication_dialog_obtain() */
+static GtkWidget *spare_dialog = NULL;
+
+/* size of the user pictures in the user picker */
+/* TODO: we probably shouldn't hard-code the size to 16x16 */
+#define USER_ICON_SIZE 16
+
+/* number of users above which the user picker can be searched */
+#define USER_SEARCH_THRESHOLD 8
+
+/* height in pixels of the user picker before it starts scrolling */
+#define USER_PICKER_MAX_HEIGHT 150
+
+/* distance in pixels between cascaded dialogs */
+#define CASCADE_OFFSET 32
+#define MAX_CASCADE_STEPS 8
+
 G_DEFINE_TYPE_WITH_PRIVATE (PolkitMateAuthenticationDialog, polkit_mate_authentication_dialog, GTK_TYPE_DIALOG);
 
 enum {
@@ -81,322 +126,311 @@ enum {
   PROP_SELECTED_USER,
 };
 
-enum {
-  PIXBUF_COL,
-  TEXT_COL,
-  USERNAME_COL,
-  N_COL
-};
-
-static void
-user_combobox_set_sensitive (GtkCellLayout   *cell_layout,
-                             GtkCellRenderer *cell,
-                             GtkTreeModel    *tree_model,
-                             GtkTreeIter     *iter,
-                             gpointer         user_data)
-{
-  GtkTreePath *path;
-  gint *indices;
-  gboolean sensitive;
-
-  path = gtk_tree_model_get_path (tree_model, iter);
-  indices = gtk_tree_path_get_indices (path);
-  if (indices[0] == 0)
-    sensitive = FALSE;
-  else
-    sensitive = TRUE;
-  gtk_tree_path_free (path);
-
-  g_object_set (cell, "sensitive", sensitive, NULL);
-}
-
 static void
-user_combobox_changed (GtkComboBox *widget,
-                       gpointer     user_data)
+user_selection_changed (GtkTreeSelection *selection,
+                        gpointer          user_data)
 {
   PolkitMateAuthenticationDialog *dialog = POLKIT_MATE_AUTHENTICATION_DIALOG (user_data);
+  GtkTreeModel *model;
   GtkTreeIter iter;
   gchar *user_name;
 
-  if (gtk_combo_box_get_active_iter (GTK_COMBO_BOX (widget), &iter))
-    {
-      gtk_tree_model_get (GTK_TREE_MODEL (dialog->priv->store), &iter, USERNAME_COL, &user_name, -1);
+  /* a row filtered out by the search does not undo the choice */
+  if (!gtk_tree_selection_get_selected (selection, &model, &iter))
+    return;
 
-      g_free (dialog->priv->selected_user);
-      dialog->priv->selected_user = user_name;
+  gtk_tree_model_get (model, &iter, POLKIT_MATE_USER_LIST_COLUMN_USER, &user_name, -1);
+  if (g_strcmp0 (user_name, dialog->priv->selected_user) == 0)
+    {
+      g_free (user_name);
+      return;
+    }
 
-      g_object_notify (G_OBJECT (dialog), "selected-user");
+  g_free (dialog->priv->selected_user);
+  dialog->priv->selected_user = user_name;
 
-      gtk_dialog_response (GTK_DIALOG (dialog), RESPONSE_USER_SELECTED);
+  g_object_notify (G_OBJECT (dialog), "selected-user");
 
-      /* make the password entry and Authenticate button sensitive again */
-      gtk_widget_set_sensitive (dialog->priv->prompt_label, TRUE);
-      gtk_widget_set_sensitive (dialog->priv->password_entry, TRUE);
-      gtk_widget_set_sensitive (dialog->priv->auth_button, TRUE);
-    }
+  /* make the password entry and Authenticate button sensitive again */
+  gtk_widget_set_sensitive (dialog->priv->prompt_label, TRUE);
+  gtk_widget_set_sensitive (dialog->priv->password_entry, TRUE);
+  gtk_widget_set_sensitive (dialog->priv->auth_button, TRUE);
 }
 
-#if HAVE_ACCOUNTSSERVICE
-static GdkPixbuf *
-get_user_icon (char *username)
+/* selects @iter without it counting as a choice made by the user */
+static void
+select_user_row (PolkitMateAuthenticationDialog *dialog,
+                 GtkTreeIter                     *iter)
 {
-  GError *error;
-  GDBusConnection *connection;
-  GVariant *find_user_result;
-  GVariant *get_icon_result;
-  GVariant *icon_result_variant;
-  const gchar *user_path;
-  const gchar *icon_filename;
-  GdkPixbuf *pixbuf = NULL;
+  GtkTreeView *view = GTK_TREE_VIEW (dialog->priv->user_view);
+  GtkTreeSelection *selection;
+  GtkTreePath *path;
 
-  error = NULL;
-  connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+  selection = gtk_tree_view_get_selection (view);
+  g_signal_handler_block (selection, dialog->priv->user_selection_changed_id);
+  gtk_tree_selection_select_iter (selection, iter);
+  g_signal_handler_unblock (selection, dialog->priv->user_selection_changed_id);
 
-  if (connection == NULL)
-    {
-      g_warning ("Unable to connect to system bus: %s", error->message);
-      g_error_free (error);
-      return NULL;
-    }
+  path = gtk_tree_model_get_path (gtk_tree_view_get_model (view), iter);
+  gtk_tree_view_scroll_to_cell (view, path, NULL, FALSE, 0.0, 0.0);
+  gtk_tree_path_free (path);
+}
 
-  find_user_result = g_dbus_connection_call_sync (connection,
-                                          "org.freedesktop.Accounts",
-                                          "/org/freedesktop/Accounts",
-                                          "org.freedesktop.Accounts",
-                                          "FindUserByName",
-                                          g_variant_new ("(s)",
-                                          username),
-                                          G_VARIANT_TYPE ("(o)"),
-                                          G_DBUS_CALL_FLAGS_NONE,
-                                          -1,
-                                          NULL,
-                                          &error);
-
-  if (find_user_result == NULL)
-    {
-      g_warning ("Accounts couldn't find user: %s", error->message);
-      g_error_free (error);
-      g_object_unref (connection);
-      return NULL;
-    }
+static void
+select_selected_user (PolkitMateAuthenticationDialog *dialog)
+{
+  GtkTreeIter iter;
 
-  user_path = g_variant_get_string (g_variant_get_child_value (find_user_result, 0),
-                                    NULL);
-
-  get_icon_result = g_dbus_connection_call_sync (connection,
-                                                 "org.freedesktop.Accounts",
-                                                 user_path,
-                                                 "org.freedesktop.DBus.Properties",
-                                                 "Get",
-                                                 g_variant_new ("(ss)",
-                                                                "org.freedesktop.Accounts.User",
-                                                                "IconFile"),
-                                                 G_VARIANT_TYPE ("(v)"),
-                                                 G_DBUS_CALL_FLAGS_NONE,
-                                                 -1,
-                                                 NULL,
-                                                 &error);
-
-  g_variant_unref (find_user_result);
-
-  if (get_icon_result == NULL)
-    {
-      g_warning ("Accounts couldn't find user icon: %s", error->message);
-      g_error_free (error);
-      g_object_unref (connection);
-      return NULL;
-    }
+  if (dialog->priv->selected_user != NULL &&
+      polkit_mate_user_list_model_find_user (dialog->priv->user_model, dialog->priv->selected_user, &iter))
+    select_user_row (dialog, &iter);
+}
 
-  g_variant_get_child (get_icon_result, 0, "v", &icon_result_variant);
-  icon_filename = g_variant_get_string (icon_result_variant, NULL);
+/* the list is filled while the dialog is shown, select the user we
+ * preselected as soon as it arrives */
+static void
+user_row_inserted (GtkTreeModel *model,
+                   GtkTreePath  *path,
+                   GtkTreeIter  *iter,
+                   gpointer      user_data)
+{
+  PolkitMateAuthenticationDialog *dialog = POLKIT_MATE_AUTHENTICATION_DIALOG (user_data);
+  GtkTreeSelection *selection;
+  gchar *user_name;
 
-  if (icon_filename == NULL)
-    {
-      g_warning ("Accounts didn't return a valid filename for user icon");
-    }
-  else
-    {
-      /* TODO: we probably shouldn't hard-code the size to 16x16 */
-      pixbuf = gdk_pixbuf_new_from_file_at_size (icon_filename,
-                                                 16,
-                                                 16,
-                                                 &error);
-      if (pixbuf == NULL)
-        {
-          g_warning ("Couldn't open user icon: %s", error->message);
-          g_error_free (error);
-        }
-    }
+  if (dialog->priv->selected_user == NULL)
+    return;
 
-  g_variant_unref (icon_result_variant);
-  g_variant_unref (get_icon_result);
-  g_object_unref (connection);
+  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (dialog->priv->user_view));
+  if (gtk_tree_selection_count_selected_rows (selection) > 0)
+    return;
 
-  return pixbuf;
+  gtk_tree_model_get (model, iter, POLKIT_MATE_USER_LIST_COLUMN_USER, &user_name, -1);
+  if (g_strcmp0 (user_name, dialog->priv->selected_user) == 0)
+    select_user_row (dialog, iter);
+  g_free (user_name);
 }
-#else
-static GdkPixbuf *
-get_user_icon (char *username)
+
+static void
+user_search_changed (GtkSearchEntry *entry,
+                     gpointer        user_data)
 {
-  GdkPixbuf *pixbuf = NULL;
-  struct passwd *passwd;
+  PolkitMateAuthenticationDialog *dialog = POLKIT_MATE_AUTHENTICATION_DIALOG (user_data);
+  GtkTreeView *view = GTK_TREE_VIEW (dialog->priv->user_view);
+  GtkTreeSelection *selection;
 
-  passwd = getpwnam (username);
-  if (passwd->pw_dir != NULL)
-    {
-      gchar *path;
-      path = g_strdup_printf ("%s/.face", passwd->pw_dir);
-      /* TODO: we probably shouldn't hard-code the size to 16x16 */
-      pixbuf = gdk_pixbuf_new_from_file_at_scale (path, 16, 16, TRUE, NULL);
-      g_free (path);
-    }
+  if (dialog->priv->user_model == NULL)
+    return;
 
-  return pixbuf;
+  /* a detached view is laid out once afterwards rather than once per
+   * row that comes or goes */
+  selection = gtk_tree_view_get_selection (view);
+  g_signal_handler_block (selection, dialog->priv->user_selection_changed_id);
+  g_signal_handler_block (dialog->priv->user_model, dialog->priv->user_row_inserted_id);
+  gtk_tree_view_set_model (view, NULL);
+  polkit_mate_user_list_model_set_filter (dialog->priv->user_model,
+                                          gtk_entry_get_text (GTK_ENTRY (entry)));
+  gtk_tree_view_set_model (view, GTK_TREE_MODEL (dialog->priv->user_model));
+  g_signal_handler_unblock (dialog->priv->user_model, dialog->priv->user_row_inserted_id);
+  g_signal_handler_unblock (selection, dialog->priv->user_selection_changed_id);
+
+  select_selected_user (dialog);
 }
-#endif /* HAVE_ACCOUNTSSERVICE */
 
 static void
-create_user_combobox (PolkitMateAuthenticationDialog *dialog)
+user_search_activate (GtkEntry *entry,
+                      gpointer  user_data)
 {
-  int n, i, selected_index = 0;
-  GtkComboBox *combo;
+  PolkitMateAuthenticationDialog *dialog = POLKIT_MATE_AUTHENTICATION_DIALOG (user_data);
+  GtkTreeSelection *selection;
   GtkTreeIter iter;
-  GtkCellRenderer *renderer;
 
-  /* if we've already built the list of admin users once, then avoid
-   * doing it again.. (this is mainly used when the user entered the
-   * wrong password and the dialog is recycled)
-   */
-  if (dialog->priv->store != NULL)
-    return;
-
-  combo = GTK_COMBO_BOX (dialog->priv->user_combobox);
-  dialog->priv->store = gtk_list_store_new (3, GDK_TYPE_PIXBUF, G_TYPE_STRING, G_TYPE_STRING);
-
-  gtk_list_store_append (dialog->priv->store, &iter);
-  gtk_list_store_set (dialog->priv->store, &iter,
-                      PIXBUF_COL, NULL,
-                      TEXT_COL, _("Select user..."),
-                      USERNAME_COL, NULL,
-                      -1);
-
-  /* For each user */
-  for (i = 0, n = 0; dialog->priv->users[n] != NULL; n++)
-  {
-      gchar *gecos;
-      gchar *real_name;
-      GdkPixbuf *pixbuf = NULL;
-      struct passwd *passwd;
-
-      /* we're single threaded so this is fine */
-      errno = 0;
-      passwd = getpwnam (dialog->priv->users[n]);
-      if (passwd == NULL)
-        {
-          g_warning ("Error doing getpwnam(\"%s\"): %s", dialog->priv->users[n], strerror (errno));
-          continue;
-        }
+  /* Enter picks the first match unless one was chosen already */
+  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (dialog->priv->user_view));
+  if (gtk_tree_selection_count_selected_rows (selection) == 0 &&
+      gtk_tree_model_get_iter_first (GTK_TREE_MODEL (dialog->priv->user_model), &iter))
+    gtk_tree_selection_select_iter (selection, &iter);
 
-      if (passwd->pw_gecos != NULL)
-        gecos = g_locale_to_utf8 (passwd->pw_gecos, -1, NULL, NULL, NULL);
-      else
-        gecos = NULL;
-
-      if (gecos != NULL && strlen (gecos) > 0)
-        {
-          gchar *first_comma;
-          first_comma = strchr (gecos, ',');
-          if (first_comma != NULL)
-            *first_comma = '\0';
-        }
-      if (gecos != NULL && strlen (gecos) > 0 && strcmp (gecos, dialog->priv->users[n]) != 0)
-        real_name = g_strdup_printf (_("%s (%s)"), gecos, dialog->priv->users[n]);
-       else
-         real_name = g_strdup (dialog->priv->users[n]);
-      g_free (gecos);
+  if (gtk_widget_is_sensitive (dialog->priv->password_entry))
+    gtk_widget_grab_focus (dialog->priv->password_entry);
+}
 
-      /* Load users face */
-      pixbuf = get_user_icon (dialog->priv->users[n]);
+static void
+user_row_activated (GtkTreeView       *view,
+                    GtkTreePath       *path,
+                    GtkTreeViewColumn *column,
+                    gpointer           user_data)
+{
+  PolkitMateAuthenticationDialog *dialog = POLKIT_MATE_AUTHENTICATION_DIALOG (user_data);
 
-      /* fall back to stock_person icon */
-      if (pixbuf == NULL)
-        {
-          pixbuf = gtk_icon_theme_load_icon (gtk_icon_theme_get_default (),
-                                             "stock_person",
-                                             GTK_ICON_SIZE_MENU,
-                                             0,
-                                             NULL);
-        }
+  if (gtk_widget_is_sensitive (dialog->priv->password_entry))
+    gtk_widget_grab_focus (dialog->priv->password_entry);
+}
 
-      gtk_list_store_append (dialog->priv->store, &iter);
-      gtk_list_store_set (dialog->priv->store, &iter,
-                          PIXBUF_COL, pixbuf,
-                          TEXT_COL, real_name,
-                          USERNAME_COL, dialog->priv->users[n],
-                          -1);
+static GtkWidget *
+create_user_picker (PolkitMateAuthenticationDialog *dialog)
+{
+  GtkWidget *vbox;
+  GtkWidget *scrolled_window;
+  GtkWidget *view;
+  GtkTreeViewColumn *column;
+  GtkCellRenderer *renderer;
+  GtkTreeSelection *selection;
 
-      i++;
-      if (passwd->pw_uid == getuid ())
-        {
-          selected_index = i;
-          g_free (dialog->priv->selected_user);
-          dialog->priv->selected_user = g_strdup (dialog->priv->users[n]);
-        }
+  vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 6);
 
-      g_free (real_name);
-      g_object_unref (pixbuf);
-    }
+  dialog->priv->user_search_entry = gtk_search_entry_new ();
+  gtk_entry_set_placeholder_text (GTK_ENTRY (dialog->priv->user_search_entry), _("Search users"));
+  gtk_box_pack_start (GTK_BOX (vbox), dialog->priv->user_search_entry, FALSE, FALSE, 0);
+  g_signal_connect (dialog->priv->user_search_entry, "search-changed",
+                    G_CALLBACK (user_search_changed),
+                    dialog);
+  g_signal_connect (dialog->priv->user_search_entry, "activate",
+                    G_CALLBACK (user_search_activate),
+                    dialog);
 
-  gtk_combo_box_set_model (combo, GTK_TREE_MODEL (dialog->priv->store));
+  scrolled_window = gtk_scrolled_window_new (NULL, NULL);
+  gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scrolled_window),
+                                  GTK_POLICY_NEVER,
+                                  GTK_POLICY_AUTOMATIC);
+  gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW (scrolled_window), GTK_SHADOW_IN);
+  gtk_scrolled_window_set_propagate_natural_height (GTK_SCROLLED_WINDOW (scrolled_window), TRUE);
+  gtk_scrolled_window_set_max_content_height (GTK_SCROLLED_WINDOW (scrolled_window), USER_PICKER_MAX_HEIGHT);
+  gtk_box_pack_start (GTK_BOX (vbox), scrolled_window, TRUE, TRUE, 0);
+
+  /* all rows have the same height, so the view only measures and draws
+   * the rows that are scrolled into sight no matter how many users there are */
+  view = gtk_tree_view_new ();
+  gtk_tree_view_set_headers_visible (GTK_TREE_VIEW (view), FALSE);
+  gtk_tree_view_set_search_column (GTK_TREE_VIEW (view), POLKIT_MATE_USER_LIST_COLUMN_TEXT);
+  gtk_container_add (GTK_CONTAINER (scrolled_window), view);
+  dialog->priv->user_view = view;
+
+  column = gtk_tree_view_column_new ();
+  gtk_tree_view_column_set_sizing (column, GTK_TREE_VIEW_COLUMN_FIXED);
+  gtk_tree_view_column_set_expand (column, TRUE);
 
   renderer = gtk_cell_renderer_pixbuf_new ();
-  gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (combo), renderer, FALSE);
-  gtk_cell_layout_set_attributes (GTK_CELL_LAYOUT (combo),
-                                  renderer,
-                                  "pixbuf", PIXBUF_COL,
-                                  NULL);
-  gtk_cell_layout_set_cell_data_func (GTK_CELL_LAYOUT (combo),
-                                      renderer,
-                                      user_combobox_set_sensitive,
-                                      NULL, NULL);
+  gtk_tree_view_column_pack_start (column, renderer, FALSE);
+  gtk_tree_view_column_set_attributes (column,
+                                       renderer,
+                                       "surface", POLKIT_MATE_USER_LIST_COLUMN_ICON,
+                                       NULL);
 
   renderer = gtk_cell_renderer_text_new ();
-  gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (combo), renderer, TRUE);
-  gtk_cell_layout_set_attributes (GTK_CELL_LAYOUT (combo),
-                                  renderer,
-                                  "text", TEXT_COL,
-                                  NULL);
-  gtk_cell_layout_set_cell_data_func (GTK_CELL_LAYOUT (combo),
-                                      renderer,
-                                      user_combobox_set_sensitive,
-                                      NULL, NULL);
-
-  /* Select the default user */
-  gtk_combo_box_set_active (GTK_COMBO_BOX (combo), selected_index);
+  g_object_set (renderer, "ellipsize", PANGO_ELLIPSIZE_END, NULL);
+  gtk_tree_view_column_pack_start (column, renderer, TRUE);
+  gtk_tree_view_column_set_attributes (column,
+                                       renderer,
+                                       "text", POLKIT_MATE_USER_LIST_COLUMN_TEXT,
+                                       NULL);
+
+  gtk_tree_view_append_column (GTK_TREE_VIEW (view), column);
+  gtk_tree_view_set_fixed_height_mode (GTK_TREE_VIEW (view), TRUE);
+
+  g_signal_connect (view, "row-activated",
+                    G_CALLBACK (user_row_activated),
+                    dialog);
 
   /* Listen when a new user is selected */
-  g_signal_connect (GTK_WIDGET (combo),
-                    "changed",
-                    G_CALLBACK (user_combobox_changed),
-                    dialog);
+  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (view));
+  gtk_tree_selection_set_mode (selection, GTK_SELECTION_SINGLE);
+  dialog->priv->user_selection_changed_id = g_signal_connect (selection,
+                                                              "changed",
+                                                              G_CALLBACK (user_selection_changed),
+                                                              dialog);
+
+  return vbox;
 }
 
-static GtkWidget *
-get_image (PolkitMateAuthenticationDialog *dialog)
+static void
+clear_user_picker (PolkitMateAuthenticationDialog *dialog)
+{
+  /* stop filling the list and loading pictures for the previous request */
+  if (dialog->priv->avatar_cancellable != NULL)
+    {
+      g_cancellable_cancel (dialog->priv->avatar_cancellable);
+      g_clear_object (&dialog->priv->avatar_cancellable);
+    }
+
+  if (dialog->priv->user_model != NULL)
+    {
+      g_signal_handler_disconnect (dialog->priv->user_model, dialog->priv->user_row_inserted_id);
+      dialog->priv->user_row_inserted_id = 0;
+      g_clear_object (&dialog->priv->user_model);
+    }
+
+  if (dialog->priv->user_view != NULL)
+    gtk_tree_view_set_model (GTK_TREE_VIEW (dialog->priv->user_view), NULL);
+}
+
+static void
+fill_user_picker (PolkitMateAuthenticationDialog *dialog)
+{
+  GtkTreeSelection *selection;
+  const gchar *preselected;
+  guint num_users;
+
+  clear_user_picker (dialog);
+
+  /* the user asked for at construction wins over ourselves, provided
+   * it is one of the choices */
+  if (dialog->priv->selected_user != NULL &&
+      g_strv_contains ((const gchar * const *) dialog->priv->users, dialog->priv->selected_user))
+    preselected = dialog->priv->selected_user;
+  else if (g_strv_contains ((const gchar * const *) dialog->priv->users, g_get_user_name ()))
+    preselected = g_get_user_name ();
+  else
+    preselected = NULL;
+  if (preselected != dialog->priv->selected_user)
+    {
+      g_free (dialog->priv->selected_user);
+      dialog->priv->selected_user = g_strdup (preselected);
+    }
+
+  /* the search entry is clutter for a handful of users */
+  num_users = g_strv_length (dialog->priv->users);
+  gtk_entry_set_text (GTK_ENTRY (dialog->priv->user_search_entry), "");
+  gtk_widget_set_visible (dialog->priv->user_search_entry, num_users > USER_SEARCH_THRESHOLD);
+
+  /* users beyond the first chunk are added while the dialog is shown */
+  dialog->priv->avatar_cancellable = g_cancellable_new ();
+  dialog->priv->user_model = polkit_mate_user_list_model_new (dialog->priv->users,
+                                                              USER_ICON_SIZE,
+                                                              gtk_widget_get_scale_factor (GTK_WIDGET (dialog)),
+                                                              dialog->priv->avatar_cancellable);
+
+  /* Select the default user; this is not a choice made by the user */
+  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (dialog->priv->user_view));
+  g_signal_handler_block (selection, dialog->priv->user_selection_changed_id);
+  gtk_tree_view_set_model (GTK_TREE_VIEW (dialog->priv->user_view),
+                           GTK_TREE_MODEL (dialog->priv->user_model));
+  g_signal_handler_unblock (selection, dialog->priv->user_selection_changed_id);
+  select_selected_user (dialog);
+
+  /* after the view has seen the row */
+  dialog->priv->user_row_inserted_id = g_signal_connect_after (dialog->priv->user_model,
+                                                               "row-inserted",
+                                                               G_CALLBACK (user_row_inserted),
+                                                               dialog);
+}
+
+static void
+update_image (PolkitMateAuthenticationDialog *dialog)
 {
   GdkPixbuf *pixbuf;
   GdkPixbuf *copy_pixbuf;
   GdkPixbuf *vendor_pixbuf;
-  GtkWidget *image;
+  GtkImage *image;
 
   pixbuf = NULL;
   copy_pixbuf = NULL;
   vendor_pixbuf = NULL;
-  image = NULL;
+  image = GTK_IMAGE (dialog->priv->image);
 
   if (dialog->priv->icon_name == NULL || strlen (dialog->priv->icon_name) == 0)
     {
-      image = gtk_image_new_from_icon_name ("dialog-password", GTK_ICON_SIZE_DIALOG);
+      gtk_image_set_from_icon_name (image, "dialog-password", GTK_ICON_SIZE_DIALOG);
       goto out;
     }
 
@@ -408,7 +442,7 @@ get_image (PolkitMateAuthenticationDialog *dialog)
   if (vendor_pixbuf == NULL)
     {
       g_warning ("No icon for themed icon with name '%s'", dialog->priv->icon_name);
-      image = gtk_image_new_from_icon_name ("dialog-password", GTK_ICON_SIZE_DIALOG);
+      gtk_image_set_from_icon_name (image, "dialog-password", GTK_ICON_SIZE_DIALOG);
       goto out;
     }
 
@@ -418,12 +452,18 @@ get_image (PolkitMateAuthenticationDialog *dialog)
                                      0,
                                      NULL);
   if (pixbuf == NULL)
-    goto out;
+    {
+      gtk_image_clear (image);
+      goto out;
+    }
 
   /* need to copy the pixbuf since we're modifying it */
   copy_pixbuf = gdk_pixbuf_copy (pixbuf);
   if (copy_pixbuf == NULL)
-    goto out;
+    {
+      gtk_image_clear (image);
+      goto out;
+    }
 
   /* blend the vendor icon in the bottom right quarter */
   gdk_pixbuf_composite (vendor_pixbuf,
@@ -433,7 +473,7 @@ get_image (PolkitMateAuthenticationDialog *dialog)
                         GDK_INTERP_BILINEAR,
                         255);
 
-  image = gtk_image_new_from_pixbuf (copy_pixbuf);
+  gtk_image_set_from_pixbuf (image, copy_pixbuf);
 
 out:
   if (pixbuf != NULL)
@@ -444,8 +484,6 @@ out:
 
   if (vendor_pixbuf != NULL)
     g_object_unref (vendor_pixbuf);
-
-  return image;
 }
 
 static void
@@ -486,6 +524,10 @@ polkit_mate_authentication_dialog_set_property (GObject      *object,
       dialog->priv->users = g_value_dup_boxed (value);
       break;
 
+    case PROP_SELECTED_USER:
+      dialog->priv->selected_user = g_value_dup_string (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -506,6 +548,10 @@ polkit_mate_authentication_dialog_get_property (GObject    *object,
       g_value_set_string (value, dialog->priv->message);
       break;
 
+    case PROP_SELECTED_USER:
+      g_value_set_string (value, dialog->priv->selected_user);
+      break;
+
     /* TODO: rest of the properties */
 
     default:
@@ -590,6 +636,48 @@ static void
 polkit_mate_authentication_dialog_init (PolkitMateAuthenticationDialog *dialog)
 {
   dialog->priv = polkit_mate_authentication_dialog_get_instance_private (dialog);
+  dialog->priv->followup_entries = g_ptr_array_new ();
+}
+
+static void
+on_entry_activate (GtkEntry *entry,
+                   gpointer  user_data)
+{
+  PolkitMateAuthenticationDialog *dialog = POLKIT_MATE_AUTHENTICATION_DIALOG (user_data);
+  GPtrArray *entries = dialog->priv->followup_entries;
+  guint n;
+
+  /* Enter moves on to the next field of a form, the last one submits it */
+  if (GTK_WIDGET (entry) == dialog->priv->password_entry && entries->len > 0)
+    {
+      gtk_widget_grab_focus (g_ptr_array_index (entries, 0));
+      return;
+    }
+
+  for (n = 0; n + 1 < entries->len; n++)
+    {
+      if (g_ptr_array_index (entries, n) == (gpointer) entry)
+        {
+          gtk_widget_grab_focus (g_ptr_array_index (entries, n + 1));
+          return;
+        }
+    }
+
+  gtk_window_activate_default (GTK_WINDOW (dialog));
+}
+
+/* an entry whose text never leaves the locked arena */
+static GtkWidget *
+secret_entry_new (void)
+{
+  GtkEntryBuffer *buffer;
+  GtkWidget *entry;
+
+  buffer = polkit_mate_secret_buffer_new ();
+  entry = gtk_entry_new_with_buffer (buffer);
+  g_object_unref (buffer);
+
+  return entry;
 }
 
 static void
@@ -610,8 +698,22 @@ polkit_mate_authentication_dialog_finalize (GObject *object)
   g_strfreev (dialog->priv->users);
   g_free (dialog->priv->selected_user);
 
-  if (dialog->priv->store != NULL)
-    g_object_unref (dialog->priv->store);
+  if (dialog->priv->avatar_cancellable != NULL)
+    {
+      g_cancellable_cancel (dialog->priv->avatar_cancellable);
+      g_object_unref (dialog->priv->avatar_cancellable);
+    }
+  if (dialog->priv->user_model != NULL)
+    {
+      g_signal_handler_disconnect (dialog->priv->user_model, dialog->priv->user_row_inserted_id);
+      g_object_unref (dialog->priv->user_model);
+    }
+
+  /* the entries themselves are owned by the grid */
+  g_ptr_array_unref (dialog->priv->followup_entries);
+
+  if (dialog->priv->shake_source_id != 0)
+    g_source_remove (dialog->priv->shake_source_id);
 
   if (G_OBJECT_CLASS (polkit_mate_authentication_dialog_parent_class)->finalize != NULL)
     G_OBJECT_CLASS (polkit_mate_authentication_dialog_parent_class)->finalize (object);
@@ -638,117 +740,236 @@ polkit_mate_dialog_add_button (GtkDialog   *dialog,
 }
 
 static void
-polkit_mate_authentication_dialog_constructed (GObject *object)
+fill_details (PolkitMateAuthenticationDialog *dialog)
 {
-  PolkitMateAuthenticationDialog *dialog;
-  GtkWidget *hbox;
-  GtkWidget *main_vbox;
-  GtkWidget *vbox;
-  GtkWidget *grid_password;
-  GtkWidget *details_expander;
-  GtkWidget *details_vbox;
   GtkWidget *grid;
   GtkWidget *label;
-  GtkWidget *image;
-  GtkWidget *content_area;
-  gboolean have_user_combobox;
+  GList *children, *l;
   gchar *s;
   guint rows;
 
-  dialog = POLKIT_MATE_AUTHENTICATION_DIALOG (object);
-
-  if (G_OBJECT_CLASS (polkit_mate_authentication_dialog_parent_class)->constructed != NULL)
-    G_OBJECT_CLASS (polkit_mate_authentication_dialog_parent_class)->constructed (object);
+  grid = dialog->priv->details_grid;
 
-  have_user_combobox = FALSE;
+  children = gtk_container_get_children (GTK_CONTAINER (grid));
+  for (l = children; l != NULL; l = l->next)
+    gtk_widget_destroy (GTK_WIDGET (l->data));
+  g_list_free (children);
 
-  dialog->priv->cancel_button = polkit_mate_dialog_add_button (GTK_DIALOG (dialog),
-                                                               _("_Cancel"),
-                                                               "process-stop",
-                                                               GTK_RESPONSE_CANCEL);
+  /* TODO: sort keys? */
+  rows = 0;
+  if (dialog->priv->details != NULL)
+    {
+      guint n;
+      gchar **keys;
 
-  dialog->priv->auth_button = gtk_dialog_add_button (GTK_DIALOG (dialog),
-                                                     _("_Authenticate"),
-                                                     GTK_RESPONSE_OK);
+      keys = polkit_details_get_keys (dialog->priv->details);
+      for (n = 0; keys[n] != NULL; n++)
+        {
+          const gchar *key = keys[n];
+          const gchar *value;
 
-  gtk_dialog_set_default_response (GTK_DIALOG (dialog), GTK_RESPONSE_OK);
+          value = polkit_details_lookup (dialog->priv->details, key);
 
-  content_area = gtk_dialog_get_content_area (GTK_DIALOG (dialog));
+          label = gtk_label_new (NULL);
+          s = g_strdup_printf ("<small>%s</small>", value);
+          gtk_label_set_markup (GTK_LABEL (label), s);
+          g_free (s);
 
-  gtk_container_set_border_width (GTK_CONTAINER (dialog), 5);
-  gtk_box_set_spacing (GTK_BOX (content_area), 2); /* 2 * 5 + 2 = 12 */
-  gtk_window_set_resizable (GTK_WINDOW (dialog), FALSE);
-  gtk_window_set_icon_name (GTK_WINDOW (dialog), "dialog-password");
+          gtk_label_set_xalign (GTK_LABEL (label), 0.0);
+          gtk_label_set_yalign (GTK_LABEL (label), 1.0);
 
-  hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 12);
-  gtk_container_set_border_width (GTK_CONTAINER (hbox), 5);
-  gtk_box_pack_start (GTK_BOX (content_area), hbox, TRUE, TRUE, 0);
+          s = g_strdup_printf ("<small><b>%s:</b></small>", key);
+          add_row (grid, rows, s, label);
+          g_free (s);
 
-  image = get_image (dialog);
-  gtk_widget_set_halign (image, GTK_ALIGN_CENTER);
-  gtk_widget_set_valign (image, GTK_ALIGN_START);
-  gtk_box_pack_start (GTK_BOX (hbox), image, FALSE, FALSE, 0);
+          rows++;
+        }
+      g_strfreev (keys);
+    }
 
-  main_vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 10);
-  gtk_box_pack_start (GTK_BOX (hbox), main_vbox, TRUE, TRUE, 0);
+  /* --- */
 
-  /* main message */
   label = gtk_label_new (NULL);
-  s = g_strdup_printf ("<big><b>%s</b></big>", dialog->priv->message);
+  gtk_label_set_use_markup (GTK_LABEL (label), TRUE);
+  s = g_strdup_printf ("<small><a href=\"%s\">%s</a></small>",
+                       dialog->priv->action_id,
+                       dialog->priv->action_id);
   gtk_label_set_markup (GTK_LABEL (label), s);
   g_free (s);
 
   gtk_label_set_xalign (GTK_LABEL (label), 0.0);
-  gtk_label_set_yalign (GTK_LABEL (label), 0.5);
-  gtk_label_set_line_wrap (GTK_LABEL (label), TRUE);
-  gtk_label_set_max_width_chars (GTK_LABEL (label), 50);
-  gtk_box_pack_start (GTK_BOX (main_vbox), label, FALSE, FALSE, 0);
+  gtk_label_set_yalign (GTK_LABEL (label), 1.0);
 
-  /* secondary message */
-  label = gtk_label_new (NULL);
-  if (g_strv_length (dialog->priv->users) > 1)
-    {
-          gtk_label_set_markup (GTK_LABEL (label),
-                                _("An application is attempting to perform an action that requires privileges. "
-                                  "Authentication as one of the users below is required to perform this action."));
-    }
-  else
-    {
-      if (strcmp (g_get_user_name (), dialog->priv->users[0]) == 0)
-        {
-          gtk_label_set_markup (GTK_LABEL (label),
-                                _("An application is attempting to perform an action that requires privileges. "
-                                  "Authentication is required to perform this action."));
-        }
-      else
-        {
-          gtk_label_set_markup (GTK_LABEL (label),
-                                _("An application is attempting to perform an action that requires privileges. "
-                                  "Authentication as the super user is required to perform this action."));
-        }
-    }
+  add_row (grid, rows++, _("<small><b>Action:</b></small>"), label);
+  g_signal_connect (label, "activate-link", G_CALLBACK (action_id_activated), NULL);
 
-  gtk_label_set_xalign (GTK_LABEL (label), 0.0);
-  gtk_label_set_yalign (GTK_LABEL (label), 0.5);
-  gtk_label_set_line_wrap (GTK_LABEL (label), TRUE);
-  gtk_label_set_max_width_chars (GTK_LABEL (label), 50);
-  gtk_box_pack_start (GTK_BOX (main_vbox), label, FALSE, FALSE, 0);
+  s = g_strdup_printf (_("Click to edit %s"), dialog->priv->action_id);
+  gtk_widget_set_tooltip_markup (label, s);
+  g_free (s);
 
-  /* user combobox */
-  if (g_strv_length (dialog->priv->users) > 1)
-    {
-      dialog->priv->user_combobox = gtk_combo_box_new ();
-      gtk_box_pack_start (GTK_BOX (main_vbox), GTK_WIDGET (dialog->priv->user_combobox), FALSE, FALSE, 0);
+  /* --- */
+
+  label = gtk_label_new (NULL);
+  gtk_label_set_use_markup (GTK_LABEL (label), TRUE);
+  s = g_strdup_printf ("<small><a href=\"%s\">%s</a></small>",
+                       dialog->priv->vendor_url,
+                       dialog->priv->vendor);
+  gtk_label_set_markup (GTK_LABEL (label), s);
+  g_free (s);
+
+  gtk_label_set_xalign (GTK_LABEL (label), 0.0);
+  gtk_label_set_yalign (GTK_LABEL (label), 1.0);
 
-      create_user_combobox (dialog);
+  add_row (grid, rows++, _("<small><b>Vendor:</b></small>"), label);
 
-      have_user_combobox = TRUE;
+  s = g_strdup_printf (_("Click to open %s"), dialog->priv->vendor_url);
+  gtk_widget_set_tooltip_markup (label, s);
+  g_free (s);
+
+  /* hidden dialogs are not shown with gtk_widget_show_all() again */
+  gtk_widget_show_all (grid);
+}
+
+/* puts the request into the widget tree built by constructed() */
+static void
+bind (PolkitMateAuthenticationDialog *dialog)
+{
+  guint num_users;
+  gboolean sensitive;
+  gchar *s;
+
+  num_users = dialog->priv->users != NULL ? g_strv_length (dialog->priv->users) : 0;
+
+  update_image (dialog);
+
+  /* main message */
+  s = g_strdup_printf ("<big><b>%s</b></big>",
+                       dialog->priv->message != NULL ? dialog->priv->message : "");
+  gtk_label_set_markup (GTK_LABEL (dialog->priv->message_label), s);
+  g_free (s);
+
+  /* secondary message */
+  if (num_users > 1)
+    {
+          gtk_label_set_markup (GTK_LABEL (dialog->priv->secondary_label),
+                                _("An application is attempting to perform an action that requires privileges. "
+                                  "Authentication as one of the users below is required to perform this action."));
     }
   else
     {
-      dialog->priv->selected_user = g_strdup (dialog->priv->users[0]);
+      if (num_users == 0 || strcmp (g_get_user_name (), dialog->priv->users[0]) == 0)
+        {
+          gtk_label_set_markup (GTK_LABEL (dialog->priv->secondary_label),
+                                _("An application is attempting to perform an action that requires privileges. "
+                                  "Authentication is required to perform this action."));
+        }
+      else
+        {
+          gtk_label_set_markup (GTK_LABEL (dialog->priv->secondary_label),
+                                _("An application is attempting to perform an action that requires privileges. "
+                                  "Authentication as the super user is required to perform this action."));
+        }
     }
 
+  /* user picker */
+  if (num_users > 1)
+    {
+      fill_user_picker (dialog);
+      gtk_widget_set_no_show_all (dialog->priv->user_picker, FALSE);
+      gtk_widget_show (dialog->priv->user_picker);
+    }
+  else
+    {
+      clear_user_picker (dialog);
+      gtk_widget_hide (dialog->priv->user_picker);
+      gtk_widget_set_no_show_all (dialog->priv->user_picker, TRUE);
+      g_free (dialog->priv->selected_user);
+      dialog->priv->selected_user = num_users > 0 ? g_strdup (dialog->priv->users[0]) : NULL;
+    }
+
+  fill_details (dialog);
+  gtk_expander_set_expanded (GTK_EXPANDER (dialog->priv->details_expander), FALSE);
+
+  /* Disable password entry and authenticate until have a user selected */
+  sensitive = !(num_users > 1 && dialog->priv->selected_user == NULL);
+  gtk_widget_set_sensitive (dialog->priv->prompt_label, sensitive);
+  gtk_widget_set_sensitive (dialog->priv->password_entry, sensitive);
+  gtk_widget_set_sensitive (dialog->priv->auth_button, sensitive);
+}
+
+static void
+polkit_mate_authentication_dialog_constructed (GObject *object)
+{
+  PolkitMateAuthenticationDialog *dialog;
+  GtkWidget *hbox;
+  GtkWidget *main_vbox;
+  GtkWidget *vbox;
+  GtkWidget *grid_password;
+  GtkWidget *details_expander;
+  GtkWidget *details_vbox;
+  GtkWidget *grid;
+  GtkWidget *label;
+  GtkWidget *image;
+  GtkWidget *content_area;
+
+  dialog = POLKIT_MATE_AUTHENTICATION_DIALOG (object);
+
+  if (G_OBJECT_CLASS (polkit_mate_authentication_dialog_parent_class)->constructed != NULL)
+    G_OBJECT_CLASS (polkit_mate_authentication_dialog_parent_class)->constructed (object);
+
+  dialog->priv->cancel_button = polkit_mate_dialog_add_button (GTK_DIALOG (dialog),
+                                                               _("_Cancel"),
+                                                               "process-stop",
+                                                               GTK_RESPONSE_CANCEL);
+
+  dialog->priv->auth_button = gtk_dialog_add_button (GTK_DIALOG (dialog),
+                                                     _("_Authenticate"),
+                                                     GTK_RESPONSE_OK);
+
+  gtk_dialog_set_default_response (GTK_DIALOG (dialog), GTK_RESPONSE_OK);
+
+  content_area = gtk_dialog_get_content_area (GTK_DIALOG (dialog));
+
+  gtk_container_set_border_width (GTK_CONTAINER (dialog), 5);
+  gtk_box_set_spacing (GTK_BOX (content_area), 2); /* 2 * 5 + 2 = 12 */
+  gtk_window_set_resizable (GTK_WINDOW (dialog), FALSE);
+  gtk_window_set_icon_name (GTK_WINDOW (dialog), "dialog-password");
+
+  hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 12);
+  gtk_container_set_border_width (GTK_CONTAINER (hbox), 5);
+  gtk_box_pack_start (GTK_BOX (content_area), hbox, TRUE, TRUE, 0);
+
+  image = gtk_image_new ();
+  gtk_widget_set_halign (image, GTK_ALIGN_CENTER);
+  gtk_widget_set_valign (image, GTK_ALIGN_START);
+  gtk_box_pack_start (GTK_BOX (hbox), image, FALSE, FALSE, 0);
+  dialog->priv->image = image;
+
+  main_vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 10);
+  gtk_box_pack_start (GTK_BOX (hbox), main_vbox, TRUE, TRUE, 0);
+
+  /* main message */
+  label = gtk_label_new (NULL);
+  gtk_label_set_xalign (GTK_LABEL (label), 0.0);
+  gtk_label_set_yalign (GTK_LABEL (label), 0.5);
+  gtk_label_set_line_wrap (GTK_LABEL (label), TRUE);
+  gtk_label_set_max_width_chars (GTK_LABEL (label), 50);
+  gtk_box_pack_start (GTK_BOX (main_vbox), label, FALSE, FALSE, 0);
+  dialog->priv->message_label = label;
+
+  /* secondary message */
+  label = gtk_label_new (NULL);
+  gtk_label_set_xalign (GTK_LABEL (label), 0.0);
+  gtk_label_set_yalign (GTK_LABEL (label), 0.5);
+  gtk_label_set_line_wrap (GTK_LABEL (label), TRUE);
+  gtk_label_set_max_width_chars (GTK_LABEL (label), 50);
+  gtk_box_pack_start (GTK_BOX (main_vbox), label, FALSE, FALSE, 0);
+  dialog->priv->secondary_label = label;
+
+  /* user picker, only shown when there is a choice */
+  dialog->priv->user_picker = create_user_picker (dialog);
+  gtk_box_pack_start (GTK_BOX (main_vbox), dialog->priv->user_picker, FALSE, FALSE, 0);
+
   /* password entry */
   vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
   gtk_box_pack_start (GTK_BOX (main_vbox), vbox, FALSE, FALSE, 0);
@@ -757,13 +978,13 @@ polkit_mate_authentication_dialog_constructed (GObject *object)
   gtk_grid_set_column_spacing (GTK_GRID (grid_password), 12);
   gtk_grid_set_row_spacing (GTK_GRID (grid_password), 6);
   gtk_box_pack_start (GTK_BOX (vbox), grid_password, FALSE, FALSE, 0);
-  dialog->priv->password_entry = gtk_entry_new ();
+  dialog->priv->password_entry = secret_entry_new ();
   gtk_entry_set_visibility (GTK_ENTRY (dialog->priv->password_entry), FALSE);
   dialog->priv->prompt_label = add_row (grid_password, 0, _("_Password:"), dialog->priv->password_entry);
 
-  g_signal_connect_swapped (dialog->priv->password_entry, "activate",
-                            G_CALLBACK (gtk_window_activate_default),
-                            dialog);
+  g_signal_connect (dialog->priv->password_entry, "activate",
+                    G_CALLBACK (on_entry_activate),
+                    dialog);
 
   dialog->priv->grid_password = grid_password;
   /* initially never show the password entry stuff; we'll toggle it on/off so it's
@@ -780,6 +1001,7 @@ polkit_mate_authentication_dialog_constructed (GObject *object)
   details_expander = gtk_expander_new_with_mnemonic (_("<small><b>_Details</b></small>"));
   gtk_expander_set_use_markup (GTK_EXPANDER (details_expander), TRUE);
   gtk_box_pack_start (GTK_BOX (content_area), details_expander, FALSE, FALSE, 0);
+  dialog->priv->details_expander = details_expander;
 
   details_vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 10);
   gtk_container_add (GTK_CONTAINER (details_expander), details_vbox);
@@ -789,88 +1011,9 @@ polkit_mate_authentication_dialog_constructed (GObject *object)
   gtk_grid_set_column_spacing (GTK_GRID (grid), 12);
   gtk_grid_set_row_spacing (GTK_GRID (grid), 6);
   gtk_box_pack_start (GTK_BOX (details_vbox), grid, FALSE, FALSE, 0);
+  dialog->priv->details_grid = grid;
 
-  /* TODO: sort keys? */
-  rows = 0;
-  if (dialog->priv->details != NULL)
-    {
-      guint n;
-      gchar **keys;
-
-      keys = polkit_details_get_keys (dialog->priv->details);
-      for (n = 0; keys[n] != NULL; n++)
-        {
-          const gchar *key = keys[n];
-          const gchar *value;
-
-          value = polkit_details_lookup (dialog->priv->details, key);
-
-          label = gtk_label_new (NULL);
-          s = g_strdup_printf ("<small>%s</small>", value);
-          gtk_label_set_markup (GTK_LABEL (label), s);
-          g_free (s);
-
-          gtk_label_set_xalign (GTK_LABEL (label), 0.0);
-          gtk_label_set_yalign (GTK_LABEL (label), 1.0);
-
-          s = g_strdup_printf ("<small><b>%s:</b></small>", key);
-          add_row (grid, rows, s, label);
-          g_free (s);
-
-          rows++;
-        }
-      g_strfreev (keys);
-    }
-
-  /* --- */
-
-  label = gtk_label_new (NULL);
-  gtk_label_set_use_markup (GTK_LABEL (label), TRUE);
-  s = g_strdup_printf ("<small><a href=\"%s\">%s</a></small>",
-                       dialog->priv->action_id,
-                       dialog->priv->action_id);
-  gtk_label_set_markup (GTK_LABEL (label), s);
-  g_free (s);
-
-  gtk_label_set_xalign (GTK_LABEL (label), 0.0);
-  gtk_label_set_yalign (GTK_LABEL (label), 1.0);
-
-  add_row (grid, rows++, _("<small><b>Action:</b></small>"), label);
-  g_signal_connect (label, "activate-link", G_CALLBACK (action_id_activated), NULL);
-
-  s = g_strdup_printf (_("Click to edit %s"), dialog->priv->action_id);
-  gtk_widget_set_tooltip_markup (label, s);
-  g_free (s);
-
-  /* --- */
-
-  label = gtk_label_new (NULL);
-  gtk_label_set_use_markup (GTK_LABEL (label), TRUE);
-  s = g_strdup_printf ("<small><a href=\"%s\">%s</a></small>",
-                       dialog->priv->vendor_url,
-                       dialog->priv->vendor);
-  gtk_label_set_markup (GTK_LABEL (label), s);
-  g_free (s);
-
-  gtk_label_set_xalign (GTK_LABEL (label), 0.0);
-  gtk_label_set_yalign (GTK_LABEL (label), 1.0);
-
-  add_row (grid, rows++, _("<small><b>Vendor:</b></small>"), label);
-
-  s = g_strdup_printf (_("Click to open %s"), dialog->priv->vendor_url);
-  gtk_widget_set_tooltip_markup (label, s);
-  g_free (s);
-
-  /* Disable password entry and authenticate until have a user selected */
-  if (have_user_combobox && gtk_combo_box_get_active (GTK_COMBO_BOX (dialog->priv->user_combobox)) == 0)
-    {
-      gtk_widget_set_sensitive (dialog->priv->prompt_label, FALSE);
-      gtk_widget_set_sensitive (dialog->priv->password_entry, FALSE);
-      gtk_widget_set_sensitive (dialog->priv->auth_button, FALSE);
-    }
-
-  gtk_widget_realize (GTK_WIDGET (dialog));
-
+  bind (dialog);
 }
 
 static void
@@ -973,12 +1116,43 @@ polkit_mate_authentication_dialog_class_init (PolkitMateAuthenticationDialogClas
                                                         NULL,
                                                         NULL,
                                                         NULL,
-                                                        G_PARAM_READABLE |
+                                                        G_PARAM_READWRITE |
+                                                        G_PARAM_CONSTRUCT_ONLY |
                                                         G_PARAM_STATIC_NAME |
                                                         G_PARAM_STATIC_NICK |
                                                         G_PARAM_STATIC_BLURB));
 }
 
+static void
+on_map (GtkWidget *widget,
+        gpointer   user_data)
+{
+  PolkitMateAuthenticationDialog *dialog = POLKIT_MATE_AUTHENTICATION_DIALOG (widget);
+  GdkDisplay *display;
+  GdkMonitor *monitor;
+  GdkRectangle workarea;
+  gint pointer_x, pointer_y;
+  gint width, height;
+  gint offset;
+
+  /* a recycled dialog comes back where it was last shown rather than
+   * centred, so always place it relative to the centre of the monitor
+   * the pointer is on, like GTK_WIN_POS_CENTER does */
+  display = gtk_widget_get_display (widget);
+  gdk_device_get_position (gdk_seat_get_pointer (gdk_display_get_default_seat (display)),
+                           NULL,
+                           &pointer_x,
+                           &pointer_y);
+  monitor = gdk_display_get_monitor_at_point (display, pointer_x, pointer_y);
+  gdk_monitor_get_workarea (monitor, &workarea);
+  gtk_window_get_size (GTK_WINDOW (dialog), &width, &height);
+
+  offset = CASCADE_OFFSET * MIN (dialog->priv->stack_position, MAX_CASCADE_STEPS);
+  gtk_window_move (GTK_WINDOW (dialog),
+                   workarea.x + (workarea.width - width) / 2 + offset,
+                   workarea.y + (workarea.height - height) / 2 + offset);
+}
+
 /**
  * polkit_mate_authentication_dialog_new:
  *
@@ -993,7 +1167,8 @@ polkit_mate_authentication_dialog_new (const gchar    *action_id,
                                         const gchar    *icon_name,
                                         const gchar    *message_markup,
                                         PolkitDetails  *details,
-                                        gchar         **users)
+                                        gchar         **users,
+                                        const gchar    *selected_user)
 {
   PolkitMateAuthenticationDialog *dialog;
   GtkWindow *window;
@@ -1006,161 +1181,377 @@ polkit_mate_authentication_dialog_new (const gchar    *action_id,
                          "message", message_markup,
                          "details", details,
                          "users", users,
+                         "selected-user", selected_user,
                          NULL);
 
   window = GTK_WINDOW (dialog);
 
+  /* not modal: several dialogs for unrelated requests may be up at once */
   gtk_window_set_position (window, GTK_WIN_POS_CENTER);
-  gtk_window_set_modal (window, TRUE);
   gtk_window_set_resizable (window, FALSE);
   gtk_window_set_keep_above (window, TRUE);
   gtk_window_set_title (window, _("Authenticate"));
   g_signal_connect (dialog, "close", G_CALLBACK (gtk_widget_hide), NULL);
+  g_signal_connect_after (dialog, "map", G_CALLBACK (on_map), NULL);
 
   return GTK_WIDGET (dialog);
 }
 
 /**
- * polkit_mate_authentication_dialog_indicate_error:
- * @dialog: the auth dialog
+ * polkit_mate_authentication_dialog_rebind:
+ * @dialog: A hidden #PolkitMateAuthenticationDialog.
+ * @action_id: The action to authenticate for.
+ * @vendor: The vendor of the action.
+ * @vendor_url: Link to the vendor.
+ * @icon_name: Icon for the action, or %NULL.
+ * @message_markup: The message to show.
+ * @details: (allow-none): Details of the request.
+ * @users: The users the user may authenticate as.
+ * @selected_user: (allow-none): The user to preselect.
  *
- * Call this function to indicate an authentication error; typically shakes the window
+ * Makes @dialog ask for another request, as if it had been created by
+ * polkit_mate_authentication_dialog_new() with these arguments. Only the
+ * parts of the widget tree that depend on the request are updated, so
+ * nothing needs to be built or realized again.
  **/
 void
-polkit_mate_authentication_dialog_indicate_error (PolkitMateAuthenticationDialog *dialog)
+polkit_mate_authentication_dialog_rebind (PolkitMateAuthenticationDialog  *dialog,
+                                          const gchar                     *action_id,
+                                          const gchar                     *vendor,
+                                          const gchar                     *vendor_url,
+                                          const gchar                     *icon_name,
+                                          const gchar                     *message_markup,
+                                          PolkitDetails                   *details,
+                                          gchar                          **users,
+                                          const gchar                     *selected_user)
 {
-  int x, y;
-  int n;
-  int diff;
+  PolkitMateAuthenticationDialogPrivate *priv = dialog->priv;
+
+  g_free (priv->action_id);
+  priv->action_id = g_strdup (action_id);
+  g_free (priv->vendor);
+  priv->vendor = g_strdup (vendor);
+  g_free (priv->vendor_url);
+  priv->vendor_url = g_strdup (vendor_url);
+  g_free (priv->icon_name);
+  priv->icon_name = g_strdup (icon_name);
+  g_free (priv->message);
+  priv->message = g_strdup (message_markup);
+  if (priv->details != NULL)
+    g_object_unref (priv->details);
+  priv->details = details != NULL ? g_object_ref (details) : NULL;
+  g_strfreev (priv->users);
+  priv->users = g_strdupv (users);
+  g_free (priv->selected_user);
+  priv->selected_user = g_strdup (selected_user);
+
+  bind (dialog);
+}
 
-  /* TODO: detect compositing manager and do fancy stuff here */
+/**
+ * polkit_mate_authentication_dialog_prepare_spare:
+ *
+ * Builds, realizes and measures a hidden dialog, unless there is one already, for
+ * polkit_mate_authentication_dialog_obtain() to hand out. Meant to be
+ * called when the agent is idle.
+ **/
+void
+polkit_mate_authentication_dialog_prepare_spare (void)
+{
+  if (spare_dialog != NULL)
+    return;
 
-  gtk_window_get_position (GTK_WINDOW (dialog), &x, &y);
+  spare_dialog = polkit_mate_authentication_dialog_new (NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+  gtk_widget_realize (spare_dialog);
+  /* style and lay out every widget once, loading the fonts on the way */
+  gtk_widget_get_preferred_size (spare_dialog, NULL, NULL);
+}
 
-  for (n = 0; n < 10; n++)
-    {
-      if (n % 2 == 0)
-        diff = -15;
-      else
-        diff = 15;
+/**
+ * polkit_mate_authentication_dialog_obtain:
+ *
+ * Like polkit_mate_authentication_dialog_new() but hands out the spare
+ * dialog, if there is one, rebound to this request. Give the dialog back
+ * with polkit_mate_authentication_dialog_recycle() rather than destroying it.
+ *
+ * Returns: A password dialog.
+ **/
+GtkWidget *
+polkit_mate_authentication_dialog_obtain (const gchar    *action_id,
+                                          const gchar    *vendor,
+                                          const gchar    *vendor_url,
+                                          const gchar    *icon_name,
+                                          const gchar    *message_markup,
+                                          PolkitDetails  *details,
+                                          gchar         **users,
+                                          const gchar    *selected_user)
+{
+  GtkWidget *dialog;
+
+  if (spare_dialog == NULL)
+    return polkit_mate_authentication_dialog_new (action_id,
+                                                  vendor,
+                                                  vendor_url,
+                                                  icon_name,
+                                                  message_markup,
+                                                  details,
+                                                  users,
+                                                  selected_user);
+
+  dialog = spare_dialog;
+  spare_dialog = NULL;
+  polkit_mate_authentication_dialog_rebind (POLKIT_MATE_AUTHENTICATION_DIALOG (dialog),
+                                            action_id,
+                                            vendor,
+                                            vendor_url,
+                                            icon_name,
+                                            message_markup,
+                                            details,
+                                            users,
+                                            selected_user);
+  return dialog;
+}
 
-      gtk_window_move (GTK_WINDOW (dialog), x + diff, y);
+/**
+ * polkit_mate_authentication_dialog_recycle:
+ * @dialog: A #PolkitMateAuthenticationDialog with no signal handlers of the caller left.
+ *
+ * Hides @dialog, wipes what was typed into it and keeps it as the spare
+ * for the next request. If there is a spare already, @dialog is destroyed.
+ **/
+void
+polkit_mate_authentication_dialog_recycle (PolkitMateAuthenticationDialog *dialog)
+{
+  if (spare_dialog != NULL)
+    {
+      gtk_widget_destroy (GTK_WIDGET (dialog));
+      return;
+    }
 
-      while (gtk_events_pending ())
-        {
-          gtk_main_iteration ();
-        }
+  gtk_widget_hide (GTK_WIDGET (dialog));
 
-      g_usleep (10000);
+  if (dialog->priv->shake_source_id != 0)
+    {
+      g_source_remove (dialog->priv->shake_source_id);
+      dialog->priv->shake_source_id = 0;
+      gtk_window_move (GTK_WINDOW (dialog), dialog->priv->shake_x, dialog->priv->shake_y);
     }
 
-  gtk_window_move (GTK_WINDOW (dialog), x, y);
+  polkit_mate_authentication_dialog_clear_prompt (dialog);
+  polkit_mate_authentication_dialog_set_info_message (dialog, "");
+  dialog->priv->stack_position = 0;
+
+  /* nobody is going to look at the users of a finished request */
+  clear_user_picker (dialog);
+
+  spare_dialog = GTK_WIDGET (dialog);
 }
 
 /**
- * polkit_mate_authentication_dialog_run_until_user_is_selected:
+ * polkit_mate_authentication_dialog_set_stack_position:
  * @dialog: A #PolkitMateAuthenticationDialog.
+ * @position: Number of cascade steps, 0 for the centre of the screen.
  *
- * Runs @dialog in a recursive main loop until a user have been selected.
- *
- * If there is only one element in the the users array (which is set upon construction) or
- * an user has already been selected, this function returns immediately with the return
- * value %TRUE.
- *
- * Returns: %TRUE if a user is selected (use polkit_mate_dialog_get_selected_user() to obtain the user) or
- *          %FALSE if the dialog was cancelled.
+ * Offsets @dialog diagonally from the centre of the screen the next time it
+ * is mapped, so that concurrently shown dialogs do not cover each other.
  **/
-gboolean
-polkit_mate_authentication_dialog_run_until_user_is_selected (PolkitMateAuthenticationDialog *dialog)
+void
+polkit_mate_authentication_dialog_set_stack_position (PolkitMateAuthenticationDialog *dialog,
+                                                      guint                           position)
 {
-  gboolean ret;
-  gint response;
+  dialog->priv->stack_position = position;
+}
 
-  ret = FALSE;
+static gboolean
+shake_step_cb (gpointer user_data)
+{
+  PolkitMateAuthenticationDialog *dialog = POLKIT_MATE_AUTHENTICATION_DIALOG (user_data);
+  gint diff;
 
-  if (dialog->priv->selected_user != NULL)
+  if (dialog->priv->shake_step == 10)
     {
-      ret = TRUE;
-      goto out;
+      gtk_window_move (GTK_WINDOW (dialog), dialog->priv->shake_x, dialog->priv->shake_y);
+      dialog->priv->shake_source_id = 0;
+      return FALSE;
     }
 
-  dialog->priv->is_running = TRUE;
+  if (dialog->priv->shake_step % 2 == 0)
+    diff = -15;
+  else
+    diff = 15;
 
-  response = gtk_dialog_run (GTK_DIALOG (dialog));
+  gtk_window_move (GTK_WINDOW (dialog), dialog->priv->shake_x + diff, dialog->priv->shake_y);
+  dialog->priv->shake_step++;
 
-  dialog->priv->is_running = FALSE;
+  return TRUE;
+}
 
-  if (response == RESPONSE_USER_SELECTED)
-    ret = TRUE;
+/**
+ * polkit_mate_authentication_dialog_indicate_error:
+ * @dialog: the auth dialog
+ *
+ * Call this function to indicate an authentication error; typically shakes the window.
+ * The animation runs from the main loop, so this returns immediately.
+ **/
+void
+polkit_mate_authentication_dialog_indicate_error (PolkitMateAuthenticationDialog *dialog)
+{
+  /* TODO: detect compositing manager and do fancy stuff here */
 
- out:
-  return ret;
+  if (dialog->priv->shake_source_id != 0)
+    return;
+
+  gtk_window_get_position (GTK_WINDOW (dialog), &dialog->priv->shake_x, &dialog->priv->shake_y);
+  dialog->priv->shake_step = 0;
+  dialog->priv->shake_source_id = g_timeout_add (10, shake_step_cb, dialog);
 }
 
 /**
- * polkit_mate_authentication_dialog_run_until_response_for_prompt:
+ * polkit_mate_authentication_dialog_set_prompt:
  * @dialog: A #PolkitMateAuthenticationDialog.
  * @prompt: The prompt to present the user with.
  * @echo_chars: Whether characters should be echoed in the password entry box.
- * @was_cancelled: Set to %TRUE if the dialog was cancelled.
- * @new_user_selected: Set to %TRUE if another user was selected.
- *
- * Runs @dialog in a recursive main loop until a response to @prompt have been obtained from the user.
  *
- * Returns: The response (free with g_free()) or %NULL if one of @was_cancelled or @new_user_selected
- *          has been set to %TRUE.
+ * Shows the password entry with @prompt. This does not wait for the user;
+ * the answer is announced by #GtkDialog::response with %GTK_RESPONSE_OK and
+ * can then be obtained with polkit_mate_authentication_dialog_get_response().
+ * Anything the user typed ahead of the prompt is kept.
  **/
-gchar *
-polkit_mate_authentication_dialog_run_until_response_for_prompt (PolkitMateAuthenticationDialog *dialog,
-                                                                  const gchar           *prompt,
-                                                                  gboolean               echo_chars,
-                                                                  gboolean              *was_cancelled,
-                                                                  gboolean              *new_user_selected)
+void
+polkit_mate_authentication_dialog_set_prompt (PolkitMateAuthenticationDialog *dialog,
+                                              const gchar                     *prompt,
+                                              gboolean                         echo_chars)
 {
-  gint response;
-  gchar *ret;
-
   gtk_label_set_text_with_mnemonic (GTK_LABEL (dialog->priv->prompt_label), prompt);
   gtk_entry_set_visibility (GTK_ENTRY (dialog->priv->password_entry), echo_chars);
-  gtk_entry_set_text (GTK_ENTRY (dialog->priv->password_entry), "");
-  gtk_widget_grab_focus (dialog->priv->password_entry);
-
-  ret = NULL;
-
-  if (was_cancelled != NULL)
-    *was_cancelled = FALSE;
-
-  if (new_user_selected != NULL)
-    *new_user_selected = FALSE;
-
-  dialog->priv->is_running = TRUE;
 
   gtk_widget_set_no_show_all (dialog->priv->grid_password, FALSE);
   gtk_widget_show_all (dialog->priv->grid_password);
 
-  response = gtk_dialog_run (GTK_DIALOG (dialog));
+  gtk_widget_grab_focus (dialog->priv->password_entry);
+}
+
+/**
+ * polkit_mate_authentication_dialog_clear_prompt:
+ * @dialog: A #PolkitMateAuthenticationDialog.
+ *
+ * Hides the password entry and forgets what was typed into it.
+ **/
+void
+polkit_mate_authentication_dialog_clear_prompt (PolkitMateAuthenticationDialog *dialog)
+{
+  gtk_entry_set_text (GTK_ENTRY (dialog->priv->password_entry), "");
+  polkit_mate_authentication_dialog_clear_followup_prompts (dialog);
 
   gtk_widget_hide (dialog->priv->grid_password);
   gtk_widget_set_no_show_all (dialog->priv->grid_password, TRUE);
+}
 
-  dialog->priv->is_running = FALSE;
+/**
+ * polkit_mate_authentication_dialog_clear_response:
+ * @dialog: A #PolkitMateAuthenticationDialog.
+ *
+ * Forgets what was typed into the password entry but leaves it in place,
+ * so the user can type ahead while the answer is being checked.
+ **/
+void
+polkit_mate_authentication_dialog_clear_response (PolkitMateAuthenticationDialog *dialog)
+{
+  guint n;
 
-  if (response == GTK_RESPONSE_OK)
-    {
-      ret = g_strdup (gtk_entry_get_text (GTK_ENTRY (dialog->priv->password_entry)));
-    }
-  else if (response == RESPONSE_USER_SELECTED)
-    {
-      if (new_user_selected != NULL)
-        *new_user_selected = TRUE;
-    }
-  else
+  gtk_entry_set_text (GTK_ENTRY (dialog->priv->password_entry), "");
+  for (n = 0; n < dialog->priv->followup_entries->len; n++)
+    gtk_entry_set_text (GTK_ENTRY (g_ptr_array_index (dialog->priv->followup_entries, n)), "");
+}
+
+/**
+ * polkit_mate_authentication_dialog_add_followup_prompt:
+ * @dialog: A #PolkitMateAuthenticationDialog.
+ * @prompt: A prompt expected after the current one.
+ * @echo_chars: Whether characters should be echoed in its entry box.
+ *
+ * Adds a field below the current prompt so that the user can answer a
+ * prompt before it has been asked. Enter moves from one field to the
+ * next; the last one submits the dialog. The answers are obtained with
+ * polkit_mate_authentication_dialog_get_followup_responses().
+ **/
+void
+polkit_mate_authentication_dialog_add_followup_prompt (PolkitMateAuthenticationDialog *dialog,
+                                                       const gchar                     *prompt,
+                                                       gboolean                         echo_chars)
+{
+  GtkWidget *label;
+  GtkWidget *entry;
+
+  entry = secret_entry_new ();
+  gtk_entry_set_visibility (GTK_ENTRY (entry), echo_chars);
+  g_signal_connect (entry, "activate",
+                    G_CALLBACK (on_entry_activate),
+                    dialog);
+  label = add_row (dialog->priv->grid_password, dialog->priv->followup_entries->len + 1, prompt, entry);
+  gtk_widget_show (label);
+  gtk_widget_show (entry);
+  g_ptr_array_add (dialog->priv->followup_entries, entry);
+}
+
+/**
+ * polkit_mate_authentication_dialog_clear_followup_prompts:
+ * @dialog: A #PolkitMateAuthenticationDialog.
+ *
+ * Removes the fields added with polkit_mate_authentication_dialog_add_followup_prompt()
+ * along with what was typed into them.
+ **/
+void
+polkit_mate_authentication_dialog_clear_followup_prompts (PolkitMateAuthenticationDialog *dialog)
+{
+  while (dialog->priv->followup_entries->len > 0)
     {
-      if (was_cancelled != NULL)
-        *was_cancelled = TRUE;
+      gtk_entry_set_text (GTK_ENTRY (g_ptr_array_index (dialog->priv->followup_entries, 0)), "");
+      g_ptr_array_remove_index (dialog->priv->followup_entries, 0);
+      gtk_grid_remove_row (GTK_GRID (dialog->priv->grid_password), 1);
     }
+}
+
+/**
+ * polkit_mate_authentication_dialog_get_followup_responses:
+ * @dialog: A #PolkitMateAuthenticationDialog.
+ *
+ * Gets the answers the user typed for the prompts added with
+ * polkit_mate_authentication_dialog_add_followup_prompt(), in order.
+ *
+ * Returns: A #GPtrArray of strings from polkit_mate_secret_alloc(), freed and
+ *          wiped with g_ptr_array_unref(), or %NULL
+ *          if there are no such prompts.
+ **/
+GPtrArray *
+polkit_mate_authentication_dialog_get_followup_responses (PolkitMateAuthenticationDialog *dialog)
+{
+  GPtrArray *responses;
+  guint n;
+
+  if (dialog->priv->followup_entries->len == 0)
+    return NULL;
 
-  return ret;
+  responses = g_ptr_array_new_with_free_func ((GDestroyNotify) polkit_mate_secret_free);
+  for (n = 0; n < dialog->priv->followup_entries->len; n++)
+    g_ptr_array_add (responses,
+                     polkit_mate_secret_dup (gtk_entry_get_text (GTK_ENTRY (g_ptr_array_index (dialog->priv->followup_entries, n)))));
+
+  return responses;
+}
+
+/**
+ * polkit_mate_authentication_dialog_get_response:
+ * @dialog: A #PolkitMateAuthenticationDialog.
+ *
+ * Gets the answer the user typed for the current prompt.
+ *
+ * Returns: The response, free with polkit_mate_secret_free().
+ **/
+gchar *
+polkit_mate_authentication_dialog_get_response (PolkitMateAuthenticationDialog *dialog)
+{
+  return polkit_mate_secret_dup (gtk_entry_get_text (GTK_ENTRY (dialog->priv->password_entry)));
 }
 
 /**
@@ -1183,22 +1574,3 @@ polkit_mate_authentication_dialog_set_info_message (PolkitMateAuthenticationDial
 {
   gtk_label_set_markup (GTK_LABEL (dialog->priv->info_label), info_markup);
 }
-
-/**
- * polkit_mate_authentication_dialog_cancel:
- * @dialog: A #PolkitMateAuthenticationDialog.
- *
- * Cancels the dialog if it is currenlty running.
- *
- * Returns: %TRUE if the dialog was running.
- **/
-gboolean
-polkit_mate_authentication_dialog_cancel (PolkitMateAuthenticationDialog *dialog)
-{
-  if (!dialog->priv->is_running)
-    return FALSE;
-
-  gtk_dialog_response (GTK_DIALOG (dialog), GTK_RESPONSE_CANCEL);
-
-  return TRUE;
-}
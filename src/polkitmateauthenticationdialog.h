@@ -58,16 +58,42 @@ GtkWidget *polkit_mate_authentication_dialog_new                           (cons
                                                                              const gchar    *icon_name,
                                                                              const gchar    *message_markup,
                                                                              PolkitDetails  *details,
-                                                                             gchar         **users);
+                                                                             gchar         **users,
+                                                                             const gchar    *selected_user);
+void       polkit_mate_authentication_dialog_rebind                        (PolkitMateAuthenticationDialog  *dialog,
+                                                                             const gchar                     *action_id,
+                                                                             const gchar                     *vendor,
+                                                                             const gchar                     *vendor_url,
+                                                                             const gchar                     *icon_name,
+                                                                             const gchar                     *message_markup,
+                                                                             PolkitDetails                   *details,
+                                                                             gchar                          **users,
+                                                                             const gchar                     *selected_user);
+void       polkit_mate_authentication_dialog_prepare_spare                 (void);
+GtkWidget *polkit_mate_authentication_dialog_obtain                        (const gchar    *action_id,
+                                                                             const gchar    *vendor,
+                                                                             const gchar    *vendor_url,
+                                                                             const gchar    *icon_name,
+                                                                             const gchar    *message_markup,
+                                                                             PolkitDetails  *details,
+                                                                             gchar         **users,
+                                                                             const gchar    *selected_user);
+void       polkit_mate_authentication_dialog_recycle                       (PolkitMateAuthenticationDialog *dialog);
 gchar     *polkit_mate_authentication_dialog_get_selected_user             (PolkitMateAuthenticationDialog *dialog);
-gboolean   polkit_mate_authentication_dialog_run_until_user_is_selected    (PolkitMateAuthenticationDialog *dialog);
-gchar     *polkit_mate_authentication_dialog_run_until_response_for_prompt (PolkitMateAuthenticationDialog *dialog,
+void       polkit_mate_authentication_dialog_set_prompt                    (PolkitMateAuthenticationDialog *dialog,
+                                                                             const gchar                     *prompt,
+                                                                             gboolean                         echo_chars);
+void       polkit_mate_authentication_dialog_clear_prompt                  (PolkitMateAuthenticationDialog *dialog);
+void       polkit_mate_authentication_dialog_clear_response                (PolkitMateAuthenticationDialog *dialog);
+gchar     *polkit_mate_authentication_dialog_get_response                  (PolkitMateAuthenticationDialog *dialog);
+void       polkit_mate_authentication_dialog_add_followup_prompt           (PolkitMateAuthenticationDialog *dialog,
                                                                              const gchar                     *prompt,
-                                                                             gboolean                         echo_chars,
-                                                                             gboolean                        *was_cancelled,
-                                                                             gboolean                        *new_user_selected);
-gboolean   polkit_mate_authentication_dialog_cancel                        (PolkitMateAuthenticationDialog *dialog);
+                                                                             gboolean                         echo_chars);
+void       polkit_mate_authentication_dialog_clear_followup_prompts        (PolkitMateAuthenticationDialog *dialog);
+GPtrArray *polkit_mate_authentication_dialog_get_followup_responses        (PolkitMateAuthenticationDialog *dialog);
 void       polkit_mate_authentication_dialog_indicate_error                (PolkitMateAuthenticationDialog *dialog);
+void       polkit_mate_authentication_dialog_set_stack_position            (PolkitMateAuthenticationDialog *dialog,
+                                                                             guint                            position);
 void       polkit_mate_authentication_dialog_set_info_message              (PolkitMateAuthenticationDialog *dialog,
                                                                              const gchar                     *info_markup);
 
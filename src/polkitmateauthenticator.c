@@ -24,7 +24,7 @@
 
 #include <string.h>
 #include <sys/types.h>
-#include <pwd.h>
+#include <unistd.h>
 #include <glib/gi18n.h>
 #include <gdk/gdkx.h>
 
@@ -33,11 +33,70 @@
 
 #include "polkitmateauthenticator.h"
 #include "polkitmateauthenticationdialog.h"
+#include "polkitmateactioncache.h"
+#include "polkitmateidentityresolver.h"
+#include "polkitmateretrypolicy.h"
+#include "polkitmateprofiler.h"
+#include "polkitmatepromptsequences.h"
+#include "polkitmatesecretbuffer.h"
+#include "polkitmateuserhistory.h"
+
+typedef enum
+{
+  STATE_NONE,            /* constructed, not initiated yet */
+  STATE_SELECTING_USER,  /* waiting for the user to pick an identity */
+  STATE_AUTHENTICATING,  /* a session is running, no prompt outstanding */
+  STATE_PROMPTING,       /* waiting for the user to answer a PAM prompt */
+  STATE_REPLAYING,       /* answering coalesced requests with the recorded responses */
+  STATE_COMPLETED        /* the completed signal has been scheduled */
+} AuthenticatorState;
+
+typedef struct
+{
+  PolkitMateAuthenticator *authenticator;
+  gchar *user;
+  PolkitAgentSession *session;
+
+  /* the prompt waiting for an answer, shown whenever this session is active */
+  gchar *request;
+  gboolean echo_on;
+
+  /* what the user answered in this conversation, only recorded while
+   * there are coalesced requests to replay it for; like every copy of a
+   * response these are kept in the locked arena, see polkitmatesecretbuffer.c */
+  GPtrArray *responses;
+  gboolean answered;
+
+  /* PolkitMatePromptStep for every prompt of this conversation so far */
+  GPtrArray *prompts;
+
+  /* answers given ahead of time in form mode, used while the prompts
+   * follow the learned sequence */
+  GPtrArray *queued;
+  guint next_queued;
+
+  /* whether a parallel conversation was started while this one waited
+   * on a device, see maybe_start_parallel_session() */
+  gboolean forked;
+
+  /* monotonic times for the profiler: when the session was initiated,
+   * when the helper last got something to work on and when the
+   * outstanding prompt arrived */
+  gint64 started;
+  gint64 last_event;
+  gint64 prompted;
+  PolkitMateConversationTimes times;
+
+  /* whether the user saw or answered any of its prompts */
+  gboolean presented;
+} UserSession;
 
 struct _PolkitMateAuthenticator
 {
   GObject parent_instance;
 
+  AuthenticatorState state;
+
   PolkitAuthority *authority;
   gchar *action_id;
   gchar *message;
@@ -49,16 +108,71 @@ struct _PolkitMateAuthenticator
   PolkitActionDescription *action_desc;
   gchar **users;
 
+  /* PolkitMateUserInfo for @users, resolved off the main thread */
+  GPtrArray *user_infos;
+
   gboolean gained_authorization;
   gboolean was_cancelled;
-  gboolean new_user_selected;
+  guint num_tries;
   gchar *selected_user;
 
-  PolkitAgentSession *session;
+  PolkitMateRetryPolicy *retry_policy;
+  guint retry_source_id;
+
+  /* what the stack asked last time, shared with the other authenticators */
+  PolkitMatePromptSequences *prompt_sequences;
+
+  /* a second conversation for the selected user, started when a failed
+   * attempt is followed by a backoff so that the retry does not wait for
+   * the helper to come up; not in @sessions until it is needed */
+  UserSession *standby_session;
+
+  /* a second conversation for the selected user running alongside the
+   * active one while that waits on a fingerprint reader or token; the
+   * first of the two to succeed wins. Only started if parallel_factors
+   * is set */
+  UserSession *parallel_session;
+  gboolean parallel_factors;
+
+  /* what the user typed while no prompt was outstanding, e.g. during the
+   * PAM fail delay; answers the next non-echoing prompt */
+  gchar *typed_ahead;
+
+  /* the identity the dialog preselects, if any; its session is started
+   * before the dialog is built */
+  gchar *default_user;
+
+  /* monotonic times for measuring what the speculative start saves */
+  gint64 session_started;
+  gint64 dialog_shown;
+
+  /* UserSession per user name, kept while the dialog is open so that
+   * switching identities does not restart their conversations */
+  GHashTable *sessions;
+  UserSession *active_session;
+
+  /* only built once the request is activated, see ensure_dialog() */
   GtkWidget *dialog;
-  GMainLoop *loop;
+  guint stack_position;
+
+  /* cookies of coalesced requests answered from the same dialog */
+  GList *extra_cookies;
+
+  /* what the user typed in the successful session, replayed for extra_cookies */
+  GPtrArray *responses;
+
+  /* Replay sessions still running */
+  GList *replays;
 };
 
+typedef struct
+{
+  PolkitMateAuthenticator *authenticator;
+  PolkitAgentSession *session;
+  gchar *cookie;
+  guint next_response;
+} Replay;
+
 struct _PolkitMateAuthenticatorClass
 {
   GObjectClass parent_class;
@@ -75,9 +189,24 @@ static guint signals[LAST_SIGNAL] = {0};
 
 G_DEFINE_TYPE (PolkitMateAuthenticator, polkit_mate_authenticator, G_TYPE_OBJECT);
 
+static void clear_sessions (PolkitMateAuthenticator *authenticator);
+static void drop_user_session (UserSession *user_session,
+                               gboolean     cancel);
+static void start_session (PolkitMateAuthenticator *authenticator);
+static UserSession *user_session_new (PolkitMateAuthenticator *authenticator);
+static void clear_replays (PolkitMateAuthenticator *authenticator);
+static void clear_responses (PolkitMateAuthenticator *authenticator);
+static void clear_queued (UserSession *user_session);
+static void show_request (PolkitMateAuthenticator *authenticator,
+                          UserSession              *user_session);
+static void update_coalesced_message (PolkitMateAuthenticator *authenticator);
+static void ensure_dialog (PolkitMateAuthenticator *authenticator);
+
 static void
 polkit_mate_authenticator_init (PolkitMateAuthenticator *authenticator)
 {
+  authenticator->sessions = g_hash_table_new (g_str_hash, g_str_equal);
+  authenticator->retry_policy = polkit_mate_retry_policy_new (3, 0, 0);
 }
 
 static void
@@ -101,14 +230,27 @@ polkit_mate_authenticator_finalize (GObject *object)
   if (authenticator->action_desc != NULL)
     g_object_unref (authenticator->action_desc);
   g_strfreev (authenticator->users);
+  if (authenticator->user_infos != NULL)
+    g_ptr_array_unref (authenticator->user_infos);
 
   g_free (authenticator->selected_user);
-  if (authenticator->session != NULL)
-    g_object_unref (authenticator->session);
+  g_free (authenticator->default_user);
+  clear_sessions (authenticator);
+  g_hash_table_unref (authenticator->sessions);
+  if (authenticator->retry_source_id > 0)
+    g_source_remove (authenticator->retry_source_id);
+  polkit_mate_retry_policy_unref (authenticator->retry_policy);
+  if (authenticator->prompt_sequences != NULL)
+    polkit_mate_prompt_sequences_unref (authenticator->prompt_sequences);
+  polkit_mate_secret_free (authenticator->typed_ahead);
+  clear_replays (authenticator);
+  clear_responses (authenticator);
+  g_list_free_full (authenticator->extra_cookies, g_free);
   if (authenticator->dialog != NULL)
-    gtk_widget_destroy (authenticator->dialog);
-  if (authenticator->loop != NULL)
-    g_main_loop_unref (authenticator->loop);
+    {
+      g_signal_handlers_disconnect_by_data (authenticator->dialog, authenticator);
+      polkit_mate_authentication_dialog_recycle (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog));
+    }
 
   if (G_OBJECT_CLASS (polkit_mate_authenticator_parent_class)->finalize != NULL)
     G_OBJECT_CLASS (polkit_mate_authenticator_parent_class)->finalize (object);
@@ -145,367 +287,1498 @@ polkit_mate_authenticator_class_init (PolkitMateAuthenticatorClass *klass)
                                             G_TYPE_BOOLEAN);
 }
 
-static PolkitActionDescription *
-get_desc_for_action (PolkitAuthority *authority,
-                     const gchar     *action_id)
+static gboolean
+emit_completed_idle (gpointer user_data)
 {
-  GList *action_descs;
-  GList *l;
-  PolkitActionDescription *result;
+  PolkitMateAuthenticator *authenticator = POLKIT_MATE_AUTHENTICATOR (user_data);
 
-  result = NULL;
+  g_signal_emit_by_name (authenticator,
+                         "completed",
+                         authenticator->gained_authorization,
+                         authenticator->was_cancelled);
 
-  action_descs = polkit_authority_enumerate_actions_sync (authority,
-                                                          NULL,
-                                                          NULL);
-  for (l = action_descs; l != NULL; l = l->next)
-    {
-      PolkitActionDescription *action_desc = POLKIT_ACTION_DESCRIPTION (l->data);
+  g_object_unref (authenticator);
 
-      if (strcmp (polkit_action_description_get_action_id (action_desc), action_id) == 0)
-        {
-          result = g_object_ref (action_desc);
-          goto out;
-        }
-    }
+  return FALSE;
+}
 
- out:
+static void
+finish (PolkitMateAuthenticator *authenticator)
+{
+  if (authenticator->state == STATE_COMPLETED)
+    return;
 
-  g_list_foreach (action_descs, (GFunc) g_object_unref, NULL);
-  g_list_free (action_descs);
+  authenticator->state = STATE_COMPLETED;
+
+  if (authenticator->retry_source_id > 0)
+    {
+      g_source_remove (authenticator->retry_source_id);
+      authenticator->retry_source_id = 0;
+    }
+  clear_sessions (authenticator);
+  clear_replays (authenticator);
+  clear_responses (authenticator);
+  polkit_mate_secret_free (authenticator->typed_ahead);
+  authenticator->typed_ahead = NULL;
+  if (authenticator->dialog != NULL)
+    gtk_widget_hide (authenticator->dialog);
 
-  return result;
+  /* report from an idle so that the receiver can dispose of us from its
+   * handler without pulling the rug from under a signal emission */
+  g_idle_add (emit_completed_idle, g_object_ref (authenticator));
 }
 
+/* the time the outstanding prompt waited for the user, up to @now */
 static void
-on_dialog_deleted (GtkWidget *widget,
-                   GdkEvent  *event,
-                   gpointer   user_data)
+add_think_time (UserSession *user_session,
+                gint64       now)
 {
-  PolkitMateAuthenticator *authenticator = POLKIT_MATE_AUTHENTICATOR (user_data);
+  gint64 think;
+  guint n;
 
-  polkit_mate_authenticator_cancel (authenticator);
+  think = now - user_session->prompted;
+  user_session->times.think += think;
+
+  n = user_session->times.num_prompts - 1;
+  if (n < POLKIT_MATE_PROFILER_MAX_PROMPTS)
+    user_session->times.prompt_think[n] += think;
 }
 
 static void
-on_user_selected (GObject    *object,
-                  GParamSpec *pspec,
-                  gpointer    user_data)
+profile_conversation (UserSession *user_session,
+                      const gchar *outcome)
 {
-  PolkitMateAuthenticator *authenticator = POLKIT_MATE_AUTHENTICATOR (user_data);
+  gint64 now;
 
-  /* clear any previous messages */
-  polkit_mate_authentication_dialog_set_info_message (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog), "");
+  now = g_get_monotonic_time ();
+  if (user_session->request != NULL)
+    {
+      add_think_time (user_session, now);
+    }
+  else
+    {
+      user_session->times.helper += now - user_session->last_event;
+      if (user_session->times.num_prompts == 0)
+        user_session->times.startup = now - user_session->started;
+      else
+        user_session->times.verify = now - user_session->last_event;
+    }
 
-  polkit_mate_authenticator_cancel (authenticator);
-  authenticator->new_user_selected = TRUE;
+  polkit_mate_profiler_add_conversation (polkit_mate_profiler_get_default (),
+                                         user_session->authenticator->action_id,
+                                         outcome,
+                                         &user_session->times);
 }
 
-PolkitMateAuthenticator *
-polkit_mate_authenticator_new (const gchar     *action_id,
-                                const gchar     *message,
-                                const gchar     *icon_name,
-                                PolkitDetails   *details,
-                                const gchar     *cookie,
-                                GList           *identities)
+static void
+drop_standby_session (PolkitMateAuthenticator *authenticator)
 {
-  PolkitMateAuthenticator *authenticator;
-  GList *l;
-  guint n;
-  GError *error;
+  if (authenticator->standby_session != NULL)
+    drop_user_session (authenticator->standby_session, TRUE);
+}
 
-  authenticator = POLKIT_MATE_AUTHENTICATOR (g_object_new (POLKIT_MATE_TYPE_AUTHENTICATOR, NULL));
+static void
+drop_parallel_session (PolkitMateAuthenticator *authenticator)
+{
+  if (authenticator->parallel_session != NULL)
+    drop_user_session (authenticator->parallel_session, TRUE);
+}
 
-  error = NULL;
-  authenticator->authority = polkit_authority_get_sync (NULL /* GCancellable* */, &error);
-  if (authenticator->authority == NULL)
-    {
-      g_critical ("Error getting authority: %s", error->message);
-      g_error_free (error);
-      goto error;
-    }
+static void
+start_standby_session (PolkitMateAuthenticator *authenticator)
+{
+  UserSession *user_session;
 
-  authenticator->action_id = g_strdup (action_id);
-  authenticator->message = g_strdup (message);
-  authenticator->icon_name = g_strdup (icon_name);
-  if (details != NULL)
-    authenticator->details = g_object_ref (details);
-  authenticator->cookie = g_strdup (cookie);
-  authenticator->identities = g_list_copy (identities);
-  g_list_foreach (authenticator->identities, (GFunc) g_object_ref, NULL);
+  user_session = user_session_new (authenticator);
+  if (user_session == NULL)
+    return;
 
-  authenticator->action_desc = get_desc_for_action (authenticator->authority,
-                                                    authenticator->action_id);
-  if (authenticator->action_desc == NULL)
-    goto error;
+  /* set before initiating, the session may complete right away */
+  authenticator->standby_session = user_session;
+  polkit_agent_session_initiate (user_session->session);
+}
 
-  authenticator->users = g_new0 (gchar *, g_list_length (authenticator->identities) + 1);
-  for (l = authenticator->identities, n = 0; l != NULL; l = l->next, n++)
+static void
+submit_response (PolkitMateAuthenticator *authenticator,
+                 UserSession              *user_session,
+                 const gchar              *response)
+{
+  /* kept for the coalesced requests, see start_replays() */
+  if (authenticator->extra_cookies != NULL)
     {
-      PolkitUnixUser *user = POLKIT_UNIX_USER (l->data);
-      uid_t uid;
-      struct passwd *passwd;
-
-      uid = polkit_unix_user_get_uid (user);
-      passwd = getpwuid (uid);
-      authenticator->users[n] = g_strdup (passwd->pw_name);
+      if (user_session->responses == NULL)
+        user_session->responses = g_ptr_array_new_with_free_func ((GDestroyNotify) polkit_mate_secret_free);
+      g_ptr_array_add (user_session->responses, polkit_mate_secret_dup (response));
     }
+  user_session->answered = TRUE;
 
-  authenticator->dialog = polkit_mate_authentication_dialog_new
-                            (authenticator->action_id,
-                             polkit_action_description_get_vendor_name (authenticator->action_desc),
-                             polkit_action_description_get_vendor_url (authenticator->action_desc),
-                             authenticator->icon_name,
-                             authenticator->message,
-                             authenticator->details,
-                             authenticator->users);
-  g_signal_connect (authenticator->dialog,
-                    "delete-event",
-                    G_CALLBACK (on_dialog_deleted),
-                    authenticator);
-  g_signal_connect (authenticator->dialog,
-                    "notify::selected-user",
-                    G_CALLBACK (on_user_selected),
-                    authenticator);
+  g_free (user_session->request);
+  user_session->request = NULL;
 
-  return authenticator;
+  user_session->last_event = g_get_monotonic_time ();
+  add_think_time (user_session, user_session->last_event);
+  user_session->presented = TRUE;
 
- error:
-  g_object_unref (authenticator);
-  return NULL;
+  authenticator->state = STATE_AUTHENTICATING;
+  polkit_agent_session_response (user_session->session, response);
 }
 
 static void
-session_request (PolkitAgentSession *session,
-                 const char         *request,
-                 gboolean            echo_on,
-                 gpointer            user_data)
+on_dialog_response (GtkDialog *dialog,
+                    gint       response_id,
+                    gpointer   user_data)
 {
   PolkitMateAuthenticator *authenticator = POLKIT_MATE_AUTHENTICATOR (user_data);
+  UserSession *user_session;
   gchar *password;
-  gchar *modified_request;
-
-  password = NULL;
-
-  //g_debug ("in conversation_pam_prompt, request='%s', echo_on=%d", request, echo_on);
 
-  /* Fix up, and localize, password prompt if it's password auth */
-  if (g_ascii_strncasecmp (request, "password:", 9) == 0)
-    {
-      if (strcmp (g_get_user_name (), authenticator->selected_user) != 0)
-        {
-          modified_request = g_strdup_printf (_("_Password for %s:"), authenticator->selected_user);
-        }
-      else
-        {
-          modified_request = g_strdup (_("_Password:"));
-        }
-    }
-  else
+  /* any response other than OK (Cancel, Escape, closing the window) dismisses the request */
+  if (response_id != GTK_RESPONSE_OK)
     {
-      modified_request = g_strdup (request);
+      polkit_mate_authenticator_cancel (authenticator);
+      return;
     }
 
-  gtk_widget_show_all (GTK_WIDGET (authenticator->dialog));
-  if (GDK_IS_X11_WINDOW (gtk_widget_get_window (GTK_WIDGET (authenticator->dialog))))
-    gtk_window_present_with_time (GTK_WINDOW (authenticator->dialog),
-                                  gdk_x11_get_server_time (gtk_widget_get_window (GTK_WIDGET (authenticator->dialog))));
-  else
-    gtk_window_present (GTK_WINDOW (authenticator->dialog));
+  user_session = authenticator->active_session;
+  if (authenticator->state != STATE_PROMPTING && authenticator->state != STATE_AUTHENTICATING)
+    return;
 
-  password = polkit_mate_authentication_dialog_run_until_response_for_prompt (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog),
-                                                                               modified_request,
-                                                                               echo_on,
-                                                                               &authenticator->was_cancelled,
-                                                                               &authenticator->new_user_selected);
+  /* the field stays usable while a response is being checked */
+  password = polkit_mate_authentication_dialog_get_response (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog));
+  polkit_mate_authentication_dialog_clear_response (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog));
 
-  /* cancel auth unless user provided a password */
-  if (password == NULL)
+  if (authenticator->state == STATE_PROMPTING && user_session != NULL)
     {
-      polkit_mate_authenticator_cancel (authenticator);
-      goto out;
+      clear_queued (user_session);
+      user_session->queued = polkit_mate_authentication_dialog_get_followup_responses (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog));
+      polkit_mate_authentication_dialog_clear_followup_prompts (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog));
+
+      submit_response (authenticator, user_session, password);
+      polkit_mate_secret_free (password);
+    }
+  else if (*password != '\0')
+    {
+      /* nothing is asking yet; hold on to it until something does */
+      polkit_mate_secret_free (authenticator->typed_ahead);
+      authenticator->typed_ahead = password;
     }
   else
     {
-      polkit_agent_session_response (authenticator->session, password);
-      g_free (password);
+      polkit_mate_secret_free (password);
     }
-
-out:
-  g_free (modified_request);
 }
 
 static void
-session_show_error (PolkitAgentSession *session,
-                    const gchar        *msg,
-                    gpointer            user_data)
+on_user_selected (GObject    *object,
+                  GParamSpec *pspec,
+                  gpointer    user_data)
 {
   PolkitMateAuthenticator *authenticator = POLKIT_MATE_AUTHENTICATOR (user_data);
-  gchar *s;
 
-  s = g_strconcat ("<b>", msg, "</b>", NULL);
-  polkit_mate_authentication_dialog_set_info_message (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog), s);
-  g_free (s);
-}
+  if (authenticator->state == STATE_NONE || authenticator->state == STATE_COMPLETED)
+    return;
 
-static void
-session_show_info (PolkitAgentSession *session,
-                   const gchar        *msg,
-                   gpointer            user_data)
-{
-  PolkitMateAuthenticator *authenticator = POLKIT_MATE_AUTHENTICATOR (user_data);
-  gchar *s;
+  /* clear any previous messages */
+  update_coalesced_message (authenticator);
+  polkit_mate_authentication_dialog_clear_prompt (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog));
+  polkit_mate_secret_free (authenticator->typed_ahead);
+  authenticator->typed_ahead = NULL;
 
-  s = g_strconcat ("<b>", msg, "</b>", NULL);
-  polkit_mate_authentication_dialog_set_info_message (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog), s);
-  g_free (s);
+  g_free (authenticator->selected_user);
+  authenticator->selected_user = polkit_mate_authentication_dialog_get_selected_user (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog));
+  if (authenticator->selected_user == NULL)
+    {
+      authenticator->active_session = NULL;
+      authenticator->state = STATE_SELECTING_USER;
+      return;
+    }
 
-  gtk_widget_show_all (GTK_WIDGET (authenticator->dialog));
-  gtk_window_present (GTK_WINDOW (authenticator->dialog));
+  /* switches to the conversation for this user, starting it if needed;
+   * the one for the previously selected user is kept around */
+  start_session (authenticator);
 }
 
 static void
-session_completed (PolkitAgentSession *session,
-                   gboolean            gained_authorization,
-                   gpointer            user_data)
+users_resolved_cb (GObject      *source_object,
+                   GAsyncResult *res,
+                   gpointer      user_data)
 {
-  PolkitMateAuthenticator *authenticator = POLKIT_MATE_AUTHENTICATOR (user_data);
-
-  authenticator->gained_authorization = gained_authorization;
-
-  //g_debug ("in conversation_done gained=%d", gained_authorization);
-
-  g_main_loop_quit (authenticator->loop);
-}
+  GTask *task = G_TASK (user_data);
+  PolkitMateAuthenticator *authenticator;
+  GPtrArray *infos;
+  const gchar *last_user;
+  guint n;
+  GError *error;
 
-static gboolean
-do_initiate (gpointer user_data)
-{
-  PolkitMateAuthenticator *authenticator = POLKIT_MATE_AUTHENTICATOR (user_data);
-  PolkitIdentity *identity;
-  gint num_tries;
+  authenticator = POLKIT_MATE_AUTHENTICATOR (g_task_get_source_object (task));
 
-  gtk_widget_show_all (GTK_WIDGET (authenticator->dialog));
-  gtk_window_present (GTK_WINDOW (authenticator->dialog));
-  if (!polkit_mate_authentication_dialog_run_until_user_is_selected (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog)))
+  error = NULL;
+  infos = polkit_mate_identity_resolver_lookup_uids_finish (POLKIT_MATE_IDENTITY_RESOLVER (source_object),
+                                                            res,
+                                                            &error);
+  if (infos == NULL)
     {
-      /* user cancelled the dialog */
-      /*g_debug ("User cancelled before selecting a user");*/
-      authenticator->was_cancelled = TRUE;
+      g_task_return_error (task, error);
       goto out;
     }
 
-  authenticator->loop = g_main_loop_new (NULL, TRUE);
-
-  num_tries = 0;
-
- try_again:
-
-  g_free (authenticator->selected_user);
-  authenticator->selected_user = polkit_mate_authentication_dialog_get_selected_user (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog));
-
-  /*g_debug ("Authenticating user %s", authenticator->selected_user);*/
-  identity = polkit_unix_user_new_for_name (authenticator->selected_user, NULL);
-
-  authenticator->session = polkit_agent_session_new (identity, authenticator->cookie);
+  if (infos->len == 0)
+    {
+      g_ptr_array_unref (infos);
+      g_task_return_new_error (task,
+                               POLKIT_ERROR,
+                               POLKIT_ERROR_FAILED,
+                               "None of the identities to authenticate as exist");
+      goto out;
+    }
 
-  g_object_unref (identity);
+  /* whoever authenticated for this action or vendor last time */
+  last_user = polkit_mate_user_history_lookup (polkit_mate_user_history_get_default (),
+                                               authenticator->action_id,
+                                               polkit_action_description_get_vendor_name (authenticator->action_desc));
 
-  g_signal_connect (authenticator->session,
-                    "request",
-                    G_CALLBACK (session_request),
-                    authenticator);
+  authenticator->users = g_new0 (gchar *, infos->len + 1);
+  for (n = 0; n < infos->len; n++)
+    {
+      PolkitMateUserInfo *info = g_ptr_array_index (infos, n);
 
-  g_signal_connect (authenticator->session,
-                    "show-info",
-                    G_CALLBACK (session_show_info),
-                    authenticator);
+      authenticator->users[n] = g_strdup (info->name);
 
-  g_signal_connect (authenticator->session,
-                    "show-error",
-                    G_CALLBACK (session_show_error),
-                    authenticator);
+      /* same choice as the dialog: the only identity, the one used last
+       * time, or ourselves */
+      if (infos->len == 1 || g_strcmp0 (info->name, last_user) == 0)
+        {
+          g_free (authenticator->default_user);
+          authenticator->default_user = g_strdup (info->name);
+        }
+      else if (info->uid == getuid () && authenticator->default_user == NULL)
+        {
+          authenticator->default_user = g_strdup (info->name);
+        }
+    }
+  /* kept so that sessions never look a user up again on the main thread */
+  authenticator->user_infos = infos;
 
-  g_signal_connect (authenticator->session,
-                    "completed",
-                    G_CALLBACK (session_completed),
-                    authenticator);
+  /* the dialog is left for polkit_mate_authenticator_initiate(); while
+   * queued the authenticator holds no GTK resources at all */
+  g_task_return_pointer (task, g_object_ref (authenticator), g_object_unref);
 
-  polkit_agent_session_initiate (authenticator->session);
+ out:
+  g_object_unref (task);
+}
 
-  g_main_loop_run (authenticator->loop);
+static void
+action_desc_lookup_cb (GObject      *source_object,
+                       GAsyncResult *res,
+                       gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  PolkitMateAuthenticator *authenticator;
+  GArray *uids;
+  GList *l;
+  GError *error;
 
-  /*g_debug ("gained_authorization=%d was_cancelled=%d new_user_selected=%d.",
-           authenticator->gained_authorization,
-           authenticator->was_cancelled,
-           authenticator->new_user_selected);*/
+  authenticator = POLKIT_MATE_AUTHENTICATOR (g_task_get_source_object (task));
 
-  if (authenticator->new_user_selected)
+  error = NULL;
+  authenticator->action_desc = polkit_mate_action_cache_lookup_finish (POLKIT_MATE_ACTION_CACHE (source_object),
+                                                                       res,
+                                                                       &error);
+  if (authenticator->action_desc == NULL)
     {
-      /*g_debug ("New user selected");*/
-      authenticator->new_user_selected = FALSE;
-      g_object_unref (authenticator->session);
-      authenticator->session = NULL;
-      goto try_again;
+      g_task_return_error (task, error);
+      g_object_unref (task);
+      return;
     }
 
-  num_tries++;
-
-  if (!authenticator->gained_authorization && !authenticator->was_cancelled)
+  /* resolve all identities in one batch, off the main thread */
+  uids = g_array_new (FALSE, FALSE, sizeof (uid_t));
+  for (l = authenticator->identities; l != NULL; l = l->next)
     {
-      if (authenticator->dialog != NULL)
-        {
-          gchar *s;
-
-          s = g_strconcat ("<b>", _("Your authentication attempt was unsuccessful. Please try again."), "</b>", NULL);
-          polkit_mate_authentication_dialog_set_info_message (
-                                  POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog),
-                                  s);
-          g_free (s);
-          gtk_widget_queue_draw (authenticator->dialog);
+      uid_t uid;
 
-          /* shake the dialog to indicate error */
-          polkit_mate_authentication_dialog_indicate_error (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog));
+      if (!POLKIT_IS_UNIX_USER (l->data))
+        continue;
 
-          if (num_tries < 3)
-            {
-              g_object_unref (authenticator->session);
-              authenticator->session = NULL;
-              goto try_again;
-            }
-        }
+      uid = polkit_unix_user_get_uid (POLKIT_UNIX_USER (l->data));
+      g_array_append_val (uids, uid);
     }
 
- out:
-  g_signal_emit_by_name (authenticator,
-                         "completed",
-                         authenticator->gained_authorization,
-                         authenticator->was_cancelled);
-
-  g_object_unref (authenticator);
-
-  return FALSE;
+  polkit_mate_identity_resolver_lookup_uids (polkit_mate_identity_resolver_get_default (),
+                                             (const uid_t *) uids->data,
+                                             uids->len,
+                                             g_task_get_cancellable (task),
+                                             users_resolved_cb,
+                                             task);
+  g_array_unref (uids);
 }
 
+/**
+ * polkit_mate_authenticator_new_async:
+ * @authority: The #PolkitAuthority shared by the agent.
+ * @action_cache: A #PolkitMateActionCache to resolve @action_id with.
+ * @action_id: The action to authenticate for.
+ * @message: The message to present to the user.
+ * @icon_name: A themed icon name or %NULL.
+ * @details: (allow-none): Details about the authentication request.
+ * @cookie: The cookie for the authentication request.
+ * @identities: A list of #PolkitIdentity objects the user can authenticate as.
+ * @cancellable: (allow-none): A #GCancellable or %NULL.
+ * @callback: Function to call when the authenticator has been constructed.
+ * @user_data: Data to pass to @callback.
+ *
+ * Asynchronously constructs a #PolkitMateAuthenticator. Nothing in here blocks
+ * the main loop; call polkit_mate_authenticator_new_finish() from @callback to
+ * obtain the result.
+ **/
 void
-polkit_mate_authenticator_initiate (PolkitMateAuthenticator *authenticator)
+polkit_mate_authenticator_new_async (PolkitAuthority        *authority,
+                                     PolkitMateActionCache *action_cache,
+                                     const gchar            *action_id,
+                                     const gchar            *message,
+                                     const gchar            *icon_name,
+                                     PolkitDetails          *details,
+                                     const gchar            *cookie,
+                                     GList                  *identities,
+                                     GCancellable           *cancellable,
+                                     GAsyncReadyCallback     callback,
+                                     gpointer                user_data)
 {
-  /* run from idle since we're going to block the main loop in the dialog (which has a recursive mainloop) */
-  g_idle_add (do_initiate, g_object_ref (authenticator));
-}
+  PolkitMateAuthenticator *authenticator;
+  GTask *task;
 
-void
-polkit_mate_authenticator_cancel (PolkitMateAuthenticator *authenticator)
-{
-  if (authenticator->dialog != NULL)
-    polkit_mate_authentication_dialog_cancel (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog));
+  authenticator = POLKIT_MATE_AUTHENTICATOR (g_object_new (POLKIT_MATE_TYPE_AUTHENTICATOR, NULL));
 
-  authenticator->was_cancelled = TRUE;
+  authenticator->authority = g_object_ref (authority);
+  authenticator->action_id = g_strdup (action_id);
+  authenticator->message = g_strdup (message);
+  authenticator->icon_name = g_strdup (icon_name);
+  if (details != NULL)
+    authenticator->details = g_object_ref (details);
+  authenticator->cookie = g_strdup (cookie);
+  authenticator->identities = g_list_copy (identities);
+  g_list_foreach (authenticator->identities, (GFunc) g_object_ref, NULL);
+
+  task = g_task_new (G_OBJECT (authenticator), cancellable, callback, user_data);
+  g_task_set_source_tag (task, polkit_mate_authenticator_new_async);
+
+  polkit_mate_action_cache_lookup (action_cache,
+                                   authenticator->action_id,
+                                   cancellable,
+                                   action_desc_lookup_cb,
+                                   task);
+
+  /* the task keeps the authenticator alive until it completes */
+  g_object_unref (authenticator);
+}
+
+/**
+ * polkit_mate_authenticator_new_finish:
+ * @res: A #GAsyncResult obtained from the #GAsyncReadyCallback passed to polkit_mate_authenticator_new_async().
+ * @error: (allow-none): Return location for error or %NULL.
+ *
+ * Finishes constructing a #PolkitMateAuthenticator.
+ *
+ * Returns: A #PolkitMateAuthenticator (free with g_object_unref()) or %NULL if @error is set.
+ **/
+PolkitMateAuthenticator *
+polkit_mate_authenticator_new_finish (GAsyncResult  *res,
+                                      GError       **error)
+{
+  GTask *task = G_TASK (res);
+
+  g_warn_if_fail (g_task_get_source_tag (task) == polkit_mate_authenticator_new_async);
+
+  return g_task_propagate_pointer (task, error);
+}
+
+static PolkitIdentity *
+get_selected_identity (PolkitMateAuthenticator *authenticator)
+{
+  guint n;
+
+  for (n = 0; n < authenticator->user_infos->len; n++)
+    {
+      PolkitMateUserInfo *info = g_ptr_array_index (authenticator->user_infos, n);
+
+      if (g_strcmp0 (info->name, authenticator->selected_user) == 0)
+        return polkit_unix_user_new (info->uid);
+    }
+
+  g_warning ("Unable to look up user %s", authenticator->selected_user);
+  return NULL;
+}
+
+static GPtrArray *
+lookup_prompt_sequence (PolkitMateAuthenticator *authenticator,
+                        const gchar              *user)
+{
+  if (authenticator->prompt_sequences == NULL)
+    return NULL;
+
+  return polkit_mate_prompt_sequences_lookup (authenticator->prompt_sequences,
+                                              user,
+                                              authenticator->action_id);
+}
+
+static void
+remember_prompt_sequence (PolkitMateAuthenticator *authenticator,
+                          UserSession              *user_session)
+{
+  if (authenticator->prompt_sequences == NULL)
+    return;
+
+  polkit_mate_prompt_sequences_remember (authenticator->prompt_sequences,
+                                         user_session->user,
+                                         authenticator->action_id,
+                                         user_session->prompts);
+  user_session->prompts = NULL;
+}
+
+/* whether prompt @n of @user_session is the one @sequence predicts */
+static gboolean
+prompt_matches (GPtrArray   *sequence,
+                guint        n,
+                UserSession *user_session)
+{
+  PolkitMatePromptStep *step;
+
+  if (sequence == NULL || n >= sequence->len)
+    return FALSE;
+
+  step = g_ptr_array_index (sequence, n);
+
+  return step->echo_on == user_session->echo_on && g_strcmp0 (step->request, user_session->request) == 0;
+}
+
+static void
+clear_queued (UserSession *user_session)
+{
+  if (user_session->queued == NULL)
+    return;
+
+  g_ptr_array_unref (user_session->queued);
+  user_session->queued = NULL;
+  user_session->next_queued = 0;
+}
+
+static void
+clear_responses (PolkitMateAuthenticator *authenticator)
+{
+  if (authenticator->responses == NULL)
+    return;
+
+  g_ptr_array_unref (authenticator->responses);
+  authenticator->responses = NULL;
+}
+
+static void
+update_coalesced_message (PolkitMateAuthenticator *authenticator)
+{
+  guint n;
+  gchar *s;
+
+  if (authenticator->dialog == NULL)
+    return;
+
+  n = g_list_length (authenticator->extra_cookies);
+  if (n == 0)
+    {
+      polkit_mate_authentication_dialog_set_info_message (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog), "");
+      return;
+    }
+
+  s = g_strdup_printf (ngettext ("This also answers %u identical request from the same application.",
+                                 "This also answers %u identical requests from the same application.",
+                                 n),
+                       n);
+  polkit_mate_authentication_dialog_set_info_message (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog), s);
+  g_free (s);
+}
+
+static void
+replay_free (Replay *replay)
+{
+  PolkitMateAuthenticator *authenticator = replay->authenticator;
+
+  authenticator->replays = g_list_remove (authenticator->replays, replay);
+  g_signal_handlers_disconnect_by_data (replay->session, replay);
+  g_object_unref (replay->session);
+  g_free (replay->cookie);
+  g_free (replay);
+}
+
+static void
+replay_cancel (Replay *replay)
+{
+  PolkitAgentSession *session;
+
+  session = g_object_ref (replay->session);
+  replay_free (replay);
+  polkit_agent_session_cancel (session);
+  g_object_unref (session);
+}
+
+static void
+clear_replays (PolkitMateAuthenticator *authenticator)
+{
+  while (authenticator->replays != NULL)
+    replay_cancel (authenticator->replays->data);
+}
+
+static void
+replay_request (PolkitAgentSession *session,
+                const char         *request,
+                gboolean            echo_on,
+                gpointer            user_data)
+{
+  Replay *replay = user_data;
+  GPtrArray *responses = replay->authenticator->responses;
+
+  if (responses != NULL && replay->next_response < responses->len)
+    {
+      polkit_agent_session_response (session, g_ptr_array_index (responses, replay->next_response++));
+      return;
+    }
+
+  /* the conversation differs from the one the user went through; give up
+   * on this request rather than prompting again */
+  g_object_ref (session);
+  polkit_agent_session_cancel (session);
+  g_object_unref (session);
+}
+
+static void
+replay_completed (PolkitAgentSession *session,
+                  gboolean            gained_authorization,
+                  gpointer            user_data)
+{
+  Replay *replay = user_data;
+  PolkitMateAuthenticator *authenticator = replay->authenticator;
+
+  /* the request is left unauthorized, its caller sees the denial */
+  if (!gained_authorization)
+    g_warning ("Replaying the authentication for coalesced request %s failed", replay->cookie);
+
+  replay_free (replay);
+
+  if (authenticator->replays == NULL)
+    finish (authenticator);
+}
+
+static void
+start_replays (PolkitMateAuthenticator *authenticator)
+{
+  PolkitIdentity *identity;
+  GPtrArray *sessions;
+  GList *l;
+  guint n;
+
+  authenticator->state = STATE_REPLAYING;
+  gtk_widget_hide (authenticator->dialog);
+
+  identity = get_selected_identity (authenticator);
+  if (identity == NULL)
+    {
+      finish (authenticator);
+      return;
+    }
+
+  sessions = g_ptr_array_new_with_free_func (g_object_unref);
+  for (l = authenticator->extra_cookies; l != NULL; l = l->next)
+    {
+      Replay *replay;
+
+      replay = g_new0 (Replay, 1);
+      replay->authenticator = authenticator;
+      replay->cookie = g_strdup (l->data);
+      replay->session = polkit_agent_session_new (identity, replay->cookie);
+      g_signal_connect (replay->session,
+                        "request",
+                        G_CALLBACK (replay_request),
+                        replay);
+      g_signal_connect (replay->session,
+                        "completed",
+                        G_CALLBACK (replay_completed),
+                        replay);
+      authenticator->replays = g_list_append (authenticator->replays, replay);
+      g_ptr_array_add (sessions, g_object_ref (replay->session));
+    }
+  g_object_unref (identity);
+
+  /* a session may complete right away, so don't walk the replays list here */
+  for (n = 0; n < sessions->len; n++)
+    polkit_agent_session_initiate (g_ptr_array_index (sessions, n));
+  g_ptr_array_unref (sessions);
+}
+
+static gchar *
+get_prompt_label (const gchar *user,
+                  const gchar *request)
+{
+  /* Fix up, and localize, password prompt if it's password auth */
+  if (g_ascii_strncasecmp (request, "password:", 9) == 0)
+    {
+      if (strcmp (g_get_user_name (), user) != 0)
+        return g_strdup_printf (_("_Password for %s:"), user);
+      else
+        return g_strdup (_("_Password:"));
+    }
+
+  return g_strdup (request);
+}
+
+static void
+show_request (PolkitMateAuthenticator *authenticator,
+              UserSession              *user_session)
+{
+  PolkitMateAuthenticationDialog *dialog = POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog);
+  GPtrArray *sequence;
+  gchar *modified_request;
+  guint current;
+  guint n;
+
+  sequence = lookup_prompt_sequence (authenticator, user_session->user);
+  current = user_session->prompts->len - 1;
+
+  /* form mode: answer right away what the user filled in up front */
+  if (user_session->queued != NULL)
+    {
+      if (user_session->next_queued < user_session->queued->len &&
+          prompt_matches (sequence, current, user_session))
+        {
+          gchar *response;
+
+          response = g_ptr_array_index (user_session->queued, user_session->next_queued++);
+          submit_response (authenticator, user_session, response);
+          return;
+        }
 
-  if (authenticator->session != NULL)
+      /* the conversation took another turn, ask for this one on its own */
+      clear_queued (user_session);
+    }
+
+  if (authenticator->typed_ahead != NULL && !user_session->echo_on)
     {
-      polkit_agent_session_cancel (authenticator->session);
+      gchar *response;
+
+      response = authenticator->typed_ahead;
+      authenticator->typed_ahead = NULL;
+      submit_response (authenticator, user_session, response);
+      polkit_mate_secret_free (response);
+      return;
     }
+
+  /* when the stack asked more than one question last time, show all of
+   * them at once so the user answers them in one go */
+  polkit_mate_authentication_dialog_clear_followup_prompts (dialog);
+  if (prompt_matches (sequence, current, user_session))
+    {
+      for (n = current + 1; n < sequence->len; n++)
+        {
+          PolkitMatePromptStep *step = g_ptr_array_index (sequence, n);
+          gchar *label;
+
+          label = get_prompt_label (user_session->user, step->request);
+          polkit_mate_authentication_dialog_add_followup_prompt (dialog, label, step->echo_on);
+          g_free (label);
+        }
+    }
+
+  modified_request = get_prompt_label (user_session->user, user_session->request);
+
+  /* the answer arrives through on_dialog_response() */
+  polkit_mate_authentication_dialog_set_prompt (dialog,
+                                                modified_request,
+                                                user_session->echo_on);
+  authenticator->state = STATE_PROMPTING;
+  user_session->presented = TRUE;
+
+  gtk_widget_show_all (GTK_WIDGET (authenticator->dialog));
+  if (GDK_IS_X11_WINDOW (gtk_widget_get_window (GTK_WIDGET (authenticator->dialog))))
+    gtk_window_present_with_time (GTK_WINDOW (authenticator->dialog),
+                                  gdk_x11_get_server_time (gtk_widget_get_window (GTK_WIDGET (authenticator->dialog))));
+  else
+    gtk_window_present (GTK_WINDOW (authenticator->dialog));
+
+  g_free (modified_request);
+}
+
+/* makes the parallel conversation the active one; the active one, if
+ * any, keeps running as the parallel one */
+static void
+swap_parallel_session (PolkitMateAuthenticator *authenticator)
+{
+  UserSession *user_session = authenticator->parallel_session;
+  UserSession *previous = authenticator->active_session;
+
+  if (previous != NULL)
+    g_hash_table_remove (authenticator->sessions, previous->user);
+  authenticator->parallel_session = previous;
+
+  g_hash_table_insert (authenticator->sessions, user_session->user, user_session);
+  authenticator->active_session = user_session;
+
+  if (user_session->request != NULL)
+    show_request (authenticator, user_session);
+  else
+    authenticator->state = STATE_AUTHENTICATING;
+}
+
+/* Substrings of what pam_fprintd and pam_pkcs11 show while they wait on
+ * the device. This is a guess: PAM does not say which module a message
+ * comes from and a translated message is not recognised, in which case
+ * the user just gets the device on its own as without parallel_factors. */
+static const gchar *device_messages[] = {
+  "finger",        /* pam_fprintd: "Place your finger on ...", "Swipe your right index finger ..." */
+  "smart card",    /* pam_pkcs11: "Please insert your smart card" */
+  "smartcard",
+  NULL
+};
+
+static gboolean
+is_device_message (const gchar *msg)
+{
+  gchar *folded;
+  gboolean ret;
+  guint n;
+
+  ret = FALSE;
+  folded = g_utf8_strdown (msg, -1);
+  for (n = 0; device_messages[n] != NULL; n++)
+    {
+      if (strstr (folded, device_messages[n]) != NULL)
+        {
+          ret = TRUE;
+          break;
+        }
+    }
+  g_free (folded);
+
+  return ret;
+}
+
+/* With pam_fprintd or pam_pkcs11 first in the stack the conversation
+ * blocks on the device with nothing to answer but an info message. A
+ * second conversation started now finds the device claimed, falls
+ * through to the password module and prompts, so the user can use
+ * either factor. */
+static void
+maybe_start_parallel_session (PolkitMateAuthenticator *authenticator,
+                              UserSession              *user_session,
+                              const gchar              *msg)
+{
+  UserSession *parallel;
+
+  if (!authenticator->parallel_factors ||
+      user_session != authenticator->active_session ||
+      user_session->forked ||
+      user_session->request != NULL ||
+      user_session->answered ||
+      authenticator->parallel_session != NULL ||
+      authenticator->state != STATE_AUTHENTICATING ||
+      !is_device_message (msg))
+    return;
+
+  user_session->forked = TRUE;
+
+  parallel = user_session_new (authenticator);
+  if (parallel == NULL)
+    return;
+  parallel->forked = TRUE;
+
+  /* set before initiating, the session may complete right away */
+  authenticator->parallel_session = parallel;
+  polkit_agent_session_initiate (parallel->session);
+}
+
+static void
+session_request (PolkitAgentSession *session,
+                 const char         *request,
+                 gboolean            echo_on,
+                 gpointer            user_data)
+{
+  UserSession *user_session = user_data;
+  PolkitMateAuthenticator *authenticator = user_session->authenticator;
+  gint64 helper;
+
+  //g_debug ("in conversation_pam_prompt, request='%s', echo_on=%d", request, echo_on);
+
+  user_session->prompted = g_get_monotonic_time ();
+  helper = user_session->prompted - user_session->last_event;
+  user_session->times.helper += helper;
+  if (user_session->times.num_prompts < POLKIT_MATE_PROFILER_MAX_PROMPTS)
+    user_session->times.prompt_helper[user_session->times.num_prompts] = helper;
+  if (user_session->times.num_prompts++ == 0)
+    user_session->times.startup = user_session->prompted - user_session->started;
+
+  g_free (user_session->request);
+  user_session->request = g_strdup (request);
+  user_session->echo_on = echo_on;
+
+  g_ptr_array_add (user_session->prompts, polkit_mate_prompt_step_new (request, echo_on));
+
+  /* the parallel conversation got past the device the active one is
+   * waiting on and asks for a password; let the user answer it while
+   * the device stays armed */
+  if (user_session == authenticator->parallel_session &&
+      authenticator->active_session != NULL &&
+      authenticator->active_session->request == NULL &&
+      !authenticator->active_session->answered)
+    {
+      swap_parallel_session (authenticator);
+      return;
+    }
+
+  /* a background conversation waits here until its user is selected again */
+  if (user_session != authenticator->active_session)
+    return;
+
+  if (authenticator->session_started > 0 && authenticator->dialog_shown > 0)
+    {
+      /* a negative head start means the session only began after the dialog was up */
+      g_debug ("First prompt ready %.1f ms after the dialog was shown, session head start %.1f ms",
+               (g_get_monotonic_time () - authenticator->dialog_shown) / 1000.0,
+               (authenticator->dialog_shown - authenticator->session_started) / 1000.0);
+      authenticator->session_started = 0;
+    }
+
+  show_request (authenticator, user_session);
+}
+
+static void
+session_show_error (PolkitAgentSession *session,
+                    const gchar        *msg,
+                    gpointer            user_data)
+{
+  UserSession *user_session = user_data;
+  PolkitMateAuthenticator *authenticator = user_session->authenticator;
+  gchar *s;
+
+  user_session->times.num_messages++;
+
+  if (user_session != authenticator->active_session &&
+      user_session != authenticator->parallel_session)
+    return;
+
+  s = g_strconcat ("<b>", msg, "</b>", NULL);
+  polkit_mate_authentication_dialog_set_info_message (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog), s);
+  g_free (s);
+
+  maybe_start_parallel_session (authenticator, user_session, msg);
+}
+
+static void
+session_show_info (PolkitAgentSession *session,
+                   const gchar        *msg,
+                   gpointer            user_data)
+{
+  UserSession *user_session = user_data;
+  PolkitMateAuthenticator *authenticator = user_session->authenticator;
+  gchar *s;
+
+  user_session->times.num_messages++;
+
+  /* messages of the parallel conversation, e.g. "Place your finger on
+   * the reader", are shown while the active one prompts */
+  if (user_session != authenticator->active_session &&
+      user_session != authenticator->parallel_session)
+    return;
+
+  s = g_strconcat ("<b>", msg, "</b>", NULL);
+  polkit_mate_authentication_dialog_set_info_message (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog), s);
+  g_free (s);
+
+  gtk_widget_show_all (GTK_WIDGET (authenticator->dialog));
+  gtk_window_present (GTK_WINDOW (authenticator->dialog));
+
+  maybe_start_parallel_session (authenticator, user_session, msg);
+}
+
+static gboolean
+retry_timeout_cb (gpointer user_data)
+{
+  PolkitMateAuthenticator *authenticator = POLKIT_MATE_AUTHENTICATOR (user_data);
+
+  authenticator->retry_source_id = 0;
+  start_session (authenticator);
+
+  return FALSE;
+}
+
+static void
+session_completed (PolkitAgentSession *session,
+                   gboolean            gained_authorization,
+                   gpointer            user_data)
+{
+  UserSession *user_session = user_data;
+  PolkitMateAuthenticator *authenticator = user_session->authenticator;
+  gboolean answered;
+  guint backoff;
+  gchar *s;
+
+  //g_debug ("in conversation_done gained=%d", gained_authorization);
+
+  if (user_session == authenticator->parallel_session)
+    {
+      /* the other factor keeps going on its own */
+      if (!gained_authorization)
+        {
+          profile_conversation (user_session, "abandoned");
+          drop_user_session (user_session, FALSE);
+          return;
+        }
+
+      /* this one won the race; the other is cancelled below */
+      swap_parallel_session (authenticator);
+    }
+
+  /* a background conversation ended, e.g. its helper failed; it is started
+   * again should its user be selected */
+  if (user_session != authenticator->active_session)
+    {
+      profile_conversation (user_session, "abandoned");
+      drop_user_session (user_session, FALSE);
+      return;
+    }
+
+  /* a speculatively started helper can fail before the dialog exists */
+  ensure_dialog (authenticator);
+
+  if (gained_authorization)
+    {
+      drop_standby_session (authenticator);
+      drop_parallel_session (authenticator);
+      remember_prompt_sequence (authenticator, user_session);
+      if (g_strv_length (authenticator->users) > 1)
+        polkit_mate_user_history_remember (polkit_mate_user_history_get_default (),
+                                           authenticator->action_id,
+                                           polkit_action_description_get_vendor_name (authenticator->action_desc),
+                                           user_session->user);
+      clear_responses (authenticator);
+      authenticator->responses = user_session->responses;
+      user_session->responses = NULL;
+    }
+  answered = user_session->answered;
+
+  /* the device giving up while the password conversation goes on is
+   * not an attempt of the user's, see below */
+  if (gained_authorization)
+    profile_conversation (user_session, "success");
+  else if (!answered && authenticator->parallel_session != NULL)
+    profile_conversation (user_session, "abandoned");
+  else
+    profile_conversation (user_session, "failure");
+  drop_user_session (user_session, FALSE);
+  authenticator->gained_authorization = gained_authorization;
+
+  if (gained_authorization)
+    {
+      if (authenticator->extra_cookies != NULL)
+        start_replays (authenticator);
+      else
+        finish (authenticator);
+      return;
+    }
+
+  /* the device gave up before the user answered anything; that is not a
+   * failed attempt when the password conversation is still running */
+  if (!answered && authenticator->parallel_session != NULL)
+    {
+      swap_parallel_session (authenticator);
+      return;
+    }
+
+  authenticator->num_tries++;
+
+  /* the prompt is left in place so that the next password can be typed
+   * while PAM is still delaying */
+  s = g_strconcat ("<b>", _("Your authentication attempt was unsuccessful. Please try again."), "</b>", NULL);
+  polkit_mate_authentication_dialog_set_info_message (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog), s);
+  g_free (s);
+  gtk_widget_queue_draw (authenticator->dialog);
+
+  /* shake the dialog to indicate error; this is animated from the main loop */
+  polkit_mate_authentication_dialog_indicate_error (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog));
+
+  if (!polkit_mate_retry_policy_should_retry (authenticator->retry_policy, authenticator->num_tries))
+    {
+      finish (authenticator);
+      return;
+    }
+
+  /* anything typed until the next prompt is held in typed_ahead */
+  authenticator->state = STATE_AUTHENTICATING;
+
+  backoff = polkit_mate_retry_policy_get_backoff (authenticator->retry_policy, authenticator->num_tries);
+  if (backoff == 0)
+    {
+      start_session (authenticator);
+      return;
+    }
+
+  /* bring the next helper up while the dialog shakes and the backoff
+   * runs, so that the retry can prompt as soon as it expires */
+  if (authenticator->standby_session != NULL &&
+      g_strcmp0 (authenticator->standby_session->user, authenticator->selected_user) != 0)
+    drop_standby_session (authenticator);
+  if (authenticator->standby_session == NULL)
+    start_standby_session (authenticator);
+  authenticator->retry_source_id = g_timeout_add (backoff, retry_timeout_cb, authenticator);
+}
+
+static void
+drop_user_session (UserSession *user_session,
+                   gboolean     cancel)
+{
+  PolkitMateAuthenticator *authenticator = user_session->authenticator;
+
+  if (authenticator->standby_session == user_session)
+    authenticator->standby_session = NULL;
+  else if (authenticator->parallel_session == user_session)
+    authenticator->parallel_session = NULL;
+  else if (g_hash_table_lookup (authenticator->sessions, user_session->user) == user_session)
+    g_hash_table_remove (authenticator->sessions, user_session->user);
+  if (authenticator->active_session == user_session)
+    authenticator->active_session = NULL;
+
+  /* conversations the user never got to see are of no interest */
+  if (cancel && user_session->presented)
+    profile_conversation (user_session, "cancelled");
+
+  /* disconnect first so a cancelled session never reaches session_completed() */
+  g_signal_handlers_disconnect_by_data (user_session->session, user_session);
+  if (cancel)
+    polkit_agent_session_cancel (user_session->session);
+  g_object_unref (user_session->session);
+
+  g_free (user_session->request);
+  if (user_session->responses != NULL)
+    g_ptr_array_unref (user_session->responses);
+  if (user_session->prompts != NULL)
+    g_ptr_array_unref (user_session->prompts);
+  clear_queued (user_session);
+  g_free (user_session->user);
+  g_free (user_session);
+}
+
+static void
+clear_sessions (PolkitMateAuthenticator *authenticator)
+{
+  GList *user_sessions;
+  GList *l;
+
+  drop_standby_session (authenticator);
+  drop_parallel_session (authenticator);
+
+  user_sessions = g_hash_table_get_values (authenticator->sessions);
+  for (l = user_sessions; l != NULL; l = l->next)
+    drop_user_session (l->data, TRUE);
+  g_list_free (user_sessions);
+}
+
+static void
+start_session (PolkitMateAuthenticator *authenticator)
+{
+  UserSession *user_session;
+
+  if (authenticator->retry_source_id > 0)
+    {
+      g_source_remove (authenticator->retry_source_id);
+      authenticator->retry_source_id = 0;
+    }
+
+  /* the parallel conversation belongs to the previously selected user */
+  if (authenticator->parallel_session != NULL &&
+      g_strcmp0 (authenticator->parallel_session->user, authenticator->selected_user) != 0)
+    drop_parallel_session (authenticator);
+
+  /* a standby conversation for the selected user takes over the pool slot */
+  user_session = g_hash_table_lookup (authenticator->sessions, authenticator->selected_user);
+  if (user_session == NULL &&
+      authenticator->standby_session != NULL &&
+      g_strcmp0 (authenticator->standby_session->user, authenticator->selected_user) == 0)
+    {
+      user_session = authenticator->standby_session;
+      authenticator->standby_session = NULL;
+      g_hash_table_insert (authenticator->sessions, user_session->user, user_session);
+    }
+
+  /* switch to a conversation already running for the selected user */
+  if (user_session != NULL)
+    {
+      authenticator->active_session = user_session;
+      if (user_session->request != NULL && authenticator->dialog != NULL)
+        show_request (authenticator, user_session);
+      else
+        authenticator->state = STATE_AUTHENTICATING;
+      return;
+    }
+
+  /*g_debug ("Authenticating user %s", authenticator->selected_user);*/
+  user_session = user_session_new (authenticator);
+  if (user_session == NULL)
+    {
+      finish (authenticator);
+      return;
+    }
+
+  g_hash_table_insert (authenticator->sessions, user_session->user, user_session);
+  authenticator->active_session = user_session;
+  authenticator->state = STATE_AUTHENTICATING;
+
+  authenticator->session_started = g_get_monotonic_time ();
+  polkit_agent_session_initiate (user_session->session);
+}
+
+/* a conversation for the selected user, not initiated yet */
+static UserSession *
+user_session_new (PolkitMateAuthenticator *authenticator)
+{
+  UserSession *user_session;
+  PolkitIdentity *identity;
+
+  identity = get_selected_identity (authenticator);
+  if (identity == NULL)
+    return NULL;
+
+  user_session = g_new0 (UserSession, 1);
+  user_session->authenticator = authenticator;
+  user_session->user = g_strdup (authenticator->selected_user);
+  user_session->session = polkit_agent_session_new (identity, authenticator->cookie);
+  user_session->prompts = g_ptr_array_new_with_free_func ((GDestroyNotify) polkit_mate_prompt_step_free);
+  user_session->started = g_get_monotonic_time ();
+  user_session->last_event = user_session->started;
+  g_object_unref (identity);
+
+  g_signal_connect (user_session->session,
+                    "request",
+                    G_CALLBACK (session_request),
+                    user_session);
+
+  g_signal_connect (user_session->session,
+                    "show-info",
+                    G_CALLBACK (session_show_info),
+                    user_session);
+
+  g_signal_connect (user_session->session,
+                    "show-error",
+                    G_CALLBACK (session_show_error),
+                    user_session);
+
+  g_signal_connect (user_session->session,
+                    "completed",
+                    G_CALLBACK (session_completed),
+                    user_session);
+
+  return user_session;
+}
+
+static void
+ensure_dialog (PolkitMateAuthenticator *authenticator)
+{
+  if (authenticator->dialog != NULL)
+    return;
+
+  authenticator->dialog = polkit_mate_authentication_dialog_obtain
+                            (authenticator->action_id,
+                             polkit_action_description_get_vendor_name (authenticator->action_desc),
+                             polkit_action_description_get_vendor_url (authenticator->action_desc),
+                             authenticator->icon_name,
+                             authenticator->message,
+                             authenticator->details,
+                             authenticator->users,
+                             authenticator->default_user);
+  polkit_mate_authentication_dialog_set_stack_position (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog),
+                                                        authenticator->stack_position);
+  update_coalesced_message (authenticator);
+
+  g_signal_connect (authenticator->dialog,
+                    "response",
+                    G_CALLBACK (on_dialog_response),
+                    authenticator);
+  g_signal_connect (authenticator->dialog,
+                    "notify::selected-user",
+                    G_CALLBACK (on_user_selected),
+                    authenticator);
+}
+
+/**
+ * polkit_mate_authenticator_initiate:
+ * @authenticator: A #PolkitMateAuthenticator.
+ *
+ * Builds and shows the dialog and starts authenticating. This returns immediately; the
+ * rest of the conversation is driven by signals from the dialog and the
+ * #PolkitAgentSession until #PolkitMateAuthenticator::completed is emitted.
+ **/
+void
+polkit_mate_authenticator_initiate (PolkitMateAuthenticator *authenticator)
+{
+  gchar *selected_user;
+
+  if (authenticator->state != STATE_NONE)
+    return;
+
+  /* get the helper and the PAM stack going while the dialog is built
+   * and mapped rather than after */
+  if (authenticator->default_user != NULL)
+    {
+      authenticator->selected_user = g_strdup (authenticator->default_user);
+      start_session (authenticator);
+      if (authenticator->state == STATE_COMPLETED)
+        return;
+    }
+
+  ensure_dialog (authenticator);
+
+  gtk_widget_show_all (GTK_WIDGET (authenticator->dialog));
+  gtk_window_present (GTK_WINDOW (authenticator->dialog));
+  authenticator->dialog_shown = g_get_monotonic_time ();
+
+  selected_user = polkit_mate_authentication_dialog_get_selected_user (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog));
+  if (selected_user == NULL)
+    {
+      /* on_user_selected() takes it from here; a speculative session
+       * stays pooled in case its user gets picked */
+      authenticator->active_session = NULL;
+      authenticator->state = STATE_SELECTING_USER;
+    }
+  else if (authenticator->active_session == NULL ||
+           g_strcmp0 (selected_user, authenticator->selected_user) != 0)
+    {
+      /* the guess was wrong, or the speculative session failed already */
+      g_free (authenticator->selected_user);
+      authenticator->selected_user = g_strdup (selected_user);
+      start_session (authenticator);
+    }
+  g_free (selected_user);
+}
+
+/**
+ * polkit_mate_authenticator_set_stack_position:
+ * @authenticator: A #PolkitMateAuthenticator.
+ * @position: Cascade step for the dialog, 0 for the centre of the screen.
+ *
+ * Sets where the dialog of @authenticator is placed relative to other
+ * dialogs shown at the same time. Must be called before
+ * polkit_mate_authenticator_initiate().
+ **/
+void
+polkit_mate_authenticator_set_stack_position (PolkitMateAuthenticator *authenticator,
+                                              guint                     position)
+{
+  authenticator->stack_position = position;
+  if (authenticator->dialog != NULL)
+    polkit_mate_authentication_dialog_set_stack_position (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog),
+                                                          position);
+}
+
+/**
+ * polkit_mate_authenticator_set_retry_policy:
+ * @authenticator: A #PolkitMateAuthenticator.
+ * @policy: A #PolkitMateRetryPolicy.
+ *
+ * Sets how many attempts the user gets and how long to wait between them.
+ * Must be called before polkit_mate_authenticator_initiate().
+ **/
+void
+polkit_mate_authenticator_set_retry_policy (PolkitMateAuthenticator *authenticator,
+                                            PolkitMateRetryPolicy   *policy)
+{
+  polkit_mate_retry_policy_ref (policy);
+  polkit_mate_retry_policy_unref (authenticator->retry_policy);
+  authenticator->retry_policy = policy;
+}
+
+static gboolean
+any_session_answered (PolkitMateAuthenticator *authenticator)
+{
+  GHashTableIter iter;
+  UserSession *user_session;
+
+  if (authenticator->parallel_session != NULL && authenticator->parallel_session->answered)
+    return TRUE;
+
+  g_hash_table_iter_init (&iter, authenticator->sessions);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &user_session))
+    {
+      if (user_session->answered)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/* whether any of the identities went through more than one prompt last time */
+static gboolean
+has_multi_prompt_sequence (PolkitMateAuthenticator *authenticator)
+{
+  guint n;
+
+  if (authenticator->users == NULL)
+    return FALSE;
+
+  for (n = 0; authenticator->users[n] != NULL; n++)
+    {
+      if (lookup_prompt_sequence (authenticator, authenticator->users[n]) != NULL)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/**
+ * polkit_mate_authenticator_set_prompt_sequences:
+ * @authenticator: A #PolkitMateAuthenticator.
+ * @sequences: A #PolkitMatePromptSequences.
+ *
+ * Sets where @authenticator looks up the prompts the stack asked last
+ * time and records the ones it asks now. Without it every prompt is
+ * shown on its own. Must be called before polkit_mate_authenticator_initiate().
+ **/
+void
+polkit_mate_authenticator_set_prompt_sequences (PolkitMateAuthenticator   *authenticator,
+                                                PolkitMatePromptSequences *sequences)
+{
+  polkit_mate_prompt_sequences_ref (sequences);
+  if (authenticator->prompt_sequences != NULL)
+    polkit_mate_prompt_sequences_unref (authenticator->prompt_sequences);
+  authenticator->prompt_sequences = sequences;
+}
+
+/**
+ * polkit_mate_authenticator_set_parallel_factors:
+ * @authenticator: A #PolkitMateAuthenticator.
+ * @parallel_factors: Whether to offer the password while a device is waited on.
+ *
+ * Sets whether a second conversation is started when the first one
+ * waits on a fingerprint reader or smart card, so that the user can type
+ * a password instead. Must be called before polkit_mate_authenticator_initiate().
+ **/
+void
+polkit_mate_authenticator_set_parallel_factors (PolkitMateAuthenticator *authenticator,
+                                                gboolean                  parallel_factors)
+{
+  authenticator->parallel_factors = parallel_factors;
+}
+
+/**
+ * polkit_mate_authenticator_add_cookie:
+ * @authenticator: A #PolkitMateAuthenticator.
+ * @cookie: The cookie of an equivalent authentication request.
+ *
+ * Coalesces another request for the same action, subject and identities
+ * into @authenticator. Once the user has authenticated, @cookie is answered
+ * by a session of its own that replays the responses the user gave.
+ *
+ * Returns: %FALSE if @authenticator is already past the point where it can
+ *          take more requests, or if its responses could not be replayed
+ *          because they were not recorded or the stack asks more than one question.
+ **/
+gboolean
+polkit_mate_authenticator_add_cookie (PolkitMateAuthenticator *authenticator,
+                                      const gchar              *cookie)
+{
+  if (authenticator->state == STATE_REPLAYING || authenticator->state == STATE_COMPLETED)
+    return FALSE;
+
+  /* answers given so far were not recorded and can't be replayed */
+  if (authenticator->extra_cookies == NULL && any_session_answered (authenticator))
+    return FALSE;
+
+  /* a stack asking several questions, e.g. a password and a one-time
+   * code, won't accept the same answers twice */
+  if (has_multi_prompt_sequence (authenticator))
+    return FALSE;
+
+  authenticator->extra_cookies = g_list_append (authenticator->extra_cookies, g_strdup (cookie));
+  update_coalesced_message (authenticator);
+
+  return TRUE;
+}
+
+/**
+ * polkit_mate_authenticator_remove_cookie:
+ * @authenticator: A #PolkitMateAuthenticator.
+ * @cookie: A cookie @authenticator is answering.
+ *
+ * Stops answering @cookie, e.g. because its request was cancelled. If
+ * @cookie is the one the dialog is authenticating for, the next coalesced
+ * request takes its place; if there is none @authenticator is cancelled.
+ **/
+void
+polkit_mate_authenticator_remove_cookie (PolkitMateAuthenticator *authenticator,
+                                         const gchar              *cookie)
+{
+  GList *l;
+
+  l = g_list_find_custom (authenticator->extra_cookies, cookie, (GCompareFunc) g_strcmp0);
+  if (l != NULL)
+    {
+      g_free (l->data);
+      authenticator->extra_cookies = g_list_delete_link (authenticator->extra_cookies, l);
+
+      for (l = authenticator->replays; l != NULL; l = l->next)
+        {
+          Replay *replay = l->data;
+
+          if (g_strcmp0 (replay->cookie, cookie) == 0)
+            {
+              replay_cancel (replay);
+              if (authenticator->replays == NULL)
+                finish (authenticator);
+              return;
+            }
+        }
+
+      if (authenticator->state != STATE_REPLAYING)
+        update_coalesced_message (authenticator);
+      return;
+    }
+
+  if (g_strcmp0 (authenticator->cookie, cookie) != 0 || authenticator->state == STATE_REPLAYING)
+    return;
+
+  if (authenticator->extra_cookies == NULL)
+    {
+      polkit_mate_authenticator_cancel (authenticator);
+      return;
+    }
+
+  g_free (authenticator->cookie);
+  authenticator->cookie = authenticator->extra_cookies->data;
+  authenticator->extra_cookies = g_list_delete_link (authenticator->extra_cookies, authenticator->extra_cookies);
+  update_coalesced_message (authenticator);
+
+  /* every pooled conversation is bound to the old cookie */
+  if (authenticator->state == STATE_AUTHENTICATING || authenticator->state == STATE_PROMPTING)
+    {
+      polkit_mate_authentication_dialog_clear_prompt (POLKIT_MATE_AUTHENTICATION_DIALOG (authenticator->dialog));
+      clear_sessions (authenticator);
+      start_session (authenticator);
+    }
+  else
+    {
+      clear_sessions (authenticator);
+    }
+}
+
+/**
+ * polkit_mate_authenticator_cancel:
+ * @authenticator: A #PolkitMateAuthenticator.
+ *
+ * Cancels @authenticator whether or not it has been initiated. Any running
+ * session is cancelled right away and #PolkitMateAuthenticator::completed is
+ * emitted from the next main loop iteration.
+ **/
+void
+polkit_mate_authenticator_cancel (PolkitMateAuthenticator *authenticator)
+{
+  if (authenticator->state == STATE_COMPLETED)
+    return;
+
+  authenticator->was_cancelled = TRUE;
+  finish (authenticator);
 }
 
 const gchar *
@@ -514,3 +1787,20 @@ polkit_mate_authenticator_get_cookie (PolkitMateAuthenticator *authenticator)
   return authenticator->cookie;
 }
 
+/**
+ * polkit_mate_authenticator_has_cookie:
+ * @authenticator: A #PolkitMateAuthenticator.
+ * @cookie: A cookie.
+ *
+ * Checks whether @authenticator answers @cookie, either as the request
+ * it was created for or as a coalesced one.
+ *
+ * Returns: %TRUE if @cookie is answered by @authenticator.
+ **/
+gboolean
+polkit_mate_authenticator_has_cookie (PolkitMateAuthenticator *authenticator,
+                                      const gchar              *cookie)
+{
+  return g_strcmp0 (authenticator->cookie, cookie) == 0 ||
+         g_list_find_custom (authenticator->extra_cookies, cookie, (GCompareFunc) g_strcmp0) != NULL;
+}
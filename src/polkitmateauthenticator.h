@@ -24,6 +24,11 @@
 #define __POLKIT_MATE_AUTHENTICATOR_H
 
 #include <glib-object.h>
+#include <gio/gio.h>
+
+#include "polkitmateactioncache.h"
+#include "polkitmatepromptsequences.h"
+#include "polkitmateretrypolicy.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -40,15 +45,36 @@ typedef struct _PolkitMateAuthenticator PolkitMateAuthenticator;
 typedef struct _PolkitMateAuthenticatorClass PolkitMateAuthenticatorClass;
 
 GType                      polkit_mate_authenticator_get_type   (void) G_GNUC_CONST;
-PolkitMateAuthenticator  *polkit_mate_authenticator_new        (const gchar              *action_id,
+void                       polkit_mate_authenticator_new_async  (PolkitAuthority          *authority,
+                                                                  PolkitMateActionCache   *action_cache,
+                                                                  const gchar              *action_id,
                                                                   const gchar              *message,
                                                                   const gchar              *icon_name,
                                                                   PolkitDetails            *details,
                                                                   const gchar              *cookie,
-                                                                  GList                    *identities);
+                                                                  GList                    *identities,
+                                                                  GCancellable             *cancellable,
+                                                                  GAsyncReadyCallback       callback,
+                                                                  gpointer                  user_data);
+PolkitMateAuthenticator  *polkit_mate_authenticator_new_finish (GAsyncResult             *res,
+                                                                  GError                  **error);
+void                       polkit_mate_authenticator_set_stack_position (PolkitMateAuthenticator *authenticator,
+                                                                          guint                     position);
+void                       polkit_mate_authenticator_set_retry_policy (PolkitMateAuthenticator *authenticator,
+                                                                        PolkitMateRetryPolicy   *policy);
+void                       polkit_mate_authenticator_set_prompt_sequences (PolkitMateAuthenticator   *authenticator,
+                                                                            PolkitMatePromptSequences *sequences);
+void                       polkit_mate_authenticator_set_parallel_factors (PolkitMateAuthenticator *authenticator,
+                                                                            gboolean                  parallel_factors);
 void                       polkit_mate_authenticator_initiate   (PolkitMateAuthenticator *authenticator);
 void                       polkit_mate_authenticator_cancel     (PolkitMateAuthenticator *authenticator);
+gboolean                   polkit_mate_authenticator_add_cookie (PolkitMateAuthenticator *authenticator,
+                                                                  const gchar              *cookie);
+void                       polkit_mate_authenticator_remove_cookie (PolkitMateAuthenticator *authenticator,
+                                                                     const gchar              *cookie);
 const gchar               *polkit_mate_authenticator_get_cookie (PolkitMateAuthenticator *authenticator);
+gboolean                   polkit_mate_authenticator_has_cookie (PolkitMateAuthenticator *authenticator,
+                                                                  const gchar              *cookie);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,672 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include "config.h"
+
+#include <string.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "polkitmateavatarloader.h"
+#include "polkitmateidentityresolver.h"
+
+/* Loads the pictures of users for the user combobox. The lookups for all
+ * users of a dialog run concurrently; with AccountsService they go over a
+ * connection and proxies kept for the lifetime of the agent, whose cached
+ * properties spare the round trips for users seen before. The images are
+ * decoded in a worker thread.
+ *
+ * Decoded pictures are kept in the user's cache directory, scaled for the
+ * size and device scale they were asked for and converted to the
+ * premultiplied ARGB32 data cairo draws from. Such a thumbnail is valid as
+ * long as its source keeps its modification time and size, and its pixels
+ * are copied into a surface as they are, so dialogs after the first one
+ * decode nothing at all. Thumbnails that have not been written for a while
+ * are removed once per session. */
+
+/* "PMA1" in native byte order; a cache shared between machines of
+ * different endianness is simply missed */
+#define THUMBNAIL_MAGIC 0x504d4131
+
+/* thumbnails still in use after this many seconds are simply written again */
+#define THUMBNAIL_MAX_AGE (30 * 24 * 60 * 60)
+
+/* milliseconds to wait on accounts-daemon; a dialog does without
+ * pictures rather than tie up a lookup for the D-Bus default of 25 s */
+#define ACCOUNTS_CALL_TIMEOUT 2000
+
+typedef struct
+{
+  guint32 magic;
+  guint32 width;
+  guint32 height;
+  guint32 stride;
+
+  /* of the source file */
+  gint64 mtime;
+  gint64 size;
+} ThumbnailHeader;
+
+struct _PolkitMateAvatarLoader
+{
+  GObject parent_instance;
+
+#if HAVE_ACCOUNTSSERVICE
+  /* org.freedesktop.Accounts, NULL until connected */
+  GDBusProxy *accounts;
+  gboolean connecting;
+
+  /* loads waiting for the connection */
+  GList *waiting_tasks;
+
+  /* user name -> GDBusProxy for org.freedesktop.Accounts.User */
+  GHashTable *users;
+#endif
+};
+
+struct _PolkitMateAvatarLoaderClass
+{
+  GObjectClass parent_class;
+};
+
+typedef struct
+{
+  gchar *user;
+  gint size;
+  gint scale;
+
+  /* the image file, once known */
+  gchar *path;
+} LoadData;
+
+G_DEFINE_TYPE (PolkitMateAvatarLoader, polkit_mate_avatar_loader, G_TYPE_OBJECT);
+
+static void
+load_data_free (LoadData *data)
+{
+  g_free (data->user);
+  g_free (data->path);
+  g_free (data);
+}
+
+static void
+polkit_mate_avatar_loader_init (PolkitMateAvatarLoader *loader)
+{
+#if HAVE_ACCOUNTSSERVICE
+  loader->users = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+#endif
+}
+
+static void
+polkit_mate_avatar_loader_finalize (GObject *object)
+{
+#if HAVE_ACCOUNTSSERVICE
+  PolkitMateAvatarLoader *loader;
+
+  loader = POLKIT_MATE_AVATAR_LOADER (object);
+
+  if (loader->accounts != NULL)
+    g_object_unref (loader->accounts);
+  g_hash_table_unref (loader->users);
+#endif
+
+  if (G_OBJECT_CLASS (polkit_mate_avatar_loader_parent_class)->finalize != NULL)
+    G_OBJECT_CLASS (polkit_mate_avatar_loader_parent_class)->finalize (object);
+}
+
+static void
+polkit_mate_avatar_loader_class_init (PolkitMateAvatarLoaderClass *klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = polkit_mate_avatar_loader_finalize;
+}
+
+/**
+ * polkit_mate_avatar_loader_get_default:
+ *
+ * Gets the loader shared by all dialogs.
+ *
+ * Returns: (transfer none): A #PolkitMateAvatarLoader.
+ **/
+PolkitMateAvatarLoader *
+polkit_mate_avatar_loader_get_default (void)
+{
+  static PolkitMateAvatarLoader *loader = NULL;
+
+  if (loader == NULL)
+    loader = POLKIT_MATE_AVATAR_LOADER (g_object_new (POLKIT_MATE_TYPE_AVATAR_LOADER, NULL));
+
+  return loader;
+}
+
+static gchar *
+get_thumbnail_dir (void)
+{
+  return g_build_filename (g_get_user_cache_dir (), "polkit-mate", "avatars", NULL);
+}
+
+static gchar *
+get_thumbnail_path (const LoadData *data)
+{
+  gchar *key;
+  gchar *name;
+  gchar *dir;
+  gchar *path;
+
+  key = g_strdup_printf ("%s\n%d\n%d", data->path, data->size, data->scale);
+  name = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+  dir = get_thumbnail_dir ();
+  path = g_build_filename (dir, name, NULL);
+  g_free (dir);
+  g_free (name);
+  g_free (key);
+
+  return path;
+}
+
+/* removes the thumbnails of pictures that were replaced, of users that
+ * are gone and of sizes no longer asked for */
+static void
+prune_thumbnails (void)
+{
+  const gchar *name;
+  gchar *dir_path;
+  GDir *dir;
+  gint64 now;
+
+  dir_path = get_thumbnail_dir ();
+  dir = g_dir_open (dir_path, 0, NULL);
+  if (dir == NULL)
+    goto out;
+
+  now = g_get_real_time () / G_USEC_PER_SEC;
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      GStatBuf buf;
+      gchar *path;
+
+      path = g_build_filename (dir_path, name, NULL);
+      if (g_lstat (path, &buf) == 0 &&
+          S_ISREG (buf.st_mode) &&
+          now - (gint64) buf.st_mtime > THUMBNAIL_MAX_AGE)
+        g_unlink (path);
+      g_free (path);
+    }
+  g_dir_close (dir);
+
+ out:
+  g_free (dir_path);
+}
+
+static cairo_surface_t *
+load_thumbnail (const gchar     *thumbnail_path,
+                const GStatBuf  *source)
+{
+  const ThumbnailHeader *header;
+  cairo_surface_t *surface;
+  gchar *contents;
+  gsize length;
+  guint y;
+
+  surface = NULL;
+
+  /* copied rather than mapped: a mapping would raise SIGBUS if the file
+   * was truncated underneath it, and a thumbnail is only a few kilobytes */
+  if (!g_file_get_contents (thumbnail_path, &contents, &length, NULL))
+    return NULL;
+
+  if (length < sizeof (ThumbnailHeader))
+    goto out;
+
+  header = (const ThumbnailHeader *) contents;
+  if (header->magic != THUMBNAIL_MAGIC ||
+      header->mtime != (gint64) source->st_mtime ||
+      header->size != (gint64) source->st_size ||
+      header->width == 0 || header->height == 0 ||
+      header->stride != (guint32) cairo_format_stride_for_width (CAIRO_FORMAT_ARGB32, header->width) ||
+      length != sizeof (ThumbnailHeader) + (gsize) header->stride * header->height)
+    goto out;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, header->width, header->height);
+  if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS)
+    {
+      cairo_surface_destroy (surface);
+      surface = NULL;
+      goto out;
+    }
+
+  cairo_surface_flush (surface);
+  for (y = 0; y < header->height; y++)
+    memcpy (cairo_image_surface_get_data (surface) + y * cairo_image_surface_get_stride (surface),
+            (const guchar *) (header + 1) + y * header->stride,
+            header->width * 4);
+  cairo_surface_mark_dirty (surface);
+
+ out:
+  g_free (contents);
+  return surface;
+}
+
+static void
+save_thumbnail (const gchar     *thumbnail_path,
+                const GStatBuf  *source,
+                cairo_surface_t *surface)
+{
+  ThumbnailHeader header;
+  gchar *contents;
+  gchar *dir;
+  gsize length;
+  GError *error;
+
+  memset (&header, 0, sizeof header);
+  header.magic = THUMBNAIL_MAGIC;
+  header.width = cairo_image_surface_get_width (surface);
+  header.height = cairo_image_surface_get_height (surface);
+  header.stride = cairo_image_surface_get_stride (surface);
+  header.mtime = source->st_mtime;
+  header.size = source->st_size;
+
+  length = sizeof header + (gsize) header.stride * header.height;
+  contents = g_malloc (length);
+  memcpy (contents, &header, sizeof header);
+  memcpy (contents + sizeof header, cairo_image_surface_get_data (surface), length - sizeof header);
+
+  dir = g_path_get_dirname (thumbnail_path);
+  g_mkdir_with_parents (dir, 0700);
+  g_free (dir);
+
+  error = NULL;
+  if (!g_file_set_contents (thumbnail_path, contents, length, &error))
+    {
+      g_warning ("Error writing %s: %s", thumbnail_path, error->message);
+      g_error_free (error);
+    }
+  g_free (contents);
+}
+
+/* converts to premultiplied native-endian ARGB, what cairo draws from */
+static cairo_surface_t *
+surface_from_pixbuf (GdkPixbuf *pixbuf)
+{
+  cairo_surface_t *surface;
+  const guchar *src_pixels;
+  guchar *dst_pixels;
+  gint width, height;
+  gint src_stride, dst_stride;
+  gint n_channels;
+  gboolean has_alpha;
+  gint x, y;
+
+  width = gdk_pixbuf_get_width (pixbuf);
+  height = gdk_pixbuf_get_height (pixbuf);
+  n_channels = gdk_pixbuf_get_n_channels (pixbuf);
+  has_alpha = gdk_pixbuf_get_has_alpha (pixbuf);
+  src_stride = gdk_pixbuf_get_rowstride (pixbuf);
+  src_pixels = gdk_pixbuf_read_pixels (pixbuf);
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+  if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS)
+    {
+      cairo_surface_destroy (surface);
+      return NULL;
+    }
+
+  cairo_surface_flush (surface);
+  dst_stride = cairo_image_surface_get_stride (surface);
+  dst_pixels = cairo_image_surface_get_data (surface);
+
+  for (y = 0; y < height; y++)
+    {
+      const guchar *src = src_pixels + y * src_stride;
+      guint32 *dst = (guint32 *) (dst_pixels + y * dst_stride);
+
+      for (x = 0; x < width; x++, src += n_channels)
+        {
+          guint r = src[0], g = src[1], b = src[2];
+          guint a = has_alpha ? src[3] : 0xff;
+
+          if (a != 0xff)
+            {
+              r = (r * a + 127) / 255;
+              g = (g * a + 127) / 255;
+              b = (b * a + 127) / 255;
+            }
+          dst[x] = (a << 24) | (r << 16) | (g << 8) | b;
+        }
+    }
+  cairo_surface_mark_dirty (surface);
+
+  return surface;
+}
+
+static void
+decode_thread (GTask        *task,
+               gpointer      source_object,
+               gpointer      task_data,
+               GCancellable *cancellable)
+{
+  static gint pruned = FALSE;
+  LoadData *data = task_data;
+  cairo_surface_t *surface;
+  gchar *thumbnail_path;
+  GdkPixbuf *pixbuf;
+  GStatBuf source;
+  GError *error;
+
+  surface = NULL;
+  thumbnail_path = NULL;
+
+  /* most users simply have no picture */
+  if (g_stat (data->path, &source) != 0)
+    goto out;
+
+  thumbnail_path = get_thumbnail_path (data);
+  surface = load_thumbnail (thumbnail_path, &source);
+  if (surface != NULL)
+    goto out;
+
+  error = NULL;
+  pixbuf = gdk_pixbuf_new_from_file_at_scale (data->path,
+                                              data->size * data->scale,
+                                              data->size * data->scale,
+                                              TRUE,
+                                              &error);
+  if (pixbuf == NULL)
+    {
+      g_warning ("Couldn't open user icon: %s", error->message);
+      g_error_free (error);
+      goto out;
+    }
+
+  surface = surface_from_pixbuf (pixbuf);
+  g_object_unref (pixbuf);
+  if (surface != NULL)
+    save_thumbnail (thumbnail_path, &source, surface);
+
+ out:
+  if (surface != NULL)
+    cairo_surface_set_device_scale (surface, data->scale, data->scale);
+  g_free (thumbnail_path);
+  g_task_return_pointer (task, surface, (GDestroyNotify) cairo_surface_destroy);
+
+  /* once per session, after the first picture has been handed out */
+  if (g_atomic_int_compare_and_exchange (&pruned, FALSE, TRUE))
+    prune_thumbnails ();
+}
+
+/* takes ownership of @task */
+static void
+decode (GTask *task)
+{
+  LoadData *data = g_task_get_task_data (task);
+
+  if (data->path == NULL || data->path[0] == '\0')
+    g_task_return_pointer (task, NULL, NULL);
+  else
+    g_task_run_in_thread (task, decode_thread);
+  g_object_unref (task);
+}
+
+#if HAVE_ACCOUNTSSERVICE
+/* takes ownership of @task */
+static void
+decode_from_user (GTask      *task,
+                  GDBusProxy *user_proxy)
+{
+  LoadData *data = g_task_get_task_data (task);
+  GVariant *icon_file;
+
+  /* kept current by the proxy, no round trip needed */
+  icon_file = g_dbus_proxy_get_cached_property (user_proxy, "IconFile");
+  if (icon_file != NULL)
+    {
+      if (g_variant_is_of_type (icon_file, G_VARIANT_TYPE_STRING))
+        data->path = g_variant_dup_string (icon_file, NULL);
+      g_variant_unref (icon_file);
+    }
+  if (data->path == NULL)
+    g_warning ("Accounts didn't return a valid filename for user icon");
+
+  decode (task);
+}
+
+static void
+user_proxy_cb (GObject      *source_object,
+               GAsyncResult *res,
+               gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  PolkitMateAvatarLoader *loader = g_task_get_source_object (task);
+  LoadData *data = g_task_get_task_data (task);
+  GDBusProxy *user_proxy;
+  GError *error;
+
+  error = NULL;
+  user_proxy = g_dbus_proxy_new_finish (res, &error);
+  if (user_proxy == NULL)
+    {
+      g_task_return_error (task, error);
+      g_object_unref (task);
+      return;
+    }
+
+  g_hash_table_replace (loader->users, g_strdup (data->user), g_object_ref (user_proxy));
+  decode_from_user (task, user_proxy);
+  g_object_unref (user_proxy);
+}
+
+static void
+find_user_cb (GObject      *source_object,
+              GAsyncResult *res,
+              gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  GDBusProxy *accounts = G_DBUS_PROXY (source_object);
+  GVariant *result;
+  const gchar *user_path;
+  GError *error;
+
+  error = NULL;
+  result = g_dbus_proxy_call_finish (accounts, res, &error);
+  if (result == NULL)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("Accounts couldn't find user: %s", error->message);
+      g_task_return_error (task, error);
+      g_object_unref (task);
+      return;
+    }
+
+  g_variant_get (result, "(&o)", &user_path);
+
+  /* loads all properties with a single call, and follows their changes */
+  g_dbus_proxy_new (g_dbus_proxy_get_connection (accounts),
+                    G_DBUS_PROXY_FLAGS_NONE,
+                    NULL, /* GDBusInterfaceInfo */
+                    "org.freedesktop.Accounts",
+                    user_path,
+                    "org.freedesktop.Accounts.User",
+                    g_task_get_cancellable (task),
+                    user_proxy_cb,
+                    task);
+
+  g_variant_unref (result);
+}
+
+/* takes ownership of @task */
+static void
+find_user (PolkitMateAvatarLoader *loader,
+           GTask                   *task)
+{
+  LoadData *data = g_task_get_task_data (task);
+
+  g_dbus_proxy_call (loader->accounts,
+                     "FindUserByName",
+                     g_variant_new ("(s)", data->user),
+                     G_DBUS_CALL_FLAGS_NONE,
+                     ACCOUNTS_CALL_TIMEOUT,
+                     g_task_get_cancellable (task),
+                     find_user_cb,
+                     task);
+}
+
+static void
+accounts_proxy_cb (GObject      *source_object,
+                   GAsyncResult *res,
+                   gpointer      user_data)
+{
+  PolkitMateAvatarLoader *loader = POLKIT_MATE_AVATAR_LOADER (user_data);
+  GError *error;
+
+  loader->connecting = FALSE;
+
+  error = NULL;
+  loader->accounts = g_dbus_proxy_new_for_bus_finish (res, &error);
+  if (loader->accounts == NULL)
+    g_warning ("Unable to connect to AccountsService: %s", error->message);
+
+  while (loader->waiting_tasks != NULL)
+    {
+      GTask *task = G_TASK (loader->waiting_tasks->data);
+
+      loader->waiting_tasks = g_list_delete_link (loader->waiting_tasks, loader->waiting_tasks);
+      if (loader->accounts != NULL)
+        {
+          find_user (loader, task);
+        }
+      else
+        {
+          g_task_return_error (task, g_error_copy (error));
+          g_object_unref (task);
+        }
+    }
+
+  if (error != NULL)
+    g_error_free (error);
+  g_object_unref (loader);
+}
+#endif /* HAVE_ACCOUNTSSERVICE */
+
+/**
+ * polkit_mate_avatar_loader_load:
+ * @loader: A #PolkitMateAvatarLoader.
+ * @user: The name of the user.
+ * @size: The size of the picture in application pixels.
+ * @scale: The scale factor of the device the picture is shown on.
+ * @cancellable: (allow-none): A #GCancellable or %NULL.
+ * @callback: Function to call when the picture has been loaded.
+ * @user_data: Data to pass to @callback.
+ *
+ * Asynchronously loads the picture of @user, scaled to fit @size at @scale.
+ **/
+void
+polkit_mate_avatar_loader_load (PolkitMateAvatarLoader *loader,
+                                const gchar             *user,
+                                gint                     size,
+                                gint                     scale,
+                                GCancellable            *cancellable,
+                                GAsyncReadyCallback      callback,
+                                gpointer                 user_data)
+{
+  LoadData *data;
+  GTask *task;
+#if HAVE_ACCOUNTSSERVICE
+  GDBusProxy *user_proxy;
+#else
+  PolkitMateUserInfo *info;
+#endif
+
+  data = g_new0 (LoadData, 1);
+  data->user = g_strdup (user);
+  data->size = size;
+  data->scale = MAX (scale, 1);
+
+  task = g_task_new (G_OBJECT (loader), cancellable, callback, user_data);
+  g_task_set_source_tag (task, polkit_mate_avatar_loader_load);
+  g_task_set_task_data (task, data, (GDestroyNotify) load_data_free);
+
+#if HAVE_ACCOUNTSSERVICE
+  user_proxy = g_hash_table_lookup (loader->users, user);
+  if (user_proxy != NULL)
+    {
+      decode_from_user (task, user_proxy);
+      return;
+    }
+
+  if (loader->accounts != NULL)
+    {
+      find_user (loader, task);
+      return;
+    }
+
+  loader->waiting_tasks = g_list_append (loader->waiting_tasks, task);
+  if (!loader->connecting)
+    {
+      loader->connecting = TRUE;
+      g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
+                                G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES |
+                                G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS,
+                                NULL, /* GDBusInterfaceInfo */
+                                "org.freedesktop.Accounts",
+                                "/org/freedesktop/Accounts",
+                                "org.freedesktop.Accounts",
+                                NULL, /* GCancellable */
+                                accounts_proxy_cb,
+                                g_object_ref (loader));
+    }
+#else
+  /* the authenticator has resolved all users already, so this is a cache hit */
+  info = polkit_mate_identity_resolver_lookup_name (polkit_mate_identity_resolver_get_default (), user);
+  if (info != NULL && info->home != NULL)
+    data->path = g_build_filename (info->home, ".face", NULL);
+  if (info != NULL)
+    polkit_mate_user_info_unref (info);
+
+  decode (task);
+#endif
+}
+
+/**
+ * polkit_mate_avatar_loader_load_finish:
+ * @loader: A #PolkitMateAvatarLoader.
+ * @res: A #GAsyncResult obtained from the #GAsyncReadyCallback passed to polkit_mate_avatar_loader_load().
+ * @error: (allow-none): Return location for error or %NULL.
+ *
+ * Finishes loading the picture of a user.
+ *
+ * Returns: An image surface with its device scale set (free with
+ *          cairo_surface_destroy()), or %NULL if the user has no picture
+ *          or @error is set.
+ **/
+cairo_surface_t *
+polkit_mate_avatar_loader_load_finish (PolkitMateAvatarLoader *loader,
+                                       GAsyncResult            *res,
+                                       GError                 **error)
+{
+  GTask *task = G_TASK (res);
+
+  g_warn_if_fail (g_task_get_source_tag (task) == polkit_mate_avatar_loader_load);
+
+  return g_task_propagate_pointer (task, error);
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __POLKIT_MATE_AVATAR_LOADER_H
+#define __POLKIT_MATE_AVATAR_LOADER_H
+
+#include <gio/gio.h>
+#include <cairo.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POLKIT_MATE_TYPE_AVATAR_LOADER          (polkit_mate_avatar_loader_get_type())
+#define POLKIT_MATE_AVATAR_LOADER(o)            (G_TYPE_CHECK_INSTANCE_CAST ((o), POLKIT_MATE_TYPE_AVATAR_LOADER, PolkitMateAvatarLoader))
+#define POLKIT_MATE_AVATAR_LOADER_CLASS(k)      (G_TYPE_CHECK_CLASS_CAST((k), POLKIT_MATE_TYPE_AVATAR_LOADER, PolkitMateAvatarLoaderClass))
+#define POLKIT_MATE_AVATAR_LOADER_GET_CLASS(o)  (G_TYPE_INSTANCE_GET_CLASS ((o), POLKIT_MATE_TYPE_AVATAR_LOADER, PolkitMateAvatarLoaderClass))
+#define POLKIT_MATE_IS_AVATAR_LOADER(o)         (G_TYPE_CHECK_INSTANCE_TYPE ((o), POLKIT_MATE_TYPE_AVATAR_LOADER))
+#define POLKIT_MATE_IS_AVATAR_LOADER_CLASS(k)   (G_TYPE_CHECK_CLASS_TYPE ((k), POLKIT_MATE_TYPE_AVATAR_LOADER))
+
+typedef struct _PolkitMateAvatarLoader PolkitMateAvatarLoader;
+typedef struct _PolkitMateAvatarLoaderClass PolkitMateAvatarLoaderClass;
+
+GType                    polkit_mate_avatar_loader_get_type     (void) G_GNUC_CONST;
+PolkitMateAvatarLoader *polkit_mate_avatar_loader_get_default  (void);
+void                     polkit_mate_avatar_loader_load         (PolkitMateAvatarLoader *loader,
+                                                                 const gchar             *user,
+                                                                 gint                     size,
+                                                                 gint                     scale,
+                                                                 GCancellable            *cancellable,
+                                                                 GAsyncReadyCallback      callback,
+                                                                 gpointer                 user_data);
+cairo_surface_t         *polkit_mate_avatar_loader_load_finish  (PolkitMateAvatarLoader *loader,
+                                                                 GAsyncResult            *res,
+                                                                 GError                 **error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __POLKIT_MATE_AVATAR_LOADER_H */
@@ -0,0 +1,493 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <gio/gio.h>
+
+#include "polkitmatehelperwarmer.h"
+
+/* Every authentication attempt execs polkit-agent-helper-1, which in turn
+ * loads the PAM modules configured for polkit. PolkitAgentSession offers no
+ * way to hand it a process spawned ahead of time, so instead we keep the
+ * files involved in the page cache: after a long idle period the first
+ * attempt otherwise pays for reading them back from disk. The modules are
+ * taken from the PAM configuration of the polkit-1 service, so only those
+ * the helper actually loads are read. */
+
+/* where distributions install the helper */
+static const gchar *helper_paths[] = {
+  "/usr/lib/polkit-1/polkit-agent-helper-1",
+  "/usr/libexec/polkit-agent-helper-1",
+  "/usr/libexec/polkit-1/polkit-agent-helper-1",
+  "/usr/lib/policykit-1/polkit-agent-helper-1",
+};
+
+/* where PAM looks for the configuration of a service */
+static const gchar *pam_config_dirs[] = {
+  "/etc/pam.d",
+  "/usr/lib/pam.d",
+};
+
+/* how deep PAM itself follows includes and substacks */
+#define MAX_PAM_INCLUDE_DEPTH 16
+
+/* parents of the PAM module directory, including multiarch ones */
+static const gchar *library_dirs[] = {
+  "/lib",
+  "/lib64",
+  "/usr/lib",
+  "/usr/lib64",
+};
+
+struct _PolkitMateHelperWarmer
+{
+  GObject parent_instance;
+
+  guint interval;
+  guint idle_timeout;
+
+  guint timeout_id;
+  gint64 last_used;
+  gint64 last_warmed;
+  gboolean warming;
+
+  /* idle for longer than idle_timeout, refreshing only that often */
+  gboolean slow;
+};
+
+struct _PolkitMateHelperWarmerClass
+{
+  GObjectClass parent_class;
+};
+
+G_DEFINE_TYPE (PolkitMateHelperWarmer, polkit_mate_helper_warmer, G_TYPE_OBJECT);
+
+static void rearm (PolkitMateHelperWarmer *warmer);
+
+static void
+polkit_mate_helper_warmer_init (PolkitMateHelperWarmer *warmer)
+{
+}
+
+static void
+polkit_mate_helper_warmer_finalize (GObject *object)
+{
+  PolkitMateHelperWarmer *warmer;
+
+  warmer = POLKIT_MATE_HELPER_WARMER (object);
+
+  if (warmer->timeout_id != 0)
+    g_source_remove (warmer->timeout_id);
+
+  if (G_OBJECT_CLASS (polkit_mate_helper_warmer_parent_class)->finalize != NULL)
+    G_OBJECT_CLASS (polkit_mate_helper_warmer_parent_class)->finalize (object);
+}
+
+static void
+polkit_mate_helper_warmer_class_init (PolkitMateHelperWarmerClass *klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = polkit_mate_helper_warmer_finalize;
+}
+
+static void
+prefetch_file (const gchar *path)
+{
+  gint fd;
+
+  fd = open (path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return;
+
+#ifdef POSIX_FADV_WILLNEED
+  posix_fadvise (fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+  close (fd);
+}
+
+/* the directories modules given without a path are looked up in */
+static GPtrArray *
+find_pam_module_dirs (void)
+{
+  GPtrArray *dirs;
+  guint n;
+
+  dirs = g_ptr_array_new_with_free_func (g_free);
+  for (n = 0; n < G_N_ELEMENTS (library_dirs); n++)
+    {
+      GDir *dir;
+      const gchar *name;
+      gchar *path;
+
+      path = g_build_filename (library_dirs[n], "security", NULL);
+      if (g_file_test (path, G_FILE_TEST_IS_DIR))
+        g_ptr_array_add (dirs, path);
+      else
+        g_free (path);
+
+      /* multiarch, e.g. /usr/lib/x86_64-linux-gnu/security */
+      dir = g_dir_open (library_dirs[n], 0, NULL);
+      if (dir == NULL)
+        continue;
+      while ((name = g_dir_read_name (dir)) != NULL)
+        {
+          if (strchr (name, '-') == NULL)
+            continue;
+
+          path = g_build_filename (library_dirs[n], name, "security", NULL);
+          if (g_file_test (path, G_FILE_TEST_IS_DIR))
+            g_ptr_array_add (dirs, path);
+          else
+            g_free (path);
+        }
+      g_dir_close (dir);
+    }
+
+  return dirs;
+}
+
+static gchar *
+find_pam_config (const gchar *service)
+{
+  guint n;
+
+  for (n = 0; n < G_N_ELEMENTS (pam_config_dirs); n++)
+    {
+      gchar *path;
+
+      path = g_build_filename (pam_config_dirs[n], service, NULL);
+      if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
+        return path;
+      g_free (path);
+    }
+
+  return NULL;
+}
+
+/* splits off the next field of a configuration line; a control field in
+ * brackets may contain blanks */
+static gchar *
+next_field (gchar **line)
+{
+  gchar *start;
+  gchar *end;
+
+  start = *line;
+  while (g_ascii_isspace (*start))
+    start++;
+  if (*start == '\0')
+    return NULL;
+
+  end = start;
+  if (*end == '[')
+    {
+      end = strchr (end, ']');
+      if (end == NULL)
+        return NULL;
+      end++;
+    }
+  while (*end != '\0' && !g_ascii_isspace (*end))
+    end++;
+
+  *line = end;
+  if (*end != '\0')
+    {
+      *end = '\0';
+      (*line)++;
+    }
+
+  return start;
+}
+
+/* adds the modules the configuration of @service loads to @modules */
+static void
+collect_pam_modules (const gchar *service,
+                     GHashTable  *modules,
+                     GHashTable  *visited,
+                     guint        depth)
+{
+  gchar *path;
+  gchar *contents;
+  gchar **lines;
+  guint n;
+
+  if (depth > MAX_PAM_INCLUDE_DEPTH || g_hash_table_contains (visited, service))
+    return;
+  g_hash_table_add (visited, g_strdup (service));
+
+  path = find_pam_config (service);
+  if (path == NULL)
+    return;
+  if (!g_file_get_contents (path, &contents, NULL, NULL))
+    {
+      g_free (path);
+      return;
+    }
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (n = 0; lines[n] != NULL; n++)
+    {
+      gchar *line = lines[n];
+      gchar *comment;
+      gchar *type;
+      gchar *control;
+      gchar *module;
+
+      comment = strchr (line, '#');
+      if (comment != NULL)
+        *comment = '\0';
+
+      type = next_field (&line);
+      control = next_field (&line);
+      if (type == NULL || control == NULL)
+        continue;
+
+      if (g_strcmp0 (type, "@include") == 0)
+        {
+          collect_pam_modules (control, modules, visited, depth + 1);
+          continue;
+        }
+
+      module = next_field (&line);
+      if (module == NULL)
+        continue;
+
+      if (g_strcmp0 (control, "include") == 0 || g_strcmp0 (control, "substack") == 0)
+        collect_pam_modules (module, modules, visited, depth + 1);
+      else
+        g_hash_table_add (modules, g_strdup (module));
+    }
+
+  g_strfreev (lines);
+  g_free (contents);
+  g_free (path);
+}
+
+static void
+prefetch_pam_module (const gchar *module,
+                     GPtrArray   *module_dirs)
+{
+  guint n;
+
+  if (g_path_is_absolute (module))
+    {
+      prefetch_file (module);
+      return;
+    }
+
+  for (n = 0; n < module_dirs->len; n++)
+    {
+      gchar *path;
+
+      path = g_build_filename (g_ptr_array_index (module_dirs, n), module, NULL);
+      if (g_file_test (path, G_FILE_TEST_EXISTS))
+        {
+          prefetch_file (path);
+          g_free (path);
+          return;
+        }
+      g_free (path);
+    }
+}
+
+static void
+warm_thread_func (GTask        *task,
+                  gpointer      source_object,
+                  gpointer      task_data,
+                  GCancellable *cancellable)
+{
+  GHashTable *modules;
+  GHashTable *visited;
+  GHashTableIter iter;
+  GPtrArray *module_dirs;
+  const gchar *module;
+  gchar *path;
+  guint n;
+
+  for (n = 0; n < G_N_ELEMENTS (helper_paths); n++)
+    prefetch_file (helper_paths[n]);
+
+  modules = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  /* PAM falls back to "other" for services without a configuration */
+  path = find_pam_config ("polkit-1");
+  collect_pam_modules (path != NULL ? "polkit-1" : "other", modules, visited, 0);
+  g_free (path);
+
+  module_dirs = find_pam_module_dirs ();
+  g_hash_table_iter_init (&iter, modules);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &module, NULL))
+    prefetch_pam_module (module, module_dirs);
+
+  g_ptr_array_unref (module_dirs);
+  g_hash_table_unref (visited);
+  g_hash_table_unref (modules);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+warm_cb (GObject      *source_object,
+         GAsyncResult *res,
+         gpointer      user_data)
+{
+  PolkitMateHelperWarmer *warmer = POLKIT_MATE_HELPER_WARMER (source_object);
+
+  warmer->warming = FALSE;
+  warmer->last_warmed = g_get_monotonic_time ();
+}
+
+static void
+warm (PolkitMateHelperWarmer *warmer)
+{
+  GTask *task;
+
+  if (warmer->warming)
+    return;
+
+  warmer->warming = TRUE;
+  task = g_task_new (G_OBJECT (warmer), NULL, warm_cb, NULL);
+  g_task_set_source_tag (task, warm);
+  g_task_set_priority (task, G_PRIORITY_LOW);
+  g_task_run_in_thread (task, warm_thread_func);
+  g_object_unref (task);
+}
+
+static gboolean
+on_timeout (gpointer user_data)
+{
+  PolkitMateHelperWarmer *warmer = POLKIT_MATE_HELPER_WARMER (user_data);
+
+  /* nobody has authenticated for a long time; wake up less often, but
+   * keep refreshing, or the first request after a long break would read
+   * the files at the same time as the helper */
+  if (!warmer->slow &&
+      g_get_monotonic_time () - warmer->last_used >= (gint64) warmer->idle_timeout * G_TIME_SPAN_SECOND)
+    {
+      warmer->slow = TRUE;
+      warmer->timeout_id = 0;
+      rearm (warmer);
+      warm (warmer);
+      return FALSE;
+    }
+
+  warm (warmer);
+
+  return TRUE;
+}
+
+static void
+rearm (PolkitMateHelperWarmer *warmer)
+{
+  if (warmer->timeout_id != 0)
+    {
+      g_source_remove (warmer->timeout_id);
+      warmer->timeout_id = 0;
+    }
+
+  if (warmer->interval == 0)
+    return;
+
+  warmer->timeout_id = g_timeout_add_seconds (warmer->slow ? MAX (warmer->interval, warmer->idle_timeout) : warmer->interval,
+                                              on_timeout,
+                                              warmer);
+}
+
+/**
+ * polkit_mate_helper_warmer_new:
+ *
+ * Creates a warmer that does nothing until polkit_mate_helper_warmer_touch()
+ * is called.
+ *
+ * Returns: A new #PolkitMateHelperWarmer.
+ **/
+PolkitMateHelperWarmer *
+polkit_mate_helper_warmer_new (void)
+{
+  return POLKIT_MATE_HELPER_WARMER (g_object_new (POLKIT_MATE_TYPE_HELPER_WARMER, NULL));
+}
+
+/**
+ * polkit_mate_helper_warmer_set_interval:
+ * @warmer: A #PolkitMateHelperWarmer.
+ * @seconds: How often to refresh the page cache, 0 to never do it.
+ *
+ * Sets how often the helper and the PAM modules are read ahead.
+ **/
+void
+polkit_mate_helper_warmer_set_interval (PolkitMateHelperWarmer *warmer,
+                                        guint                    seconds)
+{
+  warmer->interval = seconds;
+  if (warmer->timeout_id != 0 || seconds == 0)
+    rearm (warmer);
+}
+
+/**
+ * polkit_mate_helper_warmer_set_idle_timeout:
+ * @warmer: A #PolkitMateHelperWarmer.
+ * @seconds: How long to keep refreshing after the last authentication.
+ *
+ * Sets after how long without authentication requests @warmer only
+ * refreshes once every @seconds, until it is touched again.
+ **/
+void
+polkit_mate_helper_warmer_set_idle_timeout (PolkitMateHelperWarmer *warmer,
+                                            guint                    seconds)
+{
+  warmer->idle_timeout = seconds;
+}
+
+/**
+ * polkit_mate_helper_warmer_touch:
+ * @warmer: A #PolkitMateHelperWarmer.
+ *
+ * Notes that an authentication is about to happen. The files are read
+ * ahead in a worker thread unless that was done within the last interval,
+ * and periodic refreshing is (re)started.
+ **/
+void
+polkit_mate_helper_warmer_touch (PolkitMateHelperWarmer *warmer)
+{
+  gint64 now;
+
+  if (warmer->interval == 0)
+    return;
+
+  now = g_get_monotonic_time ();
+  warmer->last_used = now;
+
+  if (warmer->last_warmed == 0 ||
+      now - warmer->last_warmed >= (gint64) warmer->interval * G_TIME_SPAN_SECOND)
+    warm (warmer);
+
+  if (warmer->timeout_id == 0 || warmer->slow)
+    {
+      warmer->slow = FALSE;
+      rearm (warmer);
+    }
+}
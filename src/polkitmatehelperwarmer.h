@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __POLKIT_MATE_HELPER_WARMER_H
+#define __POLKIT_MATE_HELPER_WARMER_H
+
+#include <glib-object.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POLKIT_MATE_TYPE_HELPER_WARMER          (polkit_mate_helper_warmer_get_type())
+#define POLKIT_MATE_HELPER_WARMER(o)            (G_TYPE_CHECK_INSTANCE_CAST ((o), POLKIT_MATE_TYPE_HELPER_WARMER, PolkitMateHelperWarmer))
+#define POLKIT_MATE_HELPER_WARMER_CLASS(k)      (G_TYPE_CHECK_CLASS_CAST((k), POLKIT_MATE_TYPE_HELPER_WARMER, PolkitMateHelperWarmerClass))
+#define POLKIT_MATE_HELPER_WARMER_GET_CLASS(o)  (G_TYPE_INSTANCE_GET_CLASS ((o), POLKIT_MATE_TYPE_HELPER_WARMER, PolkitMateHelperWarmerClass))
+#define POLKIT_MATE_IS_HELPER_WARMER(o)         (G_TYPE_CHECK_INSTANCE_TYPE ((o), POLKIT_MATE_TYPE_HELPER_WARMER))
+#define POLKIT_MATE_IS_HELPER_WARMER_CLASS(k)   (G_TYPE_CHECK_CLASS_TYPE ((k), POLKIT_MATE_TYPE_HELPER_WARMER))
+
+typedef struct _PolkitMateHelperWarmer PolkitMateHelperWarmer;
+typedef struct _PolkitMateHelperWarmerClass PolkitMateHelperWarmerClass;
+
+GType                    polkit_mate_helper_warmer_get_type         (void) G_GNUC_CONST;
+PolkitMateHelperWarmer *polkit_mate_helper_warmer_new              (void);
+void                     polkit_mate_helper_warmer_set_interval     (PolkitMateHelperWarmer *warmer,
+                                                                     guint                    seconds);
+void                     polkit_mate_helper_warmer_set_idle_timeout (PolkitMateHelperWarmer *warmer,
+                                                                     guint                    seconds);
+void                     polkit_mate_helper_warmer_touch            (PolkitMateHelperWarmer *warmer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __POLKIT_MATE_HELPER_WARMER_H */
@@ -0,0 +1,399 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <unistd.h>
+#include <errno.h>
+#include <pwd.h>
+
+#include "polkitmateidentityresolver.h"
+
+/* how long a password database entry is trusted before it is looked up again */
+#define USER_INFO_TTL (5 * G_TIME_SPAN_MINUTE)
+
+/* upper bound for the getpw*_r() scratch buffer */
+#define MAX_PASSWD_BUFFER_SIZE (1024 * 1024)
+
+struct _PolkitMateIdentityResolver
+{
+  GObject parent_instance;
+
+  /* uid -> PolkitMateUserInfo */
+  GHashTable *by_uid;
+
+  /* name -> PolkitMateUserInfo, the key is owned by the value */
+  GHashTable *by_name;
+};
+
+struct _PolkitMateIdentityResolverClass
+{
+  GObjectClass parent_class;
+};
+
+G_DEFINE_TYPE (PolkitMateIdentityResolver, polkit_mate_identity_resolver, G_TYPE_OBJECT);
+
+PolkitMateUserInfo *
+polkit_mate_user_info_ref (PolkitMateUserInfo *info)
+{
+  g_atomic_int_inc (&info->ref_count);
+  return info;
+}
+
+void
+polkit_mate_user_info_unref (PolkitMateUserInfo *info)
+{
+  if (!g_atomic_int_dec_and_test (&info->ref_count))
+    return;
+
+  g_free (info->name);
+  g_free (info->gecos);
+  g_free (info->home);
+  g_free (info);
+}
+
+static PolkitMateUserInfo *
+user_info_new (const struct passwd *passwd)
+{
+  PolkitMateUserInfo *info;
+
+  info = g_new0 (PolkitMateUserInfo, 1);
+  info->ref_count = 1;
+  info->expires = g_get_monotonic_time () + USER_INFO_TTL;
+  info->uid = passwd->pw_uid;
+  info->name = g_strdup (passwd->pw_name);
+  if (passwd->pw_gecos != NULL)
+    info->gecos = g_locale_to_utf8 (passwd->pw_gecos, -1, NULL, NULL, NULL);
+  info->home = g_strdup (passwd->pw_dir);
+
+  return info;
+}
+
+/* Looks up @uid. This may block for a long time with network backends
+ * and is only called from worker threads.
+ */
+static PolkitMateUserInfo *
+lookup_passwd (uid_t uid)
+{
+  PolkitMateUserInfo *info;
+  struct passwd passwd;
+  struct passwd *result;
+  gchar *buffer;
+  glong buffer_size;
+  gint rc;
+
+  buffer_size = sysconf (_SC_GETPW_R_SIZE_MAX);
+  if (buffer_size <= 0)
+    buffer_size = 16384;
+
+  for (;;)
+    {
+      buffer = g_malloc (buffer_size);
+      result = NULL;
+      rc = getpwuid_r (uid, &passwd, buffer, buffer_size, &result);
+
+      if (rc != ERANGE || buffer_size >= MAX_PASSWD_BUFFER_SIZE)
+        break;
+
+      g_free (buffer);
+      buffer_size *= 2;
+    }
+
+  info = NULL;
+  if (result != NULL)
+    {
+      info = user_info_new (result);
+    }
+  else if (rc != 0)
+    {
+      g_warning ("Error looking up uid %d: %s", (gint) uid, g_strerror (rc));
+    }
+
+  g_free (buffer);
+
+  return info;
+}
+
+static void
+polkit_mate_identity_resolver_init (PolkitMateIdentityResolver *resolver)
+{
+  resolver->by_uid = g_hash_table_new_full (g_direct_hash,
+                                            g_direct_equal,
+                                            NULL,
+                                            (GDestroyNotify) polkit_mate_user_info_unref);
+  resolver->by_name = g_hash_table_new_full (g_str_hash,
+                                             g_str_equal,
+                                             NULL,
+                                             (GDestroyNotify) polkit_mate_user_info_unref);
+}
+
+static void
+polkit_mate_identity_resolver_finalize (GObject *object)
+{
+  PolkitMateIdentityResolver *resolver;
+
+  resolver = POLKIT_MATE_IDENTITY_RESOLVER (object);
+
+  g_hash_table_unref (resolver->by_uid);
+  g_hash_table_unref (resolver->by_name);
+
+  if (G_OBJECT_CLASS (polkit_mate_identity_resolver_parent_class)->finalize != NULL)
+    G_OBJECT_CLASS (polkit_mate_identity_resolver_parent_class)->finalize (object);
+}
+
+static void
+polkit_mate_identity_resolver_class_init (PolkitMateIdentityResolverClass *klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = polkit_mate_identity_resolver_finalize;
+}
+
+/**
+ * polkit_mate_identity_resolver_get_default:
+ *
+ * Gets the resolver shared by the whole agent.
+ *
+ * Returns: (transfer none): A #PolkitMateIdentityResolver.
+ **/
+PolkitMateIdentityResolver *
+polkit_mate_identity_resolver_get_default (void)
+{
+  static PolkitMateIdentityResolver *resolver = NULL;
+
+  if (resolver == NULL)
+    resolver = POLKIT_MATE_IDENTITY_RESOLVER (g_object_new (POLKIT_MATE_TYPE_IDENTITY_RESOLVER, NULL));
+
+  return resolver;
+}
+
+static void
+insert_info (PolkitMateIdentityResolver *resolver,
+             PolkitMateUserInfo         *info)
+{
+  g_hash_table_replace (resolver->by_uid,
+                        GUINT_TO_POINTER (info->uid),
+                        polkit_mate_user_info_ref (info));
+  g_hash_table_replace (resolver->by_name,
+                        info->name,
+                        polkit_mate_user_info_ref (info));
+}
+
+static PolkitMateUserInfo *
+lookup_cached (GHashTable    *table,
+               gconstpointer  key)
+{
+  PolkitMateUserInfo *info;
+
+  info = g_hash_table_lookup (table, key);
+  if (info != NULL && info->expires < g_get_monotonic_time ())
+    info = NULL;
+
+  return info;
+}
+
+static void
+return_from_cache (PolkitMateIdentityResolver *resolver,
+                   GTask                       *task)
+{
+  GArray *uids;
+  GPtrArray *infos;
+  guint n;
+
+  uids = g_task_get_task_data (task);
+
+  infos = g_ptr_array_new_with_free_func ((GDestroyNotify) polkit_mate_user_info_unref);
+  for (n = 0; n < uids->len; n++)
+    {
+      PolkitMateUserInfo *info;
+
+      info = g_hash_table_lookup (resolver->by_uid,
+                                  GUINT_TO_POINTER (g_array_index (uids, uid_t, n)));
+      if (info != NULL)
+        g_ptr_array_add (infos, polkit_mate_user_info_ref (info));
+    }
+
+  g_task_return_pointer (task, infos, (GDestroyNotify) g_ptr_array_unref);
+}
+
+static void
+resolve_in_thread (GTask        *task,
+                   gpointer      source_object,
+                   gpointer      task_data,
+                   GCancellable *cancellable)
+{
+  GArray *uids = task_data;
+  GPtrArray *infos;
+  guint n;
+
+  infos = g_ptr_array_new_with_free_func ((GDestroyNotify) polkit_mate_user_info_unref);
+  for (n = 0; n < uids->len; n++)
+    {
+      PolkitMateUserInfo *info;
+
+      if (g_task_return_error_if_cancelled (task))
+        {
+          g_ptr_array_unref (infos);
+          return;
+        }
+
+      info = lookup_passwd (g_array_index (uids, uid_t, n));
+      if (info != NULL)
+        g_ptr_array_add (infos, info);
+    }
+
+  g_task_return_pointer (task, infos, (GDestroyNotify) g_ptr_array_unref);
+}
+
+static void
+resolved_cb (GObject      *source_object,
+             GAsyncResult *res,
+             gpointer      user_data)
+{
+  PolkitMateIdentityResolver *resolver = POLKIT_MATE_IDENTITY_RESOLVER (source_object);
+  GTask *task = G_TASK (user_data);
+  GPtrArray *resolved;
+  GError *error;
+  guint n;
+
+  error = NULL;
+  resolved = g_task_propagate_pointer (G_TASK (res), &error);
+  if (resolved == NULL)
+    {
+      g_task_return_error (task, error);
+      goto out;
+    }
+
+  /* the cache is only ever touched from the main thread */
+  for (n = 0; n < resolved->len; n++)
+    insert_info (resolver, g_ptr_array_index (resolved, n));
+  g_ptr_array_unref (resolved);
+
+  return_from_cache (resolver, task);
+
+ out:
+  g_object_unref (task);
+}
+
+/**
+ * polkit_mate_identity_resolver_lookup_uids:
+ * @resolver: A #PolkitMateIdentityResolver.
+ * @uids: The user ids to resolve.
+ * @n_uids: Number of elements in @uids.
+ * @cancellable: (allow-none): A #GCancellable or %NULL.
+ * @callback: Function to call when the users have been resolved.
+ * @user_data: Data to pass to @callback.
+ *
+ * Resolves @uids. Cached entries are used as long as they are fresh; all
+ * other ids are looked up together in a single job on the GIO worker pool
+ * so a slow NSS backend never blocks the main loop.
+ **/
+void
+polkit_mate_identity_resolver_lookup_uids (PolkitMateIdentityResolver *resolver,
+                                           const uid_t                 *uids,
+                                           guint                        n_uids,
+                                           GCancellable                *cancellable,
+                                           GAsyncReadyCallback          callback,
+                                           gpointer                     user_data)
+{
+  GTask *task;
+  GTask *thread_task;
+  GArray *requested;
+  GArray *misses;
+  guint n;
+
+  task = g_task_new (G_OBJECT (resolver), cancellable, callback, user_data);
+  g_task_set_source_tag (task, polkit_mate_identity_resolver_lookup_uids);
+
+  requested = g_array_sized_new (FALSE, FALSE, sizeof (uid_t), n_uids);
+  g_array_append_vals (requested, uids, n_uids);
+  g_task_set_task_data (task, requested, (GDestroyNotify) g_array_unref);
+
+  misses = g_array_new (FALSE, FALSE, sizeof (uid_t));
+  for (n = 0; n < n_uids; n++)
+    {
+      if (lookup_cached (resolver->by_uid, GUINT_TO_POINTER (uids[n])) == NULL)
+        g_array_append_val (misses, uids[n]);
+    }
+
+  if (misses->len == 0)
+    {
+      g_array_unref (misses);
+      return_from_cache (resolver, task);
+      g_object_unref (task);
+      return;
+    }
+
+  thread_task = g_task_new (G_OBJECT (resolver), cancellable, resolved_cb, task);
+  g_task_set_task_data (thread_task, misses, (GDestroyNotify) g_array_unref);
+  g_task_run_in_thread (thread_task, resolve_in_thread);
+  g_object_unref (thread_task);
+}
+
+/**
+ * polkit_mate_identity_resolver_lookup_uids_finish:
+ * @resolver: A #PolkitMateIdentityResolver.
+ * @res: A #GAsyncResult obtained from the #GAsyncReadyCallback passed to polkit_mate_identity_resolver_lookup_uids().
+ * @error: (allow-none): Return location for error or %NULL.
+ *
+ * Finishes resolving user ids. Ids without a password database entry are
+ * left out of the result.
+ *
+ * Returns: A #GPtrArray of #PolkitMateUserInfo in request order (free with
+ *          g_ptr_array_unref()) or %NULL if @error is set.
+ **/
+GPtrArray *
+polkit_mate_identity_resolver_lookup_uids_finish (PolkitMateIdentityResolver *resolver,
+                                                  GAsyncResult                *res,
+                                                  GError                     **error)
+{
+  GTask *task = G_TASK (res);
+
+  g_warn_if_fail (g_task_get_source_tag (task) == polkit_mate_identity_resolver_lookup_uids);
+
+  return g_task_propagate_pointer (task, error);
+}
+
+/**
+ * polkit_mate_identity_resolver_lookup_name:
+ * @resolver: A #PolkitMateIdentityResolver.
+ * @name: A login name.
+ *
+ * Looks up @name among the users resolved with
+ * polkit_mate_identity_resolver_lookup_uids(). This never blocks: an
+ * entry past its expiry is still returned, as it is only refreshed off
+ * the main thread, and a user never resolved is not looked up.
+ *
+ * Returns: A #PolkitMateUserInfo (free with polkit_mate_user_info_unref()) or
+ *          %NULL if @name has not been resolved.
+ **/
+PolkitMateUserInfo *
+polkit_mate_identity_resolver_lookup_name (PolkitMateIdentityResolver *resolver,
+                                           const gchar                 *name)
+{
+  PolkitMateUserInfo *info;
+
+  info = g_hash_table_lookup (resolver->by_name, name);
+  if (info == NULL)
+    return NULL;
+
+  return polkit_mate_user_info_ref (info);
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __POLKIT_MATE_IDENTITY_RESOLVER_H
+#define __POLKIT_MATE_IDENTITY_RESOLVER_H
+
+#include <sys/types.h>
+#include <gio/gio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POLKIT_MATE_TYPE_IDENTITY_RESOLVER          (polkit_mate_identity_resolver_get_type())
+#define POLKIT_MATE_IDENTITY_RESOLVER(o)            (G_TYPE_CHECK_INSTANCE_CAST ((o), POLKIT_MATE_TYPE_IDENTITY_RESOLVER, PolkitMateIdentityResolver))
+#define POLKIT_MATE_IDENTITY_RESOLVER_CLASS(k)      (G_TYPE_CHECK_CLASS_CAST((k), POLKIT_MATE_TYPE_IDENTITY_RESOLVER, PolkitMateIdentityResolverClass))
+#define POLKIT_MATE_IDENTITY_RESOLVER_GET_CLASS(o)  (G_TYPE_INSTANCE_GET_CLASS ((o), POLKIT_MATE_TYPE_IDENTITY_RESOLVER, PolkitMateIdentityResolverClass))
+#define POLKIT_MATE_IS_IDENTITY_RESOLVER(o)         (G_TYPE_CHECK_INSTANCE_TYPE ((o), POLKIT_MATE_TYPE_IDENTITY_RESOLVER))
+#define POLKIT_MATE_IS_IDENTITY_RESOLVER_CLASS(k)   (G_TYPE_CHECK_CLASS_TYPE ((k), POLKIT_MATE_TYPE_IDENTITY_RESOLVER))
+
+typedef struct _PolkitMateIdentityResolver PolkitMateIdentityResolver;
+typedef struct _PolkitMateIdentityResolverClass PolkitMateIdentityResolverClass;
+typedef struct _PolkitMateUserInfo PolkitMateUserInfo;
+
+/**
+ * PolkitMateUserInfo:
+ * @uid: The user id.
+ * @name: The login name.
+ * @gecos: The GECOS field converted to UTF-8, or %NULL.
+ * @home: The home directory, or %NULL.
+ *
+ * An immutable, reference counted snapshot of a password database entry.
+ **/
+struct _PolkitMateUserInfo
+{
+  /*< private >*/
+  gint ref_count;
+  gint64 expires;
+
+  /*< public >*/
+  uid_t uid;
+  gchar *name;
+  gchar *gecos;
+  gchar *home;
+};
+
+PolkitMateUserInfo          *polkit_mate_user_info_ref                          (PolkitMateUserInfo          *info);
+void                         polkit_mate_user_info_unref                        (PolkitMateUserInfo          *info);
+
+GType                        polkit_mate_identity_resolver_get_type             (void) G_GNUC_CONST;
+PolkitMateIdentityResolver *polkit_mate_identity_resolver_get_default          (void);
+void                         polkit_mate_identity_resolver_lookup_uids          (PolkitMateIdentityResolver *resolver,
+                                                                                  const uid_t                 *uids,
+                                                                                  guint                        n_uids,
+                                                                                  GCancellable                *cancellable,
+                                                                                  GAsyncReadyCallback          callback,
+                                                                                  gpointer                     user_data);
+GPtrArray                   *polkit_mate_identity_resolver_lookup_uids_finish   (PolkitMateIdentityResolver *resolver,
+                                                                                  GAsyncResult                *res,
+                                                                                  GError                     **error);
+PolkitMateUserInfo          *polkit_mate_identity_resolver_lookup_name          (PolkitMateIdentityResolver *resolver,
+                                                                                  const gchar                 *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __POLKIT_MATE_IDENTITY_RESOLVER_H */
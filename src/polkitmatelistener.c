@@ -27,15 +27,107 @@
 
 #include "polkitmatelistener.h"
 #include "polkitmateauthenticator.h"
+#include "polkitmateactioncache.h"
+#include "polkitmatescheduler.h"
+#include "polkitmatehelperwarmer.h"
+#include "polkitmateretrypolicy.h"
+#include "polkitmateuserhistory.h"
+
+/* defaults for the admission and concurrency tunables */
+#define DEFAULT_MAX_DIALOGS 4
+#define DEFAULT_MAX_REQUESTS 128
+#define DEFAULT_MAX_REQUESTS_PER_SUBJECT 16
+#define DEFAULT_DISMISSAL_WINDOW 10
+#define DEFAULT_HELPER_WARM_INTERVAL 600
+#define DEFAULT_HELPER_IDLE_TIMEOUT 3600
+#define DEFAULT_MAX_ATTEMPTS 3
+#define DEFAULT_RETRY_BACKOFF 0
+
+/* how many users and actions the prompts of the last conversation are kept for */
+#define MAX_PROMPT_SEQUENCES 64
+
+typedef enum
+{
+  PRIORITY_INTERACTIVE,
+  PRIORITY_NORMAL,
+  PRIORITY_BACKGROUND,
+  N_PRIORITIES
+} RequestPriority;
+
+/* Queued requests are served earliest deadline first. The deadline is the
+ * arrival time plus the latency budget of the priority class, so background
+ * requests yield to interactive ones without being starved by them. */
+static const gint64 priority_latency[N_PRIORITIES] = {
+  0,                        /* PRIORITY_INTERACTIVE */
+  10 * G_TIME_SPAN_SECOND,  /* PRIORITY_NORMAL */
+  60 * G_TIME_SPAN_SECOND,  /* PRIORITY_BACKGROUND */
+};
+
+/* first match wins; anything else is PRIORITY_NORMAL. A rule naming a
+ * detail only matches requests that carry it with a matching value */
+static const struct
+{
+  const gchar *action_pattern;
+  const gchar *detail;
+  const gchar *value_pattern;
+  RequestPriority priority;
+} priority_rules[] = {
+  { "org.freedesktop.login1.*",         NULL,       NULL,          PRIORITY_INTERACTIVE },
+  { "org.mate.*",                       NULL,       NULL,          PRIORITY_INTERACTIVE },
+  /* pkexec, whatever action it runs under; someone is waiting at a terminal */
+  { "*",                                "program",  "*",           PRIORITY_INTERACTIVE },
+  /* packages the user asked for, rather than updates */
+  { "org.freedesktop.packagekit.*",     "role",     "install-*",   PRIORITY_NORMAL },
+  { "org.freedesktop.packagekit.*",     NULL,       NULL,          PRIORITY_BACKGROUND },
+  { "org.freedesktop.fwupd.*",          NULL,       NULL,          PRIORITY_BACKGROUND },
+};
 
 struct _PolkitMateListener
 {
   PolkitAgentListener parent_instance;
 
-  /* we support multiple authenticators - they are simply queued up */
-  GList *authenticators;
+  PolkitAuthority *authority;
+
+  /* action descriptions, indexed by action id */
+  PolkitMateActionCache *action_cache;
 
-  PolkitMateAuthenticator *active_authenticator;
+  /* AuthData for requests waiting for a dialog slot, most urgent first */
+  PolkitMateScheduler *pending;
+
+  /* AuthData for requests whose dialog is currently shown */
+  GList *active;
+
+  /* global cap on the number of dialogs shown at the same time */
+  guint max_dialogs;
+
+  /* admission control: outstanding requests in total and per subject */
+  guint max_requests;
+  guint max_requests_per_subject;
+  guint num_requests;
+  GHashTable *requests_per_subject;
+
+  /* "subject\naction_id" -> Dismissal, for requests the user dismissed recently */
+  GHashTable *dismissals;
+  guint dismissal_window;
+  guint num_suppressed;
+
+  /* coalescing key -> AuthData still accepting equivalent requests */
+  GHashTable *groups;
+
+  /* keeps the authentication helper and PAM modules in the page cache */
+  PolkitMateHelperWarmer *helper_warmer;
+  guint helper_warm_interval;
+  guint helper_idle_timeout;
+
+  /* handed to every authenticator created from now on */
+  PolkitMateRetryPolicy *retry_policy;
+  guint max_attempts;
+  guint retry_backoff;
+  gboolean parallel_factors;
+  PolkitMatePromptSequences *prompt_sequences;
+
+  /* set by polkit_mate_listener_shutdown(); new requests are refused */
+  gboolean shutting_down;
 };
 
 struct _PolkitMateListenerClass
@@ -43,6 +135,21 @@ struct _PolkitMateListenerClass
   PolkitAgentListenerClass parent_class;
 };
 
+enum
+{
+  PROP_0,
+  PROP_MAX_DIALOGS,
+  PROP_MAX_REQUESTS,
+  PROP_MAX_REQUESTS_PER_SUBJECT,
+  PROP_DISMISSAL_WINDOW,
+  PROP_NUM_SUPPRESSED,
+  PROP_HELPER_WARM_INTERVAL,
+  PROP_HELPER_IDLE_TIMEOUT,
+  PROP_MAX_ATTEMPTS,
+  PROP_RETRY_BACKOFF,
+  PROP_PARALLEL_FACTORS,
+};
+
 static void polkit_mate_listener_initiate_authentication (PolkitAgentListener  *listener,
                                                            const gchar          *action_id,
                                                            const gchar          *message,
@@ -58,20 +165,172 @@ static gboolean polkit_mate_listener_initiate_authentication_finish (PolkitAgent
                                                                       GAsyncResult         *res,
                                                                       GError              **error);
 
+static void maybe_initiate_next_authenticator (PolkitMateListener *listener);
+static void update_retry_policy (PolkitMateListener *listener);
+
 G_DEFINE_TYPE (PolkitMateListener, polkit_mate_listener, POLKIT_AGENT_TYPE_LISTENER);
 
 static void
 polkit_mate_listener_init (PolkitMateListener *listener)
 {
+  listener->max_dialogs = DEFAULT_MAX_DIALOGS;
+  listener->max_requests = DEFAULT_MAX_REQUESTS;
+  listener->max_requests_per_subject = DEFAULT_MAX_REQUESTS_PER_SUBJECT;
+  listener->requests_per_subject = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  listener->dismissal_window = DEFAULT_DISMISSAL_WINDOW;
+  listener->dismissals = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  listener->helper_warm_interval = DEFAULT_HELPER_WARM_INTERVAL;
+  listener->helper_idle_timeout = DEFAULT_HELPER_IDLE_TIMEOUT;
+  listener->helper_warmer = polkit_mate_helper_warmer_new ();
+  polkit_mate_helper_warmer_set_interval (listener->helper_warmer, listener->helper_warm_interval);
+  polkit_mate_helper_warmer_set_idle_timeout (listener->helper_warmer, listener->helper_idle_timeout);
+  listener->groups = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  listener->pending = polkit_mate_scheduler_new ();
+  listener->max_attempts = DEFAULT_MAX_ATTEMPTS;
+  listener->retry_backoff = DEFAULT_RETRY_BACKOFF;
+  update_retry_policy (listener);
+  listener->prompt_sequences = polkit_mate_prompt_sequences_new (MAX_PROMPT_SEQUENCES);
 }
 
 static void
 polkit_mate_listener_finalize (GObject *object)
 {
+  PolkitMateListener *listener;
+
+  listener = POLKIT_MATE_LISTENER (object);
+
+  if (listener->action_cache != NULL)
+    g_object_unref (listener->action_cache);
+  if (listener->authority != NULL)
+    g_object_unref (listener->authority);
+  g_hash_table_unref (listener->groups);
+  polkit_mate_scheduler_free (listener->pending);
+  g_hash_table_unref (listener->requests_per_subject);
+  g_hash_table_unref (listener->dismissals);
+  g_object_unref (listener->helper_warmer);
+  polkit_mate_retry_policy_unref (listener->retry_policy);
+  polkit_mate_prompt_sequences_unref (listener->prompt_sequences);
+
   if (G_OBJECT_CLASS (polkit_mate_listener_parent_class)->finalize != NULL)
     G_OBJECT_CLASS (polkit_mate_listener_parent_class)->finalize (object);
 }
 
+static void
+polkit_mate_listener_set_property (GObject      *object,
+                                   guint         prop_id,
+                                   const GValue *value,
+                                   GParamSpec   *pspec)
+{
+  PolkitMateListener *listener = POLKIT_MATE_LISTENER (object);
+
+  switch (prop_id)
+    {
+    case PROP_MAX_DIALOGS:
+      listener->max_dialogs = g_value_get_uint (value);
+      /* raising the cap may free up slots for queued requests */
+      maybe_initiate_next_authenticator (listener);
+      break;
+
+    case PROP_MAX_REQUESTS:
+      listener->max_requests = g_value_get_uint (value);
+      break;
+
+    case PROP_MAX_REQUESTS_PER_SUBJECT:
+      listener->max_requests_per_subject = g_value_get_uint (value);
+      break;
+
+    case PROP_DISMISSAL_WINDOW:
+      listener->dismissal_window = g_value_get_uint (value);
+      if (listener->dismissal_window == 0)
+        g_hash_table_remove_all (listener->dismissals);
+      break;
+
+    case PROP_HELPER_WARM_INTERVAL:
+      listener->helper_warm_interval = g_value_get_uint (value);
+      polkit_mate_helper_warmer_set_interval (listener->helper_warmer, listener->helper_warm_interval);
+      break;
+
+    case PROP_HELPER_IDLE_TIMEOUT:
+      listener->helper_idle_timeout = g_value_get_uint (value);
+      polkit_mate_helper_warmer_set_idle_timeout (listener->helper_warmer, listener->helper_idle_timeout);
+      break;
+
+    case PROP_MAX_ATTEMPTS:
+      listener->max_attempts = g_value_get_uint (value);
+      update_retry_policy (listener);
+      break;
+
+    case PROP_RETRY_BACKOFF:
+      listener->retry_backoff = g_value_get_uint (value);
+      update_retry_policy (listener);
+      break;
+
+    case PROP_PARALLEL_FACTORS:
+      listener->parallel_factors = g_value_get_boolean (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+polkit_mate_listener_get_property (GObject    *object,
+                                   guint       prop_id,
+                                   GValue     *value,
+                                   GParamSpec *pspec)
+{
+  PolkitMateListener *listener = POLKIT_MATE_LISTENER (object);
+
+  switch (prop_id)
+    {
+    case PROP_MAX_DIALOGS:
+      g_value_set_uint (value, listener->max_dialogs);
+      break;
+
+    case PROP_MAX_REQUESTS:
+      g_value_set_uint (value, listener->max_requests);
+      break;
+
+    case PROP_MAX_REQUESTS_PER_SUBJECT:
+      g_value_set_uint (value, listener->max_requests_per_subject);
+      break;
+
+    case PROP_DISMISSAL_WINDOW:
+      g_value_set_uint (value, listener->dismissal_window);
+      break;
+
+    case PROP_NUM_SUPPRESSED:
+      g_value_set_uint (value, listener->num_suppressed);
+      break;
+
+    case PROP_HELPER_WARM_INTERVAL:
+      g_value_set_uint (value, listener->helper_warm_interval);
+      break;
+
+    case PROP_HELPER_IDLE_TIMEOUT:
+      g_value_set_uint (value, listener->helper_idle_timeout);
+      break;
+
+    case PROP_MAX_ATTEMPTS:
+      g_value_set_uint (value, listener->max_attempts);
+      break;
+
+    case PROP_RETRY_BACKOFF:
+      g_value_set_uint (value, listener->retry_backoff);
+      break;
+
+    case PROP_PARALLEL_FACTORS:
+      g_value_set_boolean (value, listener->parallel_factors);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
 static void
 polkit_mate_listener_class_init (PolkitMateListenerClass *klass)
 {
@@ -82,63 +341,567 @@ polkit_mate_listener_class_init (PolkitMateListenerClass *klass)
   listener_class = POLKIT_AGENT_LISTENER_CLASS (klass);
 
   gobject_class->finalize = polkit_mate_listener_finalize;
+  gobject_class->get_property = polkit_mate_listener_get_property;
+  gobject_class->set_property = polkit_mate_listener_set_property;
 
   listener_class->initiate_authentication          = polkit_mate_listener_initiate_authentication;
   listener_class->initiate_authentication_finish   = polkit_mate_listener_initiate_authentication_finish;
+
+  /**
+   * PolkitMateListener:max-dialogs:
+   *
+   * The maximum number of authentication dialogs shown at the same time.
+   * Requests from the same subject are always handled one after another.
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_MAX_DIALOGS,
+                                   g_param_spec_uint ("max-dialogs",
+                                                      NULL,
+                                                      NULL,
+                                                      1,
+                                                      G_MAXUINT,
+                                                      DEFAULT_MAX_DIALOGS,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_NAME |
+                                                      G_PARAM_STATIC_NICK |
+                                                      G_PARAM_STATIC_BLURB));
+
+  /**
+   * PolkitMateListener:max-requests:
+   *
+   * The maximum number of outstanding requests, shown or queued. Further
+   * requests are refused right away.
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_MAX_REQUESTS,
+                                   g_param_spec_uint ("max-requests",
+                                                      NULL,
+                                                      NULL,
+                                                      1,
+                                                      G_MAXUINT,
+                                                      DEFAULT_MAX_REQUESTS,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_NAME |
+                                                      G_PARAM_STATIC_NICK |
+                                                      G_PARAM_STATIC_BLURB));
+
+  /**
+   * PolkitMateListener:max-requests-per-subject:
+   *
+   * The maximum number of outstanding requests made for a single subject,
+   * so that one runaway process cannot crowd out everyone else.
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_MAX_REQUESTS_PER_SUBJECT,
+                                   g_param_spec_uint ("max-requests-per-subject",
+                                                      NULL,
+                                                      NULL,
+                                                      1,
+                                                      G_MAXUINT,
+                                                      DEFAULT_MAX_REQUESTS_PER_SUBJECT,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_NAME |
+                                                      G_PARAM_STATIC_NICK |
+                                                      G_PARAM_STATIC_BLURB));
+
+  /**
+   * PolkitMateListener:dismissal-window:
+   *
+   * For how many seconds after the user dismissed a dialog identical
+   * requests (same subject and action) are cancelled without showing
+   * anything. 0 disables this.
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_DISMISSAL_WINDOW,
+                                   g_param_spec_uint ("dismissal-window",
+                                                      NULL,
+                                                      NULL,
+                                                      0,
+                                                      G_MAXUINT,
+                                                      DEFAULT_DISMISSAL_WINDOW,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_NAME |
+                                                      G_PARAM_STATIC_NICK |
+                                                      G_PARAM_STATIC_BLURB));
+
+  /**
+   * PolkitMateListener:num-suppressed:
+   *
+   * The number of requests cancelled because of a recent dismissal.
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_NUM_SUPPRESSED,
+                                   g_param_spec_uint ("num-suppressed",
+                                                      NULL,
+                                                      NULL,
+                                                      0,
+                                                      G_MAXUINT,
+                                                      0,
+                                                      G_PARAM_READABLE |
+                                                      G_PARAM_STATIC_NAME |
+                                                      G_PARAM_STATIC_NICK |
+                                                      G_PARAM_STATIC_BLURB));
+
+  /**
+   * PolkitMateListener:helper-warm-interval:
+   *
+   * How often, in seconds, the authentication helper and the PAM modules
+   * are read ahead into the page cache. 0 disables this.
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_HELPER_WARM_INTERVAL,
+                                   g_param_spec_uint ("helper-warm-interval",
+                                                      NULL,
+                                                      NULL,
+                                                      0,
+                                                      G_MAXUINT,
+                                                      DEFAULT_HELPER_WARM_INTERVAL,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_NAME |
+                                                      G_PARAM_STATIC_NICK |
+                                                      G_PARAM_STATIC_BLURB));
+
+  /**
+   * PolkitMateListener:helper-idle-timeout:
+   *
+   * For how many seconds after the last request the helper is kept warm
+   * every #PolkitMateListener:helper-warm-interval. After that it is only
+   * refreshed once per this many seconds, until the next request.
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_HELPER_IDLE_TIMEOUT,
+                                   g_param_spec_uint ("helper-idle-timeout",
+                                                      NULL,
+                                                      NULL,
+                                                      0,
+                                                      G_MAXUINT,
+                                                      DEFAULT_HELPER_IDLE_TIMEOUT,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_NAME |
+                                                      G_PARAM_STATIC_NICK |
+                                                      G_PARAM_STATIC_BLURB));
+
+  /**
+   * PolkitMateListener:max-attempts:
+   *
+   * How many passwords the user may try before a request fails.
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_MAX_ATTEMPTS,
+                                   g_param_spec_uint ("max-attempts",
+                                                      NULL,
+                                                      NULL,
+                                                      1,
+                                                      G_MAXUINT,
+                                                      DEFAULT_MAX_ATTEMPTS,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_NAME |
+                                                      G_PARAM_STATIC_NICK |
+                                                      G_PARAM_STATIC_BLURB));
+
+  /**
+   * PolkitMateListener:retry-backoff:
+   *
+   * Milliseconds to wait before prompting again after the first failed
+   * attempt, doubling with every further failure. This is on top of
+   * whatever delay PAM imposes itself.
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_RETRY_BACKOFF,
+                                   g_param_spec_uint ("retry-backoff",
+                                                      NULL,
+                                                      NULL,
+                                                      0,
+                                                      POLKIT_MATE_LISTENER_MAX_RETRY_BACKOFF,
+                                                      DEFAULT_RETRY_BACKOFF,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_NAME |
+                                                      G_PARAM_STATIC_NICK |
+                                                      G_PARAM_STATIC_BLURB));
+
+  /**
+   * PolkitMateListener:parallel-factors:
+   *
+   * Whether to start a password conversation next to one that waits on a
+   * fingerprint reader or smart card, so that either can be used. Which
+   * messages mean the conversation waits on a device is guessed from
+   * their text, so this is off by default.
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_PARALLEL_FACTORS,
+                                   g_param_spec_boolean ("parallel-factors",
+                                                         NULL,
+                                                         NULL,
+                                                         FALSE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_NAME |
+                                                         G_PARAM_STATIC_NICK |
+                                                         G_PARAM_STATIC_BLURB));
+}
+
+static void
+update_retry_policy (PolkitMateListener *listener)
+{
+  /* authenticators keep the policy they were created with */
+  if (listener->retry_policy != NULL)
+    polkit_mate_retry_policy_unref (listener->retry_policy);
+  listener->retry_policy = polkit_mate_retry_policy_new (listener->max_attempts,
+                                                         listener->retry_backoff,
+                                                         POLKIT_MATE_LISTENER_MAX_RETRY_BACKOFF);
 }
 
 PolkitAgentListener *
-polkit_mate_listener_new (void)
+polkit_mate_listener_new (PolkitAuthority *authority)
 {
-  return POLKIT_AGENT_LISTENER (g_object_new (POLKIT_MATE_TYPE_LISTENER, NULL));
+  PolkitMateListener *listener;
+
+  listener = POLKIT_MATE_LISTENER (g_object_new (POLKIT_MATE_TYPE_LISTENER, NULL));
+
+  listener->authority = g_object_ref (authority);
+
+  /* start filling the index now so the first request finds it ready */
+  listener->action_cache = polkit_mate_action_cache_new (listener->authority);
+
+  polkit_mate_helper_warmer_touch (listener->helper_warmer);
+
+  /* likewise for the identities to preselect, read in the background */
+  polkit_mate_user_history_get_default ();
+
+  return POLKIT_AGENT_LISTENER (listener);
 }
 
+typedef struct _AuthData AuthData;
+
+/* one call to initiate_authentication() */
 typedef struct
 {
-  PolkitMateListener *listener;
-  PolkitMateAuthenticator *authenticator;
+  AuthData *data;
+  gchar *cookie;
 
   GTask        *task;
   GCancellable *cancellable;
 
   gulong cancel_id;
-} AuthData;
+} Request;
+
+/* equivalent requests answered by a single authenticator */
+struct _AuthData
+{
+  PolkitMateListener *listener;
+  PolkitMateAuthenticator *authenticator;
+
+  /* identifies the process the request is made for */
+  gchar *subject;
+
+  gchar *action_id;
+
+  /* what the authenticator is built from, kept for requests it refuses */
+  gchar *message;
+  gchar *icon_name;
+  PolkitDetails *details;
+  GList *identities;
+
+  /* action id, subject and identities; equal keys are coalesced */
+  gchar *key;
+
+  /* cascade step of the dialog while active */
+  guint stack_position;
+
+  /* when the request should be shown, and its place in the queue */
+  gint64 deadline;
+  PolkitMateSchedulerEntry *entry;
+
+  /* Request, in order of arrival */
+  GList *requests;
+};
+
+static gchar *
+get_subject_key (PolkitDetails *details,
+                 const gchar   *cookie)
+{
+  const gchar *pid;
+
+  /* polkitd passes the pid of the subject, and of the caller if different */
+  pid = NULL;
+  if (details != NULL)
+    {
+      pid = polkit_details_lookup (details, "polkit.subject-pid");
+      if (pid == NULL)
+        pid = polkit_details_lookup (details, "polkit.caller-pid");
+    }
+
+  if (pid != NULL)
+    return g_strdup_printf ("pid:%s", pid);
+
+  /* nothing to group by; the request is a subject of its own */
+  return g_strdup_printf ("cookie:%s", cookie);
+}
+
+static gint64
+get_deadline (const gchar   *action_id,
+              PolkitDetails *details)
+{
+  RequestPriority priority;
+  guint n;
+
+  priority = PRIORITY_NORMAL;
+  for (n = 0; n < G_N_ELEMENTS (priority_rules); n++)
+    {
+      if (!g_pattern_match_simple (priority_rules[n].action_pattern, action_id))
+        continue;
+
+      if (priority_rules[n].detail != NULL)
+        {
+          const gchar *value;
+
+          value = details != NULL ? polkit_details_lookup (details, priority_rules[n].detail) : NULL;
+          if (value == NULL || !g_pattern_match_simple (priority_rules[n].value_pattern, value))
+            continue;
+        }
+
+      priority = priority_rules[n].priority;
+      break;
+    }
+
+  return g_get_monotonic_time () + priority_latency[priority];
+}
+
+static gchar *
+get_coalescing_key (const gchar *action_id,
+                    const gchar *subject,
+                    GList       *identities)
+{
+  GPtrArray *strs;
+  GString *key;
+  GList *l;
+  guint n;
+
+  strs = g_ptr_array_new_with_free_func (g_free);
+  for (l = identities; l != NULL; l = l->next)
+    g_ptr_array_add (strs, polkit_identity_to_string (POLKIT_IDENTITY (l->data)));
+  g_ptr_array_sort (strs, (GCompareFunc) g_strcmp0);
+
+  key = g_string_new (action_id);
+  g_string_append_c (key, '\n');
+  g_string_append (key, subject);
+  for (n = 0; n < strs->len; n++)
+    {
+      g_string_append_c (key, '\n');
+      g_string_append (key, g_ptr_array_index (strs, n));
+    }
+  g_ptr_array_unref (strs);
+
+  return g_string_free (key, FALSE);
+}
 
 static AuthData *
 auth_data_new (PolkitMateListener *listener,
-               PolkitMateAuthenticator *authenticator,
-               GTask *task,
-               GCancellable *cancellable)
+               const gchar *subject,
+               const gchar *action_id,
+               const gchar *message,
+               const gchar *icon_name,
+               PolkitDetails *details,
+               GList *identities,
+               const gchar *key,
+               gint64 deadline)
 {
   AuthData *data;
 
   data = g_new0 (AuthData, 1);
   data->listener = g_object_ref (listener);
-  data->authenticator = g_object_ref (authenticator);
-  data->task = g_object_ref (task);
-  data->cancellable = g_object_ref (cancellable);
+  data->subject = g_strdup (subject);
+  data->action_id = g_strdup (action_id);
+  data->message = g_strdup (message);
+  data->icon_name = g_strdup (icon_name);
+  if (details != NULL)
+    data->details = g_object_ref (details);
+  data->identities = g_list_copy_deep (identities, (GCopyFunc) g_object_ref, NULL);
+  data->key = g_strdup (key);
+  data->deadline = deadline;
   return data;
 }
 
+typedef struct
+{
+  gint64 expires;
+  guint num_suppressed;
+} Dismissal;
+
+static gboolean
+dismissal_expired (gpointer key,
+                   gpointer value,
+                   gpointer user_data)
+{
+  Dismissal *dismissal = value;
+
+  return dismissal->expires <= *(gint64 *) user_data;
+}
+
+static void
+remember_dismissal (PolkitMateListener *listener,
+                    const gchar        *subject,
+                    const gchar        *action_id)
+{
+  Dismissal *dismissal;
+  gint64 now;
+
+  if (listener->dismissal_window == 0)
+    return;
+
+  /* keeps the table as small as the window is short */
+  now = g_get_monotonic_time ();
+  g_hash_table_foreach_remove (listener->dismissals, dismissal_expired, &now);
+
+  dismissal = g_new0 (Dismissal, 1);
+  dismissal->expires = now + listener->dismissal_window * G_TIME_SPAN_SECOND;
+  g_hash_table_replace (listener->dismissals,
+                        g_strconcat (subject, "\n", action_id, NULL),
+                        dismissal);
+}
+
+static gboolean
+recently_dismissed (PolkitMateListener *listener,
+                    const gchar        *subject,
+                    const gchar        *action_id)
+{
+  Dismissal *dismissal;
+  gchar *key;
+  gboolean ret;
+
+  ret = FALSE;
+
+  key = g_strconcat (subject, "\n", action_id, NULL);
+  dismissal = g_hash_table_lookup (listener->dismissals, key);
+  if (dismissal == NULL)
+    goto out;
+
+  if (dismissal->expires <= g_get_monotonic_time ())
+    {
+      g_hash_table_remove (listener->dismissals, key);
+      goto out;
+    }
+
+  dismissal->num_suppressed++;
+  listener->num_suppressed++;
+  g_debug ("Suppressed request for %s from %s, dismissed %u times in a row (%u in total)",
+           action_id, subject, dismissal->num_suppressed, listener->num_suppressed);
+  ret = TRUE;
+
+ out:
+  g_free (key);
+  return ret;
+}
+
+static gboolean
+admit_request (PolkitMateListener *listener,
+               const gchar        *subject)
+{
+  guint count;
+
+  if (listener->num_requests >= listener->max_requests)
+    return FALSE;
+
+  count = GPOINTER_TO_UINT (g_hash_table_lookup (listener->requests_per_subject, subject));
+  if (count >= listener->max_requests_per_subject)
+    return FALSE;
+
+  g_hash_table_replace (listener->requests_per_subject, g_strdup (subject), GUINT_TO_POINTER (count + 1));
+  listener->num_requests++;
+
+  return TRUE;
+}
+
+static void
+release_request (PolkitMateListener *listener,
+                 const gchar        *subject)
+{
+  guint count;
+
+  count = GPOINTER_TO_UINT (g_hash_table_lookup (listener->requests_per_subject, subject));
+  if (count <= 1)
+    g_hash_table_remove (listener->requests_per_subject, subject);
+  else
+    g_hash_table_replace (listener->requests_per_subject, g_strdup (subject), GUINT_TO_POINTER (count - 1));
+  listener->num_requests--;
+}
+
+static void
+request_free (Request *request)
+{
+  release_request (request->data->listener, request->data->subject);
+
+  g_free (request->cookie);
+  g_object_unref (request->task);
+  if (request->cancellable != NULL && request->cancel_id > 0)
+    g_signal_handler_disconnect (request->cancellable, request->cancel_id);
+  if (request->cancellable != NULL)
+    g_object_unref (request->cancellable);
+  g_free (request);
+}
+
 static void
 auth_data_free (AuthData *data)
 {
+  /* stop coalescing into this group */
+  if (g_hash_table_lookup (data->listener->groups, data->key) == data)
+    g_hash_table_remove (data->listener->groups, data->key);
+
+  g_list_free_full (data->requests, (GDestroyNotify) request_free);
   g_object_unref (data->listener);
-  g_object_unref (data->authenticator);
-  g_object_unref (data->task);
-  if (data->cancellable != NULL && data->cancel_id > 0)
-    g_signal_handler_disconnect (data->cancellable, data->cancel_id);
-  g_object_unref (data->cancellable);
+  if (data->authenticator != NULL)
+    g_object_unref (data->authenticator);
+  g_free (data->subject);
+  g_free (data->action_id);
+  g_free (data->message);
+  g_free (data->icon_name);
+  if (data->details != NULL)
+    g_object_unref (data->details);
+  g_list_free_full (data->identities, g_object_unref);
+  g_free (data->key);
   g_free (data);
 }
 
+static guint
+find_free_stack_position (PolkitMateListener *listener)
+{
+  guint position;
+  GList *l;
+
+  /* the lowest step not taken by a visible dialog */
+  for (position = 0; ; position++)
+    {
+      for (l = listener->active; l != NULL; l = l->next)
+        {
+          AuthData *data = l->data;
+
+          if (data->stack_position == position)
+            break;
+        }
+      if (l == NULL)
+        return position;
+    }
+}
+
 static void
 maybe_initiate_next_authenticator (PolkitMateListener *listener)
 {
-  if (listener->active_authenticator == NULL && listener->authenticators != NULL)
+  while (g_list_length (listener->active) < listener->max_dialogs)
     {
-      polkit_mate_authenticator_initiate (POLKIT_MATE_AUTHENTICATOR (listener->authenticators->data));
-      listener->active_authenticator = listener->authenticators->data;
+      AuthData *data;
+
+      data = polkit_mate_scheduler_pop (listener->pending);
+      if (data == NULL)
+        break;
+      data->entry = NULL;
+
+      /* one dialog per subject; the rest wait their turn */
+      polkit_mate_scheduler_set_group_blocked (listener->pending, data->subject, TRUE);
+
+      data->stack_position = find_free_stack_position (listener);
+      listener->active = g_list_append (listener->active, data);
+
+      polkit_mate_authenticator_set_stack_position (data->authenticator, data->stack_position);
+      polkit_mate_authenticator_initiate (data->authenticator);
     }
 }
 
@@ -149,25 +912,43 @@ authenticator_completed (PolkitMateAuthenticator *authenticator,
                          gpointer                 user_data)
 {
   AuthData *data = user_data;
+  PolkitMateListener *listener = data->listener;
+  GList *l;
 
-  data->listener->authenticators = g_list_remove (data->listener->authenticators, authenticator);
-  if (authenticator == data->listener->active_authenticator)
-    data->listener->active_authenticator = NULL;
+  if (data->entry != NULL)
+    {
+      polkit_mate_scheduler_remove (listener->pending, data->entry);
+      data->entry = NULL;
+    }
+  else if (g_list_find (listener->active, data) != NULL)
+    {
+      listener->active = g_list_remove (listener->active, data);
+      polkit_mate_scheduler_set_group_blocked (listener->pending, data->subject, FALSE);
+    }
 
-  g_object_unref (authenticator);
+  /* if every request was cancelled by polkitd it was not the user's doing */
+  if (dismissed && data->requests != NULL)
+    remember_dismissal (listener, data->subject, data->action_id);
 
-  if (dismissed)
+  /* polkitd checks each cookie itself, so all requests share the outcome */
+  for (l = data->requests; l != NULL; l = l->next)
     {
-      g_task_return_new_error (data->task,
-                               POLKIT_ERROR,
-                               POLKIT_ERROR_CANCELLED,
-                               _("Authentication dialog was dismissed by the user"));
-    }
+      Request *request = l->data;
 
-  g_task_return_boolean (data->task, TRUE);
-  g_object_unref (data->task);
+      if (dismissed)
+        {
+          g_task_return_new_error (request->task,
+                                   POLKIT_ERROR,
+                                   POLKIT_ERROR_CANCELLED,
+                                   _("Authentication dialog was dismissed by the user"));
+        }
+      else
+        {
+          g_task_return_boolean (request->task, TRUE);
+        }
+    }
 
-  maybe_initiate_next_authenticator (data->listener);
+  maybe_initiate_next_authenticator (listener);
 
   auth_data_free (data);
 }
@@ -175,10 +956,180 @@ authenticator_completed (PolkitMateAuthenticator *authenticator,
 static void
 cancelled_cb (GCancellable *cancellable,
               gpointer user_data)
+{
+  Request *request = user_data;
+  AuthData *data = request->data;
+
+  data->requests = g_list_remove (data->requests, request);
+
+  if (data->authenticator != NULL)
+    {
+      if (data->requests == NULL)
+        polkit_mate_authenticator_cancel (data->authenticator);
+      else
+        polkit_mate_authenticator_remove_cookie (data->authenticator, request->cookie);
+    }
+
+  g_task_return_new_error (request->task,
+                           POLKIT_ERROR,
+                           POLKIT_ERROR_CANCELLED,
+                           _("Authentication request was cancelled"));
+  request_free (request);
+}
+
+static void authenticator_created_cb (GObject      *source_object,
+                                      GAsyncResult *res,
+                                      gpointer      user_data);
+static void return_shutdown_error (AuthData *data);
+
+static void
+create_authenticator (AuthData    *data,
+                      const gchar *cookie)
+{
+  PolkitMateListener *listener = data->listener;
+
+  /* return to the D-Bus dispatcher right away; the request is queued
+   * once the authenticator has been set up. Cancellation is handled per
+   * request in cancelled_cb(), as later requests may join this one. */
+  polkit_mate_authenticator_new_async (listener->authority,
+                                       listener->action_cache,
+                                       data->action_id,
+                                       data->message,
+                                       data->icon_name,
+                                       data->details,
+                                       cookie,
+                                       data->identities,
+                                       NULL, /* GCancellable */
+                                       authenticator_created_cb,
+                                       data);
+}
+
+/* @request could not be coalesced after all, see
+ * polkit_mate_authenticator_add_cookie(); it gets a dialog of its own */
+static void
+split_request (Request *request)
+{
+  AuthData *data = request->data;
+  AuthData *own;
+
+  own = auth_data_new (data->listener,
+                       data->subject,
+                       data->action_id,
+                       data->message,
+                       data->icon_name,
+                       data->details,
+                       data->identities,
+                       data->key,
+                       data->deadline);
+
+  data->requests = g_list_remove (data->requests, request);
+  request->data = own;
+  own->requests = g_list_append (own->requests, request);
+
+  g_debug ("Request %s for %s can't share a dialog, showing one of its own",
+           request->cookie, data->action_id);
+  create_authenticator (own, request->cookie);
+}
+
+static void
+authenticator_created_cb (GObject      *source_object,
+                          GAsyncResult *res,
+                          gpointer      user_data)
 {
   AuthData *data = user_data;
+  PolkitMateListener *listener = data->listener;
+  const gchar *cookie;
+  gboolean has_cookie;
+  GList *refused;
+  GError *error;
+  GList *l;
 
-  polkit_mate_authenticator_cancel (data->authenticator);
+  error = NULL;
+  data->authenticator = polkit_mate_authenticator_new_finish (res, &error);
+  if (data->authenticator == NULL)
+    {
+      for (l = data->requests; l != NULL; l = l->next)
+        {
+          Request *request = l->data;
+
+          g_task_return_new_error (request->task,
+                                   POLKIT_ERROR,
+                                   POLKIT_ERROR_FAILED,
+                                   "Error creating authentication object: %s",
+                                   error->message);
+        }
+      g_error_free (error);
+      auth_data_free (data);
+      return;
+    }
+
+  /* every request was cancelled, or answered by polkit_mate_listener_shutdown(),
+   * while the authenticator was being set up */
+  if (data->requests == NULL)
+    {
+      auth_data_free (data);
+      return;
+    }
+
+  /* requests split off in split_request() are not in @groups, where
+   * polkit_mate_listener_shutdown() looks for them */
+  if (listener->shutting_down)
+    {
+      return_shutdown_error (data);
+      auth_data_free (data);
+      return;
+    }
+
+  polkit_mate_authenticator_set_retry_policy (data->authenticator, listener->retry_policy);
+  polkit_mate_authenticator_set_parallel_factors (data->authenticator, listener->parallel_factors);
+  polkit_mate_authenticator_set_prompt_sequences (data->authenticator, listener->prompt_sequences);
+
+  /* hand over the requests coalesced in the meantime */
+  cookie = polkit_mate_authenticator_get_cookie (data->authenticator);
+  has_cookie = FALSE;
+  refused = NULL;
+  for (l = data->requests; l != NULL; l = l->next)
+    {
+      Request *request = l->data;
+
+      if (g_strcmp0 (request->cookie, cookie) == 0)
+        has_cookie = TRUE;
+      else if (!polkit_mate_authenticator_add_cookie (data->authenticator, request->cookie))
+        refused = g_list_append (refused, request);
+    }
+
+  /* before remove_cookie() below, which cancels the authenticator if
+   * there is no other cookie to take over */
+  for (l = refused; l != NULL; l = l->next)
+    split_request (l->data);
+  g_list_free (refused);
+
+  if (data->requests == NULL)
+    {
+      auth_data_free (data);
+      return;
+    }
+
+  if (!has_cookie)
+    polkit_mate_authenticator_remove_cookie (data->authenticator, cookie);
+
+  /* a request the authenticator does not answer would be reported as
+   * authorized without polkitd ever hearing of its cookie */
+  for (l = data->requests; l != NULL; l = l->next)
+    {
+      Request *request = l->data;
+
+      g_warn_if_fail (polkit_mate_authenticator_has_cookie (data->authenticator, request->cookie));
+    }
+
+  g_signal_connect (data->authenticator,
+                    "completed",
+                    G_CALLBACK (authenticator_completed),
+                    data);
+
+  data->entry = polkit_mate_scheduler_insert (listener->pending, data, data->subject, data->deadline);
+
+  maybe_initiate_next_authenticator (listener);
 }
 
 static void
@@ -194,54 +1145,113 @@ polkit_mate_listener_initiate_authentication (PolkitAgentListener  *agent_listen
                                                gpointer              user_data)
 {
   PolkitMateListener *listener = POLKIT_MATE_LISTENER (agent_listener);
-  GTask *task;
-  PolkitMateAuthenticator *authenticator;
+  Request *request;
   AuthData *data;
+  gchar *subject;
+  gchar *key;
+  gboolean coalesced;
 
-  task = g_task_new (G_OBJECT (listener),
-                     NULL,
-                     callback,
-                     user_data);
-  g_task_set_source_tag (task,
-                         polkit_mate_listener_initiate_authentication);
+  if (listener->shutting_down)
+    {
+      g_task_report_new_error (listener,
+                               callback,
+                               user_data,
+                               polkit_mate_listener_initiate_authentication,
+                               POLKIT_ERROR,
+                               POLKIT_ERROR_CANCELLED,
+                               "The authentication agent is shutting down");
+      return;
+    }
 
-  authenticator = polkit_mate_authenticator_new (action_id,
-                                                  message,
-                                                  icon_name,
-                                                  details,
-                                                  cookie,
-                                                  identities);
-  if (authenticator == NULL)
+  subject = get_subject_key (details, cookie);
+
+  /* an app retrying right after the user said no gets the same answer */
+  if (recently_dismissed (listener, subject, action_id))
     {
-      g_task_return_new_error (task,
+      g_task_report_new_error (listener,
+                               callback,
+                               user_data,
+                               polkit_mate_listener_initiate_authentication,
+                               POLKIT_ERROR,
+                               POLKIT_ERROR_CANCELLED,
+                               _("Authentication dialog was dismissed by the user"));
+      g_object_notify (G_OBJECT (listener), "num-suppressed");
+      g_free (subject);
+      return;
+    }
+
+  /* refuse floods before spending anything on them */
+  if (!admit_request (listener, subject))
+    {
+      g_debug ("Refusing request %s for %s from %s: too many outstanding requests",
+               cookie, action_id, subject);
+      g_task_report_new_error (listener,
+                               callback,
+                               user_data,
+                               polkit_mate_listener_initiate_authentication,
                                POLKIT_ERROR,
                                POLKIT_ERROR_FAILED,
-                               "Error creating authentication object");
-      g_object_unref (task);
-      goto out;
+                               "Too many outstanding authentication requests");
+      g_free (subject);
+      return;
     }
 
-  data = auth_data_new (listener, authenticator, task, cancellable);
+  polkit_mate_helper_warmer_touch (listener->helper_warmer);
 
-  g_signal_connect (authenticator,
-                    "completed",
-                    G_CALLBACK (authenticator_completed),
-                    data);
+  request = g_new0 (Request, 1);
+  request->cookie = g_strdup (cookie);
+  request->task = g_task_new (G_OBJECT (listener),
+                              NULL,
+                              callback,
+                              user_data);
+  g_task_set_source_tag (request->task,
+                         polkit_mate_listener_initiate_authentication);
 
-  if (cancellable != NULL)
+  key = get_coalescing_key (action_id, subject, identities);
+
+  /* a burst of identical requests is answered from a single dialog */
+  data = g_hash_table_lookup (listener->groups, key);
+  coalesced = data != NULL &&
+              (data->authenticator == NULL ||
+               polkit_mate_authenticator_add_cookie (data->authenticator, cookie));
+  if (!coalesced)
     {
-      data->cancel_id = g_signal_connect (cancellable,
-                                          "cancelled",
-                                          G_CALLBACK (cancelled_cb),
-                                          data);
+      data = auth_data_new (listener,
+                            subject,
+                            action_id,
+                            message,
+                            icon_name,
+                            details,
+                            identities,
+                            key,
+                            get_deadline (action_id, details));
+      g_hash_table_replace (listener->groups, g_strdup (key), data);
     }
 
-  listener->authenticators = g_list_append (listener->authenticators, authenticator);
+  request->data = data;
+  data->requests = g_list_append (data->requests, request);
 
-  maybe_initiate_next_authenticator (listener);
+  if (cancellable != NULL)
+    {
+      request->cancellable = g_object_ref (cancellable);
+      request->cancel_id = g_signal_connect (cancellable,
+                                             "cancelled",
+                                             G_CALLBACK (cancelled_cb),
+                                             request);
+    }
 
- out:
-  ;
+  if (coalesced)
+    {
+      g_debug ("Coalesced request %s for %s, %u requests now share one dialog",
+               cookie, action_id, g_list_length (data->requests));
+    }
+  else
+    {
+      create_authenticator (data, cookie);
+    }
+
+  g_free (subject);
+  g_free (key);
 }
 
 static gboolean
@@ -253,10 +1263,98 @@ polkit_mate_listener_initiate_authentication_finish (PolkitAgentListener  *liste
 
   g_warn_if_fail (g_task_get_source_tag (task) == polkit_mate_listener_initiate_authentication);
 
-  if (g_task_propagate_pointer (task, error) == NULL) {
-    return FALSE;
-  }
+  return g_task_propagate_boolean (task, error);
+}
 
-  return TRUE;
+static void
+return_shutdown_error (AuthData *data)
+{
+  GList *l;
+
+  for (l = data->requests; l != NULL; l = l->next)
+    {
+      Request *request = l->data;
+
+      g_task_return_new_error (request->task,
+                               POLKIT_ERROR,
+                               POLKIT_ERROR_CANCELLED,
+                               "The authentication agent is shutting down");
+    }
+  g_list_free_full (data->requests, (GDestroyNotify) request_free);
+  data->requests = NULL;
 }
 
+static void
+abort_auth_data (AuthData *data)
+{
+  return_shutdown_error (data);
+
+  /* kills the helper right away; the deferred "completed" has nobody to
+   * report to any more */
+  g_signal_handlers_disconnect_by_func (data->authenticator,
+                                        G_CALLBACK (authenticator_completed),
+                                        data);
+  polkit_mate_authenticator_cancel (data->authenticator);
+
+  auth_data_free (data);
+}
+
+/**
+ * polkit_mate_listener_shutdown:
+ * @listener: A #PolkitMateListener.
+ *
+ * Answers every outstanding request with %POLKIT_ERROR_CANCELLED, closes
+ * all dialogs and terminates the authentication helpers, without waiting
+ * for the main loop. Requests arriving afterwards are refused. Used when
+ * the session ends, so that neither polkitd nor the session manager is
+ * kept waiting on us.
+ **/
+void
+polkit_mate_listener_shutdown (PolkitMateListener *listener)
+{
+  GHashTableIter iter;
+  AuthData *data;
+  GList *pending;
+  GList *l;
+  guint num_aborted;
+
+  g_return_if_fail (POLKIT_MATE_IS_LISTENER (listener));
+
+  if (listener->shutting_down)
+    return;
+  listener->shutting_down = TRUE;
+
+  num_aborted = 0;
+
+  while (listener->active != NULL)
+    {
+      data = listener->active->data;
+      listener->active = g_list_delete_link (listener->active, listener->active);
+      abort_auth_data (data);
+      num_aborted++;
+    }
+
+  pending = polkit_mate_scheduler_steal_all (listener->pending);
+  for (l = pending; l != NULL; l = l->next)
+    {
+      data = l->data;
+      data->entry = NULL;
+      abort_auth_data (data);
+      num_aborted++;
+    }
+  g_list_free (pending);
+
+  /* groups whose authenticator is still being created are freed once it
+   * arrives, see authenticator_created_cb() */
+  g_hash_table_iter_init (&iter, listener->groups);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &data))
+    {
+      if (data->authenticator == NULL && data->requests != NULL)
+        {
+          return_shutdown_error (data);
+          num_aborted++;
+        }
+    }
+
+  g_debug ("Shut down with %u outstanding authentications", num_aborted);
+}
@@ -36,11 +36,15 @@ extern "C" {
 #define POLKIT_MATE_IS_LISTENER(o)         (G_TYPE_CHECK_INSTANCE_TYPE ((o), POLKIT_MATE_TYPE_LISTENER))
 #define POLKIT_MATE_IS_LISTENER_CLASS(k)   (G_TYPE_CHECK_CLASS_TYPE ((k), POLKIT_MATE_TYPE_LISTENER))
 
+/* upper bound in milliseconds of #PolkitMateListener:retry-backoff */
+#define POLKIT_MATE_LISTENER_MAX_RETRY_BACKOFF 30000
+
 typedef struct _PolkitMateListener PolkitMateListener;
 typedef struct _PolkitMateListenerClass PolkitMateListenerClass;
 
 GType                 polkit_mate_listener_get_type   (void) G_GNUC_CONST;
-PolkitAgentListener  *polkit_mate_listener_new        (void);
+PolkitAgentListener  *polkit_mate_listener_new        (PolkitAuthority *authority);
+void                  polkit_mate_listener_shutdown   (PolkitMateListener *listener);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,376 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "polkitmateprofiler.h"
+
+/* Aggregates where the time of PAM conversations went, per action and
+ * outcome, so that slow PAM stacks (SSSD, faillock, ...) can be told
+ * apart from users taking their time. The totals are merged into a key
+ * file in the user's cache directory that can be collected for fleet
+ * analysis. Times in the file are in milliseconds. */
+
+/* batch the writes of conversations finishing close together */
+#define SAVE_DELAY 30
+
+typedef struct
+{
+  gint64 conversations;
+  gint64 prompts;
+  gint64 messages;
+  gint64 startup_total;
+  gint64 helper_total;
+  gint64 helper_max;
+  gint64 verify_total;
+  gint64 verify_max;
+  gint64 think_total;
+  gint64 think_max;
+
+  /* by prompt index, see PolkitMateConversationTimes */
+  gint64 prompt_count[POLKIT_MATE_PROFILER_MAX_PROMPTS];
+  gint64 prompt_helper_total[POLKIT_MATE_PROFILER_MAX_PROMPTS];
+  gint64 prompt_helper_max[POLKIT_MATE_PROFILER_MAX_PROMPTS];
+  gint64 prompt_think_total[POLKIT_MATE_PROFILER_MAX_PROMPTS];
+  gint64 prompt_think_max[POLKIT_MATE_PROFILER_MAX_PROMPTS];
+} Stats;
+
+struct _PolkitMateProfiler
+{
+  GObject parent_instance;
+
+  gchar *path;
+
+  /* "action_id outcome" -> Stats not written out yet */
+  GHashTable *pending;
+  guint save_id;
+
+  /* saves handed to a worker thread and not done yet, protected by
+   * saves_lock; polkit_mate_profiler_flush() waits for them */
+  guint saves_in_flight;
+  GMutex saves_lock;
+  GCond saves_done;
+};
+
+struct _PolkitMateProfilerClass
+{
+  GObjectClass parent_class;
+};
+
+G_DEFINE_TYPE (PolkitMateProfiler, polkit_mate_profiler, G_TYPE_OBJECT);
+
+/* serializes the read-merge-write of the file between threads */
+G_LOCK_DEFINE_STATIC (save);
+
+static GHashTable *
+new_pending (void)
+{
+  return g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+}
+
+static void
+polkit_mate_profiler_init (PolkitMateProfiler *profiler)
+{
+  profiler->path = g_build_filename (g_get_user_cache_dir (), "polkit-mate", "conversations.ini", NULL);
+  profiler->pending = new_pending ();
+  g_mutex_init (&profiler->saves_lock);
+  g_cond_init (&profiler->saves_done);
+}
+
+static void
+polkit_mate_profiler_finalize (GObject *object)
+{
+  PolkitMateProfiler *profiler;
+
+  profiler = POLKIT_MATE_PROFILER (object);
+
+  if (profiler->save_id > 0)
+    g_source_remove (profiler->save_id);
+  g_hash_table_unref (profiler->pending);
+  g_free (profiler->path);
+  g_mutex_clear (&profiler->saves_lock);
+  g_cond_clear (&profiler->saves_done);
+
+  if (G_OBJECT_CLASS (polkit_mate_profiler_parent_class)->finalize != NULL)
+    G_OBJECT_CLASS (polkit_mate_profiler_parent_class)->finalize (object);
+}
+
+static void
+polkit_mate_profiler_class_init (PolkitMateProfilerClass *klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = polkit_mate_profiler_finalize;
+}
+
+/**
+ * polkit_mate_profiler_get_default:
+ *
+ * Gets the profiler shared by the whole agent.
+ *
+ * Returns: (transfer none): A #PolkitMateProfiler.
+ **/
+PolkitMateProfiler *
+polkit_mate_profiler_get_default (void)
+{
+  static PolkitMateProfiler *profiler = NULL;
+
+  if (profiler == NULL)
+    profiler = POLKIT_MATE_PROFILER (g_object_new (POLKIT_MATE_TYPE_PROFILER, NULL));
+
+  return profiler;
+}
+
+static void
+add_to_key (GKeyFile    *key_file,
+            const gchar *group,
+            const gchar *key,
+            gint64       value)
+{
+  g_key_file_set_int64 (key_file, group, key,
+                        g_key_file_get_int64 (key_file, group, key, NULL) + value);
+}
+
+static void
+max_to_key (GKeyFile    *key_file,
+            const gchar *group,
+            const gchar *key,
+            gint64       value)
+{
+  if (value > g_key_file_get_int64 (key_file, group, key, NULL))
+    g_key_file_set_int64 (key_file, group, key, value);
+}
+
+static void
+save_prompt (GKeyFile    *key_file,
+             const gchar *group,
+             Stats       *stats,
+             guint        n)
+{
+  gchar *key;
+
+  if (stats->prompt_count[n] == 0)
+    return;
+
+  /* numbered from 1 like the prompts the user sees */
+  key = g_strdup_printf ("Prompt%uCount", n + 1);
+  add_to_key (key_file, group, key, stats->prompt_count[n]);
+  g_free (key);
+
+  key = g_strdup_printf ("Prompt%uHelperTotal", n + 1);
+  add_to_key (key_file, group, key, stats->prompt_helper_total[n] / 1000);
+  g_free (key);
+
+  key = g_strdup_printf ("Prompt%uHelperMax", n + 1);
+  max_to_key (key_file, group, key, stats->prompt_helper_max[n] / 1000);
+  g_free (key);
+
+  key = g_strdup_printf ("Prompt%uThinkTotal", n + 1);
+  add_to_key (key_file, group, key, stats->prompt_think_total[n] / 1000);
+  g_free (key);
+
+  key = g_strdup_printf ("Prompt%uThinkMax", n + 1);
+  max_to_key (key_file, group, key, stats->prompt_think_max[n] / 1000);
+  g_free (key);
+}
+
+static void
+save (const gchar *path,
+      GHashTable  *pending)
+{
+  GKeyFile *key_file;
+  GHashTableIter iter;
+  const gchar *group;
+  Stats *stats;
+  gchar *dir;
+  GError *error;
+  guint n;
+
+  G_LOCK (save);
+
+  /* a missing or broken file just starts over */
+  key_file = g_key_file_new ();
+  g_key_file_load_from_file (key_file, path, G_KEY_FILE_KEEP_COMMENTS, NULL);
+
+  g_hash_table_iter_init (&iter, pending);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &group, (gpointer *) &stats))
+    {
+      add_to_key (key_file, group, "Conversations", stats->conversations);
+      add_to_key (key_file, group, "Prompts", stats->prompts);
+      add_to_key (key_file, group, "Messages", stats->messages);
+      add_to_key (key_file, group, "StartupTotal", stats->startup_total / 1000);
+      add_to_key (key_file, group, "HelperTotal", stats->helper_total / 1000);
+      max_to_key (key_file, group, "HelperMax", stats->helper_max / 1000);
+      add_to_key (key_file, group, "VerifyTotal", stats->verify_total / 1000);
+      max_to_key (key_file, group, "VerifyMax", stats->verify_max / 1000);
+      add_to_key (key_file, group, "ThinkTotal", stats->think_total / 1000);
+      max_to_key (key_file, group, "ThinkMax", stats->think_max / 1000);
+      for (n = 0; n < POLKIT_MATE_PROFILER_MAX_PROMPTS; n++)
+        save_prompt (key_file, group, stats, n);
+    }
+
+  dir = g_path_get_dirname (path);
+  g_mkdir_with_parents (dir, 0700);
+  g_free (dir);
+
+  error = NULL;
+  if (!g_key_file_save_to_file (key_file, path, &error))
+    {
+      g_warning ("Error saving conversation profile: %s", error->message);
+      g_error_free (error);
+    }
+  g_key_file_free (key_file);
+
+  G_UNLOCK (save);
+}
+
+static void
+save_thread_func (GTask        *task,
+                  gpointer      source_object,
+                  gpointer      task_data,
+                  GCancellable *cancellable)
+{
+  PolkitMateProfiler *profiler = POLKIT_MATE_PROFILER (source_object);
+
+  save (profiler->path, task_data);
+
+  g_mutex_lock (&profiler->saves_lock);
+  profiler->saves_in_flight--;
+  g_cond_broadcast (&profiler->saves_done);
+  g_mutex_unlock (&profiler->saves_lock);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static gboolean
+on_save_timeout (gpointer user_data)
+{
+  PolkitMateProfiler *profiler = POLKIT_MATE_PROFILER (user_data);
+  GTask *task;
+
+  profiler->save_id = 0;
+
+  g_mutex_lock (&profiler->saves_lock);
+  profiler->saves_in_flight++;
+  g_mutex_unlock (&profiler->saves_lock);
+
+  /* the thread gets what was collected so far, new conversations go
+   * into a fresh table */
+  task = g_task_new (profiler, NULL, NULL, NULL);
+  g_task_set_task_data (task, profiler->pending, (GDestroyNotify) g_hash_table_unref);
+  profiler->pending = new_pending ();
+  g_task_run_in_thread (task, save_thread_func);
+  g_object_unref (task);
+
+  return FALSE;
+}
+
+/**
+ * polkit_mate_profiler_add_conversation:
+ * @profiler: A #PolkitMateProfiler.
+ * @action_id: The action the conversation was for.
+ * @outcome: How it ended, e.g. "success", "failure", "cancelled" or
+ *   "abandoned" for a conversation other than the one the user answered.
+ * @times: Where the time of the conversation went.
+ *
+ * Adds a finished conversation to the totals for @action_id and @outcome.
+ * The totals are written out in the background a little later.
+ **/
+void
+polkit_mate_profiler_add_conversation (PolkitMateProfiler                *profiler,
+                                       const gchar                        *action_id,
+                                       const gchar                        *outcome,
+                                       const PolkitMateConversationTimes *times)
+{
+  Stats *stats;
+  gchar *group;
+  guint n;
+
+  g_debug ("Conversation for %s ended in %s: %u prompts, startup %.1f ms, helper %.1f ms, verify %.1f ms, user %.1f ms",
+           action_id, outcome, times->num_prompts,
+           times->startup / 1000.0, times->helper / 1000.0,
+           times->verify / 1000.0, times->think / 1000.0);
+
+  group = g_strdup_printf ("%s %s", action_id, outcome);
+  stats = g_hash_table_lookup (profiler->pending, group);
+  if (stats == NULL)
+    {
+      stats = g_new0 (Stats, 1);
+      g_hash_table_insert (profiler->pending, group, stats);
+    }
+  else
+    {
+      g_free (group);
+    }
+
+  stats->conversations++;
+  stats->prompts += times->num_prompts;
+  stats->messages += times->num_messages;
+  stats->startup_total += times->startup;
+  stats->helper_total += times->helper;
+  stats->helper_max = MAX (stats->helper_max, times->helper);
+  stats->verify_total += times->verify;
+  stats->verify_max = MAX (stats->verify_max, times->verify);
+  stats->think_total += times->think;
+  stats->think_max = MAX (stats->think_max, times->think);
+
+  for (n = 0; n < MIN (times->num_prompts, POLKIT_MATE_PROFILER_MAX_PROMPTS); n++)
+    {
+      stats->prompt_count[n]++;
+      stats->prompt_helper_total[n] += times->prompt_helper[n];
+      stats->prompt_helper_max[n] = MAX (stats->prompt_helper_max[n], times->prompt_helper[n]);
+      stats->prompt_think_total[n] += times->prompt_think[n];
+      stats->prompt_think_max[n] = MAX (stats->prompt_think_max[n], times->prompt_think[n]);
+    }
+
+  if (profiler->save_id == 0)
+    profiler->save_id = g_timeout_add_seconds (SAVE_DELAY, on_save_timeout, profiler);
+}
+
+/**
+ * polkit_mate_profiler_flush:
+ * @profiler: A #PolkitMateProfiler.
+ *
+ * Writes out the totals not saved yet right away, e.g. when the agent
+ * exits. This blocks until any save running in the background is done.
+ **/
+void
+polkit_mate_profiler_flush (PolkitMateProfiler *profiler)
+{
+  if (profiler->save_id > 0)
+    {
+      g_source_remove (profiler->save_id);
+      profiler->save_id = 0;
+
+      save (profiler->path, profiler->pending);
+      g_hash_table_remove_all (profiler->pending);
+    }
+
+  /* totals are added to the file, so the order of the writes does not
+   * matter, only that they are all done before we exit */
+  g_mutex_lock (&profiler->saves_lock);
+  while (profiler->saves_in_flight > 0)
+    g_cond_wait (&profiler->saves_done, &profiler->saves_lock);
+  g_mutex_unlock (&profiler->saves_lock);
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __POLKIT_MATE_PROFILER_H
+#define __POLKIT_MATE_PROFILER_H
+
+#include <glib-object.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POLKIT_MATE_TYPE_PROFILER          (polkit_mate_profiler_get_type())
+#define POLKIT_MATE_PROFILER(o)            (G_TYPE_CHECK_INSTANCE_CAST ((o), POLKIT_MATE_TYPE_PROFILER, PolkitMateProfiler))
+#define POLKIT_MATE_PROFILER_CLASS(k)      (G_TYPE_CHECK_CLASS_CAST((k), POLKIT_MATE_TYPE_PROFILER, PolkitMateProfilerClass))
+#define POLKIT_MATE_PROFILER_GET_CLASS(o)  (G_TYPE_INSTANCE_GET_CLASS ((o), POLKIT_MATE_TYPE_PROFILER, PolkitMateProfilerClass))
+#define POLKIT_MATE_IS_PROFILER(o)         (G_TYPE_CHECK_INSTANCE_TYPE ((o), POLKIT_MATE_TYPE_PROFILER))
+#define POLKIT_MATE_IS_PROFILER_CLASS(k)   (G_TYPE_CHECK_CLASS_TYPE ((k), POLKIT_MATE_TYPE_PROFILER))
+
+typedef struct _PolkitMateProfiler PolkitMateProfiler;
+typedef struct _PolkitMateProfilerClass PolkitMateProfilerClass;
+typedef struct _PolkitMateConversationTimes PolkitMateConversationTimes;
+
+/* how many prompts of a conversation are timed one by one */
+#define POLKIT_MATE_PROFILER_MAX_PROMPTS 4
+
+/**
+ * PolkitMateConversationTimes:
+ * @num_prompts: How many prompts PAM asked.
+ * @num_messages: How many info and error messages PAM sent.
+ * @startup: Microseconds from starting the session to the first prompt or the end.
+ * @helper: Microseconds spent waiting on the helper and PAM, including @startup and @verify.
+ * @verify: Microseconds from the last response to the end of the conversation.
+ * @think: Microseconds the prompts were waiting for the user.
+ * @prompt_helper: Microseconds waited on the helper and PAM before each prompt.
+ * @prompt_think: Microseconds each prompt was waiting for the user.
+ *
+ * Where the time of one PAM conversation went. Only the first
+ * %POLKIT_MATE_PROFILER_MAX_PROMPTS prompts are timed one by one, later
+ * ones only count towards the totals.
+ **/
+struct _PolkitMateConversationTimes
+{
+  guint num_prompts;
+  guint num_messages;
+  gint64 startup;
+  gint64 helper;
+  gint64 verify;
+  gint64 think;
+  gint64 prompt_helper[POLKIT_MATE_PROFILER_MAX_PROMPTS];
+  gint64 prompt_think[POLKIT_MATE_PROFILER_MAX_PROMPTS];
+};
+
+GType                polkit_mate_profiler_get_type         (void) G_GNUC_CONST;
+PolkitMateProfiler *polkit_mate_profiler_get_default      (void);
+void                 polkit_mate_profiler_add_conversation (PolkitMateProfiler                *profiler,
+                                                            const gchar                        *action_id,
+                                                            const gchar                        *outcome,
+                                                            const PolkitMateConversationTimes *times);
+void                 polkit_mate_profiler_flush            (PolkitMateProfiler                *profiler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __POLKIT_MATE_PROFILER_H */
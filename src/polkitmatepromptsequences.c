@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "polkitmatepromptsequences.h"
+
+/* The prompts of the last successful conversation per user and action,
+ * for stacks that ask more than one question, so that the next dialog
+ * can show all of them at once. Only the @max_entries most recently
+ * used are kept. */
+
+typedef struct
+{
+  GPtrArray *steps;
+  gint64 used;
+} Entry;
+
+struct _PolkitMatePromptSequences
+{
+  gint ref_count;
+
+  /* "user\naction_id" -> Entry */
+  GHashTable *entries;
+  guint max_entries;
+};
+
+/**
+ * polkit_mate_prompt_step_new:
+ * @request: What PAM asked.
+ * @echo_on: Whether the answer may be shown as it is typed.
+ *
+ * Creates a new prompt step.
+ *
+ * Returns: A new #PolkitMatePromptStep, free with polkit_mate_prompt_step_free().
+ **/
+PolkitMatePromptStep *
+polkit_mate_prompt_step_new (const gchar *request,
+                             gboolean     echo_on)
+{
+  PolkitMatePromptStep *step;
+
+  step = g_new0 (PolkitMatePromptStep, 1);
+  step->request = g_strdup (request);
+  step->echo_on = echo_on;
+
+  return step;
+}
+
+void
+polkit_mate_prompt_step_free (PolkitMatePromptStep *step)
+{
+  g_free (step->request);
+  g_free (step);
+}
+
+static void
+entry_free (Entry *entry)
+{
+  g_ptr_array_unref (entry->steps);
+  g_free (entry);
+}
+
+static gchar *
+get_key (const gchar *user,
+         const gchar *action_id)
+{
+  return g_strdup_printf ("%s\n%s", user, action_id);
+}
+
+/**
+ * polkit_mate_prompt_sequences_new:
+ * @max_entries: How many sequences to keep at most.
+ *
+ * Creates a new, empty set of prompt sequences.
+ *
+ * Returns: A new #PolkitMatePromptSequences, free with polkit_mate_prompt_sequences_unref().
+ **/
+PolkitMatePromptSequences *
+polkit_mate_prompt_sequences_new (guint max_entries)
+{
+  PolkitMatePromptSequences *sequences;
+
+  sequences = g_new0 (PolkitMatePromptSequences, 1);
+  sequences->ref_count = 1;
+  sequences->entries = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) entry_free);
+  sequences->max_entries = MAX (max_entries, 1);
+
+  return sequences;
+}
+
+PolkitMatePromptSequences *
+polkit_mate_prompt_sequences_ref (PolkitMatePromptSequences *sequences)
+{
+  g_atomic_int_inc (&sequences->ref_count);
+  return sequences;
+}
+
+void
+polkit_mate_prompt_sequences_unref (PolkitMatePromptSequences *sequences)
+{
+  if (g_atomic_int_dec_and_test (&sequences->ref_count))
+    {
+      g_hash_table_unref (sequences->entries);
+      g_free (sequences);
+    }
+}
+
+/**
+ * polkit_mate_prompt_sequences_lookup:
+ * @sequences: A #PolkitMatePromptSequences.
+ * @user: The user name.
+ * @action_id: The action.
+ *
+ * Looks up the prompts @user went through when last authenticating for @action_id.
+ *
+ * Returns: (transfer none) (element-type PolkitMatePromptStep): The prompts,
+ *          at least two of them, or %NULL if none are known. Only valid
+ *          until @sequences is next changed.
+ **/
+GPtrArray *
+polkit_mate_prompt_sequences_lookup (PolkitMatePromptSequences *sequences,
+                                     const gchar                *user,
+                                     const gchar                *action_id)
+{
+  Entry *entry;
+  gchar *key;
+
+  key = get_key (user, action_id);
+  entry = g_hash_table_lookup (sequences->entries, key);
+  g_free (key);
+
+  if (entry == NULL)
+    return NULL;
+
+  entry->used = g_get_monotonic_time ();
+
+  return entry->steps;
+}
+
+/* makes room for one more entry; a linear scan is fine for the few
+ * dozen entries kept */
+static void
+evict_least_recently_used (PolkitMatePromptSequences *sequences)
+{
+  GHashTableIter iter;
+  const gchar *key;
+  const gchar *oldest_key;
+  Entry *entry;
+  gint64 oldest;
+
+  oldest_key = NULL;
+  oldest = G_MAXINT64;
+  g_hash_table_iter_init (&iter, sequences->entries);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &key, (gpointer *) &entry))
+    {
+      if (entry->used < oldest)
+        {
+          oldest = entry->used;
+          oldest_key = key;
+        }
+    }
+
+  if (oldest_key != NULL)
+    g_hash_table_remove (sequences->entries, oldest_key);
+}
+
+/**
+ * polkit_mate_prompt_sequences_remember:
+ * @sequences: A #PolkitMatePromptSequences.
+ * @user: The user name.
+ * @action_id: The action.
+ * @steps: (transfer full) (element-type PolkitMatePromptStep): The prompts
+ *         of a successful conversation of @user for @action_id.
+ *
+ * Records the prompts @user just went through. A sequence of fewer than
+ * two prompts is not worth showing up front, it forgets what was
+ * recorded before instead.
+ **/
+void
+polkit_mate_prompt_sequences_remember (PolkitMatePromptSequences *sequences,
+                                       const gchar                *user,
+                                       const gchar                *action_id,
+                                       GPtrArray                  *steps)
+{
+  Entry *entry;
+  gchar *key;
+
+  key = get_key (user, action_id);
+  if (steps->len < 2)
+    {
+      /* the stack went back to a single prompt */
+      g_hash_table_remove (sequences->entries, key);
+      g_ptr_array_unref (steps);
+      g_free (key);
+      return;
+    }
+
+  if (!g_hash_table_contains (sequences->entries, key) &&
+      g_hash_table_size (sequences->entries) >= sequences->max_entries)
+    evict_least_recently_used (sequences);
+
+  entry = g_new0 (Entry, 1);
+  entry->steps = steps;
+  entry->used = g_get_monotonic_time ();
+  g_hash_table_replace (sequences->entries, key, entry);
+}
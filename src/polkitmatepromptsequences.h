@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __POLKIT_MATE_PROMPT_SEQUENCES_H
+#define __POLKIT_MATE_PROMPT_SEQUENCES_H
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _PolkitMatePromptSequences PolkitMatePromptSequences;
+typedef struct _PolkitMatePromptStep PolkitMatePromptStep;
+
+/**
+ * PolkitMatePromptStep:
+ * @request: What PAM asked.
+ * @echo_on: Whether the answer may be shown as it is typed.
+ *
+ * One prompt of a PAM conversation.
+ **/
+struct _PolkitMatePromptStep
+{
+  gchar *request;
+  gboolean echo_on;
+};
+
+PolkitMatePromptStep      *polkit_mate_prompt_step_new             (const gchar                *request,
+                                                                    gboolean                    echo_on);
+void                       polkit_mate_prompt_step_free            (PolkitMatePromptStep      *step);
+
+PolkitMatePromptSequences *polkit_mate_prompt_sequences_new        (guint                       max_entries);
+PolkitMatePromptSequences *polkit_mate_prompt_sequences_ref        (PolkitMatePromptSequences *sequences);
+void                       polkit_mate_prompt_sequences_unref      (PolkitMatePromptSequences *sequences);
+GPtrArray                 *polkit_mate_prompt_sequences_lookup     (PolkitMatePromptSequences *sequences,
+                                                                    const gchar                *user,
+                                                                    const gchar                *action_id);
+void                       polkit_mate_prompt_sequences_remember   (PolkitMatePromptSequences *sequences,
+                                                                    const gchar                *user,
+                                                                    const gchar                *action_id,
+                                                                    GPtrArray                  *steps);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __POLKIT_MATE_PROMPT_SEQUENCES_H */
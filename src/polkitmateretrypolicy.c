@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "polkitmateretrypolicy.h"
+
+/* An immutable description of how often a failed authentication may be
+ * retried and how long to wait before each retry. Authenticators keep a
+ * reference to the policy that was in effect when they were created. */
+
+struct _PolkitMateRetryPolicy
+{
+  gint ref_count;
+
+  guint max_attempts;
+  guint initial_backoff;
+  guint max_backoff;
+};
+
+/**
+ * polkit_mate_retry_policy_new:
+ * @max_attempts: How many attempts the user gets in total, at least 1.
+ * @initial_backoff: Milliseconds to wait before the first retry, 0 for none.
+ * @max_backoff: Upper bound in milliseconds for the wait, which doubles
+ *               with every further failure.
+ *
+ * Creates a new retry policy.
+ *
+ * Returns: A new #PolkitMateRetryPolicy, free with polkit_mate_retry_policy_unref().
+ **/
+PolkitMateRetryPolicy *
+polkit_mate_retry_policy_new (guint max_attempts,
+                              guint initial_backoff,
+                              guint max_backoff)
+{
+  PolkitMateRetryPolicy *policy;
+
+  policy = g_new0 (PolkitMateRetryPolicy, 1);
+  policy->ref_count = 1;
+  policy->max_attempts = MAX (max_attempts, 1);
+  policy->initial_backoff = initial_backoff;
+  policy->max_backoff = MAX (max_backoff, initial_backoff);
+
+  return policy;
+}
+
+PolkitMateRetryPolicy *
+polkit_mate_retry_policy_ref (PolkitMateRetryPolicy *policy)
+{
+  g_atomic_int_inc (&policy->ref_count);
+  return policy;
+}
+
+void
+polkit_mate_retry_policy_unref (PolkitMateRetryPolicy *policy)
+{
+  if (g_atomic_int_dec_and_test (&policy->ref_count))
+    g_free (policy);
+}
+
+/**
+ * polkit_mate_retry_policy_should_retry:
+ * @policy: A #PolkitMateRetryPolicy.
+ * @failures: How many attempts have failed so far.
+ *
+ * Returns: %TRUE if the user gets another attempt.
+ **/
+gboolean
+polkit_mate_retry_policy_should_retry (PolkitMateRetryPolicy *policy,
+                                       guint                   failures)
+{
+  return failures < policy->max_attempts;
+}
+
+/**
+ * polkit_mate_retry_policy_get_backoff:
+ * @policy: A #PolkitMateRetryPolicy.
+ * @failures: How many attempts have failed so far, at least 1.
+ *
+ * Returns: Milliseconds to wait before prompting again.
+ **/
+guint
+polkit_mate_retry_policy_get_backoff (PolkitMateRetryPolicy *policy,
+                                      guint                   failures)
+{
+  guint backoff;
+  guint n;
+
+  if (policy->initial_backoff == 0 || failures == 0)
+    return 0;
+
+  backoff = policy->initial_backoff;
+  for (n = 1; n < failures && backoff < policy->max_backoff; n++)
+    backoff = MIN (backoff * 2, policy->max_backoff);
+
+  return backoff;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __POLKIT_MATE_RETRY_POLICY_H
+#define __POLKIT_MATE_RETRY_POLICY_H
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _PolkitMateRetryPolicy PolkitMateRetryPolicy;
+
+PolkitMateRetryPolicy *polkit_mate_retry_policy_new          (guint                   max_attempts,
+                                                              guint                   initial_backoff,
+                                                              guint                   max_backoff);
+PolkitMateRetryPolicy *polkit_mate_retry_policy_ref          (PolkitMateRetryPolicy *policy);
+void                   polkit_mate_retry_policy_unref        (PolkitMateRetryPolicy *policy);
+gboolean               polkit_mate_retry_policy_should_retry (PolkitMateRetryPolicy *policy,
+                                                              guint                   failures);
+guint                  polkit_mate_retry_policy_get_backoff  (PolkitMateRetryPolicy *policy,
+                                                              guint                   failures);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __POLKIT_MATE_RETRY_POLICY_H */
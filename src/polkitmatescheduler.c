@@ -0,0 +1,450 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "polkitmatescheduler.h"
+
+/* Entries are queued per group, e.g. per subject, in a binary min-heap
+ * ordered by deadline, then by arrival. A second heap holds the groups
+ * that are not blocked and have entries, ordered by their most urgent
+ * entry, so taking the most urgent entry of any unblocked group costs
+ * O(log n) no matter how many entries of blocked groups wait. Entries and
+ * groups know their position in their heap so that any of them can be
+ * removed in O(log n), e.g. when a queued request is cancelled. */
+
+#define NOT_IN_HEAP G_MAXUINT
+
+typedef struct _Group Group;
+
+struct _PolkitMateSchedulerEntry
+{
+  /* position in the heap of the group; must come first, see HEAP_INDEX() */
+  guint index;
+
+  gpointer data;
+  gint64 deadline;
+  guint64 seqnum;
+  Group *group;
+};
+
+struct _Group
+{
+  /* position in the heap of groups, or NOT_IN_HEAP; must come first */
+  guint index;
+
+  gchar *name;
+  GPtrArray *entries;
+  gboolean blocked;
+};
+
+struct _PolkitMateScheduler
+{
+  /* Group, those with entries that are not blocked */
+  GPtrArray *heap;
+
+  /* name -> Group, those with entries or blocked */
+  GHashTable *groups;
+
+  guint length;
+  guint64 next_seqnum;
+};
+
+typedef gboolean (*BeforeFunc) (gconstpointer a,
+                                gconstpointer b);
+
+#define HEAP_INDEX(item) (*(guint *) (item))
+
+static gboolean
+entry_before (gconstpointer a,
+              gconstpointer b)
+{
+  const PolkitMateSchedulerEntry *entry_a = a;
+  const PolkitMateSchedulerEntry *entry_b = b;
+
+  if (entry_a->deadline != entry_b->deadline)
+    return entry_a->deadline < entry_b->deadline;
+  return entry_a->seqnum < entry_b->seqnum;
+}
+
+static gboolean
+group_before (gconstpointer a,
+              gconstpointer b)
+{
+  const Group *group_a = a;
+  const Group *group_b = b;
+
+  return entry_before (g_ptr_array_index (group_a->entries, 0),
+                       g_ptr_array_index (group_b->entries, 0));
+}
+
+static void
+heap_set (GPtrArray *heap,
+          guint      i,
+          gpointer   item)
+{
+  g_ptr_array_index (heap, i) = item;
+  HEAP_INDEX (item) = i;
+}
+
+static void
+sift_up (GPtrArray  *heap,
+         BeforeFunc  before,
+         guint       i)
+{
+  gpointer item = g_ptr_array_index (heap, i);
+
+  while (i > 0)
+    {
+      guint parent = (i - 1) / 2;
+
+      if (!before (item, g_ptr_array_index (heap, parent)))
+        break;
+      heap_set (heap, i, g_ptr_array_index (heap, parent));
+      i = parent;
+    }
+  heap_set (heap, i, item);
+}
+
+static void
+sift_down (GPtrArray  *heap,
+           BeforeFunc  before,
+           guint       i)
+{
+  gpointer item = g_ptr_array_index (heap, i);
+  guint len = heap->len;
+
+  for (;;)
+    {
+      guint child = 2 * i + 1;
+
+      if (child >= len)
+        break;
+      if (child + 1 < len && before (g_ptr_array_index (heap, child + 1), g_ptr_array_index (heap, child)))
+        child++;
+      if (!before (g_ptr_array_index (heap, child), item))
+        break;
+      heap_set (heap, i, g_ptr_array_index (heap, child));
+      i = child;
+    }
+  heap_set (heap, i, item);
+}
+
+/* moves the item at @i to where it belongs after its key changed */
+static void
+heap_update (GPtrArray  *heap,
+             BeforeFunc  before,
+             guint       i)
+{
+  if (i > 0 && before (g_ptr_array_index (heap, i), g_ptr_array_index (heap, (i - 1) / 2)))
+    sift_up (heap, before, i);
+  else
+    sift_down (heap, before, i);
+}
+
+static void
+heap_insert (GPtrArray  *heap,
+             BeforeFunc  before,
+             gpointer    item)
+{
+  g_ptr_array_add (heap, item);
+  sift_up (heap, before, heap->len - 1);
+}
+
+static void
+heap_remove (GPtrArray  *heap,
+             BeforeFunc  before,
+             gpointer    item)
+{
+  guint i = HEAP_INDEX (item);
+  gpointer last;
+
+  HEAP_INDEX (item) = NOT_IN_HEAP;
+  last = g_ptr_array_remove_index (heap, heap->len - 1);
+  if (last == item)
+    return;
+
+  heap_set (heap, i, last);
+  heap_update (heap, before, i);
+}
+
+static Group *
+ensure_group (PolkitMateScheduler *scheduler,
+              const gchar         *name)
+{
+  Group *group;
+
+  group = g_hash_table_lookup (scheduler->groups, name);
+  if (group == NULL)
+    {
+      group = g_new0 (Group, 1);
+      group->index = NOT_IN_HEAP;
+      group->name = g_strdup (name);
+      group->entries = g_ptr_array_new ();
+      g_hash_table_insert (scheduler->groups, group->name, group);
+    }
+
+  return group;
+}
+
+static void
+group_free (Group *group)
+{
+  g_ptr_array_foreach (group->entries, (GFunc) g_free, NULL);
+  g_ptr_array_unref (group->entries);
+  g_free (group->name);
+  g_free (group);
+}
+
+static void
+maybe_drop_group (PolkitMateScheduler *scheduler,
+                  Group               *group)
+{
+  if (group->entries->len == 0 && !group->blocked)
+    g_hash_table_remove (scheduler->groups, group->name);
+}
+
+/* takes @entry out of the queue without freeing it */
+static void
+unlink_entry (PolkitMateScheduler      *scheduler,
+              PolkitMateSchedulerEntry *entry)
+{
+  Group *group = entry->group;
+  gboolean was_head;
+
+  was_head = entry->index == 0;
+  heap_remove (group->entries, entry_before, entry);
+  scheduler->length--;
+
+  if (group->index == NOT_IN_HEAP)
+    return;
+
+  if (group->entries->len == 0)
+    heap_remove (scheduler->heap, group_before, group);
+  else if (was_head)
+    heap_update (scheduler->heap, group_before, group->index);
+}
+
+/**
+ * polkit_mate_scheduler_new:
+ *
+ * Creates an empty queue that hands out entries earliest deadline first,
+ * and in order of insertion among equal deadlines.
+ *
+ * Returns: A new #PolkitMateScheduler, free with polkit_mate_scheduler_free().
+ **/
+PolkitMateScheduler *
+polkit_mate_scheduler_new (void)
+{
+  PolkitMateScheduler *scheduler;
+
+  scheduler = g_new0 (PolkitMateScheduler, 1);
+  scheduler->heap = g_ptr_array_new ();
+  scheduler->groups = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) group_free);
+
+  return scheduler;
+}
+
+/**
+ * polkit_mate_scheduler_free:
+ * @scheduler: A #PolkitMateScheduler.
+ *
+ * Frees @scheduler and all entries still queued. The data of the entries is
+ * not touched.
+ **/
+void
+polkit_mate_scheduler_free (PolkitMateScheduler *scheduler)
+{
+  g_ptr_array_unref (scheduler->heap);
+  g_hash_table_unref (scheduler->groups);
+  g_free (scheduler);
+}
+
+/**
+ * polkit_mate_scheduler_insert:
+ * @scheduler: A #PolkitMateScheduler.
+ * @data: The data to queue.
+ * @group: The group @data belongs to.
+ * @deadline: Monotonic time, as returned by g_get_monotonic_time(), by which
+ *            @data should be taken off the queue.
+ *
+ * Queues @data in O(log n).
+ *
+ * Returns: A handle that stays valid until @data is popped or removed.
+ **/
+PolkitMateSchedulerEntry *
+polkit_mate_scheduler_insert (PolkitMateScheduler *scheduler,
+                              gpointer             data,
+                              const gchar         *group,
+                              gint64               deadline)
+{
+  PolkitMateSchedulerEntry *entry;
+
+  entry = g_new0 (PolkitMateSchedulerEntry, 1);
+  entry->data = data;
+  entry->deadline = deadline;
+  entry->seqnum = scheduler->next_seqnum++;
+  entry->group = ensure_group (scheduler, group);
+
+  heap_insert (entry->group->entries, entry_before, entry);
+  scheduler->length++;
+
+  if (entry->group->blocked)
+    return entry;
+
+  if (entry->group->index == NOT_IN_HEAP)
+    heap_insert (scheduler->heap, group_before, entry->group);
+  else if (entry->index == 0)
+    heap_update (scheduler->heap, group_before, entry->group->index);
+
+  return entry;
+}
+
+/**
+ * polkit_mate_scheduler_remove:
+ * @scheduler: A #PolkitMateScheduler.
+ * @entry: A handle returned by polkit_mate_scheduler_insert().
+ *
+ * Removes @entry from the queue in O(log n) and frees it.
+ **/
+void
+polkit_mate_scheduler_remove (PolkitMateScheduler      *scheduler,
+                              PolkitMateSchedulerEntry *entry)
+{
+  Group *group = entry->group;
+
+  g_return_if_fail (entry->index < group->entries->len && g_ptr_array_index (group->entries, entry->index) == entry);
+
+  unlink_entry (scheduler, entry);
+  g_free (entry);
+  maybe_drop_group (scheduler, group);
+}
+
+/**
+ * polkit_mate_scheduler_pop:
+ * @scheduler: A #PolkitMateScheduler.
+ *
+ * Takes the most urgent entry of the groups that are not blocked off the
+ * queue in O(log n).
+ *
+ * Returns: The data of the entry, or %NULL if there is none.
+ **/
+gpointer
+polkit_mate_scheduler_pop (PolkitMateScheduler *scheduler)
+{
+  PolkitMateSchedulerEntry *entry;
+  Group *group;
+  gpointer data;
+
+  if (scheduler->heap->len == 0)
+    return NULL;
+
+  group = g_ptr_array_index (scheduler->heap, 0);
+  entry = g_ptr_array_index (group->entries, 0);
+  unlink_entry (scheduler, entry);
+
+  data = entry->data;
+  g_free (entry);
+  maybe_drop_group (scheduler, group);
+
+  return data;
+}
+
+/**
+ * polkit_mate_scheduler_set_group_blocked:
+ * @scheduler: A #PolkitMateScheduler.
+ * @group: The name of a group.
+ * @blocked: Whether polkit_mate_scheduler_pop() should pass over @group.
+ *
+ * Blocks or unblocks the entries of @group in O(log n). A group stays
+ * blocked, also for entries queued later, until it is unblocked.
+ **/
+void
+polkit_mate_scheduler_set_group_blocked (PolkitMateScheduler *scheduler,
+                                         const gchar         *group,
+                                         gboolean             blocked)
+{
+  Group *g;
+
+  if (blocked)
+    {
+      g = ensure_group (scheduler, group);
+      g->blocked = TRUE;
+      if (g->index != NOT_IN_HEAP)
+        heap_remove (scheduler->heap, group_before, g);
+      return;
+    }
+
+  g = g_hash_table_lookup (scheduler->groups, group);
+  if (g == NULL || !g->blocked)
+    return;
+
+  g->blocked = FALSE;
+  if (g->entries->len > 0)
+    heap_insert (scheduler->heap, group_before, g);
+  else
+    maybe_drop_group (scheduler, g);
+}
+
+/**
+ * polkit_mate_scheduler_steal_all:
+ * @scheduler: A #PolkitMateScheduler.
+ *
+ * Takes every entry, blocked or not, off the queue.
+ *
+ * Returns: (transfer container): The data of the entries, free the list with g_list_free().
+ **/
+GList *
+polkit_mate_scheduler_steal_all (PolkitMateScheduler *scheduler)
+{
+  GHashTableIter iter;
+  Group *group;
+  GList *ret;
+  guint n;
+
+  ret = NULL;
+  g_hash_table_iter_init (&iter, scheduler->groups);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &group))
+    {
+      for (n = 0; n < group->entries->len; n++)
+        {
+          PolkitMateSchedulerEntry *entry = g_ptr_array_index (group->entries, n);
+
+          ret = g_list_prepend (ret, entry->data);
+        }
+    }
+
+  g_ptr_array_set_size (scheduler->heap, 0);
+  g_hash_table_remove_all (scheduler->groups);
+  scheduler->length = 0;
+
+  return ret;
+}
+
+/**
+ * polkit_mate_scheduler_get_length:
+ * @scheduler: A #PolkitMateScheduler.
+ *
+ * Returns: The number of queued entries.
+ **/
+guint
+polkit_mate_scheduler_get_length (PolkitMateScheduler *scheduler)
+{
+  return scheduler->length;
+}
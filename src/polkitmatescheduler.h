@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __POLKIT_MATE_SCHEDULER_H
+#define __POLKIT_MATE_SCHEDULER_H
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _PolkitMateScheduler PolkitMateScheduler;
+typedef struct _PolkitMateSchedulerEntry PolkitMateSchedulerEntry;
+
+PolkitMateScheduler       *polkit_mate_scheduler_new               (void);
+void                       polkit_mate_scheduler_free              (PolkitMateScheduler       *scheduler);
+PolkitMateSchedulerEntry  *polkit_mate_scheduler_insert            (PolkitMateScheduler       *scheduler,
+                                                                    gpointer                   data,
+                                                                    const gchar               *group,
+                                                                    gint64                     deadline);
+void                       polkit_mate_scheduler_remove            (PolkitMateScheduler       *scheduler,
+                                                                    PolkitMateSchedulerEntry  *entry);
+gpointer                   polkit_mate_scheduler_pop               (PolkitMateScheduler       *scheduler);
+void                       polkit_mate_scheduler_set_group_blocked (PolkitMateScheduler       *scheduler,
+                                                                    const gchar               *group,
+                                                                    gboolean                   blocked);
+GList                     *polkit_mate_scheduler_steal_all         (PolkitMateScheduler       *scheduler);
+guint                      polkit_mate_scheduler_get_length        (PolkitMateScheduler       *scheduler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __POLKIT_MATE_SCHEDULER_H */
@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "polkitmatesecretbuffer.h"
+
+/* Passwords live in fixed-size slots of one arena that is locked into
+ * memory, so they never reach swap or core dumps and typing does not
+ * churn the general heap. A slot is wiped as soon as it is freed. The
+ * arena is only used from the main thread. */
+
+#define NUM_SLOTS 32
+
+static gchar *arena = NULL;
+static guint32 used_slots = 0;
+static gboolean arena_initialized = FALSE;
+
+static void
+ensure_arena (void)
+{
+  gsize size = NUM_SLOTS * POLKIT_MATE_SECRET_SIZE;
+  gpointer mem;
+
+  if (arena_initialized)
+    return;
+  arena_initialized = TRUE;
+
+  mem = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED)
+    {
+      g_warning ("Error allocating memory for passwords: %s", g_strerror (errno));
+      return;
+    }
+
+  /* still better than the heap if this fails, e.g. due to RLIMIT_MEMLOCK */
+  if (mlock (mem, size) != 0)
+    g_warning ("Error locking memory for passwords: %s", g_strerror (errno));
+#ifdef MADV_DONTDUMP
+  madvise (mem, size, MADV_DONTDUMP);
+#endif
+
+  arena = mem;
+}
+
+static gboolean
+is_in_arena (const gchar *secret)
+{
+  return arena != NULL && secret >= arena && secret < arena + NUM_SLOTS * POLKIT_MATE_SECRET_SIZE;
+}
+
+/**
+ * polkit_mate_secret_alloc:
+ *
+ * Allocates a zeroed block of %POLKIT_MATE_SECRET_SIZE bytes from the
+ * locked arena. Should the arena be exhausted the block comes from the
+ * heap instead.
+ *
+ * Returns: The block, free with polkit_mate_secret_free().
+ **/
+gchar *
+polkit_mate_secret_alloc (void)
+{
+  guint n;
+
+  ensure_arena ();
+
+  if (arena != NULL)
+    {
+      for (n = 0; n < NUM_SLOTS; n++)
+        {
+          if ((used_slots & (1U << n)) == 0)
+            {
+              used_slots |= 1U << n;
+              return arena + n * POLKIT_MATE_SECRET_SIZE;
+            }
+        }
+    }
+
+  return g_malloc0 (POLKIT_MATE_SECRET_SIZE);
+}
+
+/**
+ * polkit_mate_secret_dup:
+ * @text: A string.
+ *
+ * Copies @text into a block from polkit_mate_secret_alloc(), truncating
+ * it to %POLKIT_MATE_SECRET_SIZE - 1 bytes.
+ *
+ * Returns: The copy, free with polkit_mate_secret_free().
+ **/
+gchar *
+polkit_mate_secret_dup (const gchar *text)
+{
+  gchar *secret;
+
+  secret = polkit_mate_secret_alloc ();
+  g_strlcpy (secret, text, POLKIT_MATE_SECRET_SIZE);
+
+  return secret;
+}
+
+/**
+ * polkit_mate_secret_free:
+ * @secret: (allow-none): A block from polkit_mate_secret_alloc() or %NULL.
+ *
+ * Wipes @secret and returns it to the arena.
+ **/
+void
+polkit_mate_secret_free (gchar *secret)
+{
+  if (secret == NULL)
+    return;
+
+  memset (secret, 0, POLKIT_MATE_SECRET_SIZE);
+
+  if (is_in_arena (secret))
+    used_slots &= ~(1U << ((secret - arena) / POLKIT_MATE_SECRET_SIZE));
+  else
+    g_free (secret);
+}
+
+struct _PolkitMateSecretBuffer
+{
+  GtkEntryBuffer parent_instance;
+
+  /* one slot, always nul-terminated */
+  gchar *text;
+  gsize n_bytes;
+  guint n_chars;
+};
+
+struct _PolkitMateSecretBufferClass
+{
+  GtkEntryBufferClass parent_class;
+};
+
+G_DEFINE_TYPE (PolkitMateSecretBuffer, polkit_mate_secret_buffer, GTK_TYPE_ENTRY_BUFFER);
+
+static void
+polkit_mate_secret_buffer_init (PolkitMateSecretBuffer *buffer)
+{
+  buffer->text = polkit_mate_secret_alloc ();
+}
+
+static void
+polkit_mate_secret_buffer_finalize (GObject *object)
+{
+  PolkitMateSecretBuffer *buffer;
+
+  buffer = POLKIT_MATE_SECRET_BUFFER (object);
+
+  polkit_mate_secret_free (buffer->text);
+
+  if (G_OBJECT_CLASS (polkit_mate_secret_buffer_parent_class)->finalize != NULL)
+    G_OBJECT_CLASS (polkit_mate_secret_buffer_parent_class)->finalize (object);
+}
+
+static const gchar *
+polkit_mate_secret_buffer_get_text (GtkEntryBuffer *entry_buffer,
+                                    gsize          *n_bytes)
+{
+  PolkitMateSecretBuffer *buffer = POLKIT_MATE_SECRET_BUFFER (entry_buffer);
+
+  if (n_bytes != NULL)
+    *n_bytes = buffer->n_bytes;
+
+  return buffer->text;
+}
+
+static guint
+polkit_mate_secret_buffer_get_length (GtkEntryBuffer *entry_buffer)
+{
+  return POLKIT_MATE_SECRET_BUFFER (entry_buffer)->n_chars;
+}
+
+static guint
+polkit_mate_secret_buffer_insert_text (GtkEntryBuffer *entry_buffer,
+                                       guint           position,
+                                       const gchar    *chars,
+                                       guint           n_chars)
+{
+  PolkitMateSecretBuffer *buffer = POLKIT_MATE_SECRET_BUFFER (entry_buffer);
+  gsize n_bytes;
+  gsize at;
+
+  /* whatever does not fit into the slot is dropped */
+  n_bytes = g_utf8_offset_to_pointer (chars, n_chars) - chars;
+  while (n_chars > 0 && buffer->n_bytes + n_bytes >= POLKIT_MATE_SECRET_SIZE)
+    {
+      n_chars--;
+      n_bytes = g_utf8_offset_to_pointer (chars, n_chars) - chars;
+    }
+  if (n_chars == 0)
+    return 0;
+
+  at = g_utf8_offset_to_pointer (buffer->text, position) - buffer->text;
+  memmove (buffer->text + at + n_bytes, buffer->text + at, buffer->n_bytes - at);
+  memcpy (buffer->text + at, chars, n_bytes);
+  buffer->n_bytes += n_bytes;
+  buffer->n_chars += n_chars;
+  buffer->text[buffer->n_bytes] = '\0';
+
+  gtk_entry_buffer_emit_inserted_text (entry_buffer, position, chars, n_chars);
+
+  return n_chars;
+}
+
+static guint
+polkit_mate_secret_buffer_delete_text (GtkEntryBuffer *entry_buffer,
+                                       guint           position,
+                                       guint           n_chars)
+{
+  PolkitMateSecretBuffer *buffer = POLKIT_MATE_SECRET_BUFFER (entry_buffer);
+  gsize start;
+  gsize end;
+
+  if (position > buffer->n_chars)
+    position = buffer->n_chars;
+  if (position + n_chars > buffer->n_chars)
+    n_chars = buffer->n_chars - position;
+  if (n_chars == 0)
+    return 0;
+
+  start = g_utf8_offset_to_pointer (buffer->text, position) - buffer->text;
+  end = g_utf8_offset_to_pointer (buffer->text, position + n_chars) - buffer->text;
+
+  /* moves the nul as well, then wipes what is left behind it */
+  memmove (buffer->text + start, buffer->text + end, buffer->n_bytes + 1 - end);
+  buffer->n_bytes -= end - start;
+  buffer->n_chars -= n_chars;
+  memset (buffer->text + buffer->n_bytes + 1, 0, end - start);
+
+  gtk_entry_buffer_emit_deleted_text (entry_buffer, position, n_chars);
+
+  return n_chars;
+}
+
+static void
+polkit_mate_secret_buffer_class_init (PolkitMateSecretBufferClass *klass)
+{
+  GObjectClass *gobject_class;
+  GtkEntryBufferClass *buffer_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  buffer_class = GTK_ENTRY_BUFFER_CLASS (klass);
+
+  gobject_class->finalize = polkit_mate_secret_buffer_finalize;
+
+  buffer_class->get_text = polkit_mate_secret_buffer_get_text;
+  buffer_class->get_length = polkit_mate_secret_buffer_get_length;
+  buffer_class->insert_text = polkit_mate_secret_buffer_insert_text;
+  buffer_class->delete_text = polkit_mate_secret_buffer_delete_text;
+}
+
+/**
+ * polkit_mate_secret_buffer_new:
+ *
+ * Creates a #GtkEntryBuffer that keeps its text in the locked arena, see
+ * polkit_mate_secret_alloc(). It holds at most %POLKIT_MATE_SECRET_SIZE - 1
+ * bytes.
+ *
+ * Returns: A new #GtkEntryBuffer.
+ **/
+GtkEntryBuffer *
+polkit_mate_secret_buffer_new (void)
+{
+  return GTK_ENTRY_BUFFER (g_object_new (POLKIT_MATE_TYPE_SECRET_BUFFER, NULL));
+}
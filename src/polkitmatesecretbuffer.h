@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __POLKIT_MATE_SECRET_BUFFER_H
+#define __POLKIT_MATE_SECRET_BUFFER_H
+
+#include <gtk/gtk.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POLKIT_MATE_TYPE_SECRET_BUFFER          (polkit_mate_secret_buffer_get_type())
+#define POLKIT_MATE_SECRET_BUFFER(o)            (G_TYPE_CHECK_INSTANCE_CAST ((o), POLKIT_MATE_TYPE_SECRET_BUFFER, PolkitMateSecretBuffer))
+#define POLKIT_MATE_SECRET_BUFFER_CLASS(k)      (G_TYPE_CHECK_CLASS_CAST((k), POLKIT_MATE_TYPE_SECRET_BUFFER, PolkitMateSecretBufferClass))
+#define POLKIT_MATE_SECRET_BUFFER_GET_CLASS(o)  (G_TYPE_INSTANCE_GET_CLASS ((o), POLKIT_MATE_TYPE_SECRET_BUFFER, PolkitMateSecretBufferClass))
+#define POLKIT_MATE_IS_SECRET_BUFFER(o)         (G_TYPE_CHECK_INSTANCE_TYPE ((o), POLKIT_MATE_TYPE_SECRET_BUFFER))
+#define POLKIT_MATE_IS_SECRET_BUFFER_CLASS(k)   (G_TYPE_CHECK_CLASS_TYPE ((k), POLKIT_MATE_TYPE_SECRET_BUFFER))
+
+/* PAM_MAX_RESP_SIZE, including the terminating nul */
+#define POLKIT_MATE_SECRET_SIZE 512
+
+typedef struct _PolkitMateSecretBuffer PolkitMateSecretBuffer;
+typedef struct _PolkitMateSecretBufferClass PolkitMateSecretBufferClass;
+
+gchar          *polkit_mate_secret_alloc        (void);
+gchar          *polkit_mate_secret_dup          (const gchar *text);
+void            polkit_mate_secret_free         (gchar       *secret);
+
+GType           polkit_mate_secret_buffer_get_type (void) G_GNUC_CONST;
+GtkEntryBuffer *polkit_mate_secret_buffer_new      (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __POLKIT_MATE_SECRET_BUFFER_H */
@@ -0,0 +1,446 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "polkitmateuserhistory.h"
+
+/* Remembers which identity was last used successfully for an action and
+ * for a vendor, so that the dialog can preselect it and start the
+ * conversation for it right away. The history is kept in a key file in
+ * the user's cache directory, read in the background when the agent
+ * starts and written back in batches. */
+
+/* batch the writes of authentications finishing close together */
+#define SAVE_DELAY 10
+
+#define ACTIONS_GROUP "Actions"
+#define VENDORS_GROUP "Vendors"
+
+struct _PolkitMateUserHistory
+{
+  GObject parent_instance;
+
+  gchar *path;
+
+  /* action_id -> user, vendor -> user */
+  GHashTable *by_action;
+  GHashTable *by_vendor;
+
+  gboolean loaded;
+  guint save_id;
+
+  /* every snapshot taken for writing gets the next generation; the
+   * newest one on disk is protected by the save lock, older snapshots
+   * still waiting for it are dropped */
+  guint64 generation;
+  guint64 saved_generation;
+};
+
+typedef struct
+{
+  gchar *data;
+  guint64 generation;
+} Snapshot;
+
+struct _PolkitMateUserHistoryClass
+{
+  GObjectClass parent_class;
+};
+
+G_DEFINE_TYPE (PolkitMateUserHistory, polkit_mate_user_history, G_TYPE_OBJECT);
+
+/* serializes the writes of the file between threads */
+G_LOCK_DEFINE_STATIC (save);
+
+static void load (PolkitMateUserHistory *history);
+
+static GHashTable *
+new_table (void)
+{
+  return g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+}
+
+static void
+polkit_mate_user_history_init (PolkitMateUserHistory *history)
+{
+  history->path = g_build_filename (g_get_user_cache_dir (), "polkit-mate", "users.ini", NULL);
+  history->by_action = new_table ();
+  history->by_vendor = new_table ();
+}
+
+static void
+polkit_mate_user_history_finalize (GObject *object)
+{
+  PolkitMateUserHistory *history;
+
+  history = POLKIT_MATE_USER_HISTORY (object);
+
+  if (history->save_id > 0)
+    g_source_remove (history->save_id);
+  g_hash_table_unref (history->by_action);
+  g_hash_table_unref (history->by_vendor);
+  g_free (history->path);
+
+  if (G_OBJECT_CLASS (polkit_mate_user_history_parent_class)->finalize != NULL)
+    G_OBJECT_CLASS (polkit_mate_user_history_parent_class)->finalize (object);
+}
+
+static void
+polkit_mate_user_history_class_init (PolkitMateUserHistoryClass *klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = polkit_mate_user_history_finalize;
+}
+
+/**
+ * polkit_mate_user_history_get_default:
+ *
+ * Gets the history shared by the whole agent. The first call starts
+ * reading it from disk.
+ *
+ * Returns: (transfer none): A #PolkitMateUserHistory.
+ **/
+PolkitMateUserHistory *
+polkit_mate_user_history_get_default (void)
+{
+  static PolkitMateUserHistory *history = NULL;
+
+  if (history == NULL)
+    {
+      history = POLKIT_MATE_USER_HISTORY (g_object_new (POLKIT_MATE_TYPE_USER_HISTORY, NULL));
+      load (history);
+    }
+
+  return history;
+}
+
+/* vendor names are free-form, key file keys are not */
+static gchar *
+escape_key (const gchar *key)
+{
+  return g_uri_escape_string (key, NULL, FALSE);
+}
+
+static void
+read_group (GKeyFile    *key_file,
+            const gchar *group,
+            GHashTable  *table)
+{
+  gchar **keys;
+  guint n;
+
+  keys = g_key_file_get_keys (key_file, group, NULL, NULL);
+  if (keys == NULL)
+    return;
+
+  for (n = 0; keys[n] != NULL; n++)
+    {
+      gchar *user;
+
+      user = g_key_file_get_string (key_file, group, keys[n], NULL);
+      if (user != NULL)
+        g_hash_table_replace (table, g_uri_unescape_string (keys[n], NULL), user);
+    }
+  g_strfreev (keys);
+}
+
+static void
+load_thread_func (GTask        *task,
+                  gpointer      source_object,
+                  gpointer      task_data,
+                  GCancellable *cancellable)
+{
+  GKeyFile *key_file;
+  GPtrArray *tables;
+
+  tables = g_ptr_array_new_with_free_func ((GDestroyNotify) g_hash_table_unref);
+  g_ptr_array_add (tables, new_table ());
+  g_ptr_array_add (tables, new_table ());
+
+  /* a missing or broken file just starts over */
+  key_file = g_key_file_new ();
+  if (g_key_file_load_from_file (key_file, task_data, G_KEY_FILE_NONE, NULL))
+    {
+      read_group (key_file, ACTIONS_GROUP, g_ptr_array_index (tables, 0));
+      read_group (key_file, VENDORS_GROUP, g_ptr_array_index (tables, 1));
+    }
+  g_key_file_free (key_file);
+
+  g_task_return_pointer (task, tables, (GDestroyNotify) g_ptr_array_unref);
+}
+
+static void
+merge_table (GHashTable *table,
+             GHashTable *loaded)
+{
+  GHashTableIter iter;
+  gchar *key;
+  gchar *user;
+
+  /* what was remembered while loading is newer */
+  g_hash_table_iter_init (&iter, loaded);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &key, (gpointer *) &user))
+    {
+      if (!g_hash_table_contains (table, key))
+        g_hash_table_insert (table, g_strdup (key), g_strdup (user));
+    }
+}
+
+static void
+load_cb (GObject      *source_object,
+         GAsyncResult *res,
+         gpointer      user_data)
+{
+  PolkitMateUserHistory *history = POLKIT_MATE_USER_HISTORY (source_object);
+  GPtrArray *tables;
+
+  tables = g_task_propagate_pointer (G_TASK (res), NULL);
+  merge_table (history->by_action, g_ptr_array_index (tables, 0));
+  merge_table (history->by_vendor, g_ptr_array_index (tables, 1));
+  g_ptr_array_unref (tables);
+
+  history->loaded = TRUE;
+}
+
+static void
+load (PolkitMateUserHistory *history)
+{
+  GTask *task;
+
+  task = g_task_new (history, NULL, load_cb, NULL);
+  g_task_set_task_data (task, g_strdup (history->path), g_free);
+  g_task_run_in_thread (task, load_thread_func);
+  g_object_unref (task);
+}
+
+static void
+write_group (GKeyFile    *key_file,
+             const gchar *group,
+             GHashTable  *table)
+{
+  GHashTableIter iter;
+  const gchar *key;
+  const gchar *user;
+
+  g_hash_table_iter_init (&iter, table);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &key, (gpointer *) &user))
+    {
+      gchar *escaped;
+
+      escaped = escape_key (key);
+      g_key_file_set_string (key_file, group, escaped, user);
+      g_free (escaped);
+    }
+}
+
+static Snapshot *
+take_snapshot (PolkitMateUserHistory *history)
+{
+  GKeyFile *key_file;
+  Snapshot *snapshot;
+
+  key_file = g_key_file_new ();
+  write_group (key_file, ACTIONS_GROUP, history->by_action);
+  write_group (key_file, VENDORS_GROUP, history->by_vendor);
+
+  snapshot = g_new0 (Snapshot, 1);
+  snapshot->data = g_key_file_to_data (key_file, NULL, NULL);
+  snapshot->generation = ++history->generation;
+  g_key_file_free (key_file);
+
+  return snapshot;
+}
+
+static void
+snapshot_free (Snapshot *snapshot)
+{
+  g_free (snapshot->data);
+  g_free (snapshot);
+}
+
+static void
+save (PolkitMateUserHistory *history,
+      const Snapshot         *snapshot)
+{
+  gchar *dir;
+  GError *error;
+
+  G_LOCK (save);
+
+  /* a newer snapshot was written while this one waited */
+  if (snapshot->generation <= history->saved_generation)
+    goto out;
+
+  dir = g_path_get_dirname (history->path);
+  g_mkdir_with_parents (dir, 0700);
+  g_free (dir);
+
+  error = NULL;
+  if (!g_file_set_contents (history->path, snapshot->data, -1, &error))
+    {
+      g_warning ("Error saving user history: %s", error->message);
+      g_error_free (error);
+    }
+  history->saved_generation = snapshot->generation;
+
+ out:
+  G_UNLOCK (save);
+}
+
+/* whether a snapshot has been taken that is not on disk yet */
+static gboolean
+has_unsaved_snapshot (PolkitMateUserHistory *history)
+{
+  gboolean ret;
+
+  G_LOCK (save);
+  ret = history->saved_generation < history->generation;
+  G_UNLOCK (save);
+
+  return ret;
+}
+
+static void
+save_thread_func (GTask        *task,
+                  gpointer      source_object,
+                  gpointer      task_data,
+                  GCancellable *cancellable)
+{
+  PolkitMateUserHistory *history = POLKIT_MATE_USER_HISTORY (source_object);
+
+  save (history, task_data);
+  g_task_return_boolean (task, TRUE);
+}
+
+static gboolean
+on_save_timeout (gpointer user_data)
+{
+  PolkitMateUserHistory *history = POLKIT_MATE_USER_HISTORY (user_data);
+  GTask *task;
+
+  /* not before the old contents are in, or they would be lost */
+  if (!history->loaded)
+    return TRUE;
+
+  history->save_id = 0;
+
+  task = g_task_new (history, NULL, NULL, NULL);
+  g_task_set_task_data (task, take_snapshot (history), (GDestroyNotify) snapshot_free);
+  g_task_run_in_thread (task, save_thread_func);
+  g_object_unref (task);
+
+  return FALSE;
+}
+
+/**
+ * polkit_mate_user_history_lookup:
+ * @history: A #PolkitMateUserHistory.
+ * @action_id: An action id.
+ * @vendor: (allow-none): The vendor of @action_id or %NULL.
+ *
+ * Looks up who last authenticated successfully for @action_id, or
+ * failing that for any action of @vendor. Until the history has been
+ * read from disk only what was remembered since is known.
+ *
+ * Returns: (allow-none): A user name owned by @history, or %NULL.
+ **/
+const gchar *
+polkit_mate_user_history_lookup (PolkitMateUserHistory *history,
+                                 const gchar            *action_id,
+                                 const gchar            *vendor)
+{
+  const gchar *user;
+
+  user = g_hash_table_lookup (history->by_action, action_id);
+  if (user == NULL && vendor != NULL)
+    user = g_hash_table_lookup (history->by_vendor, vendor);
+
+  return user;
+}
+
+/**
+ * polkit_mate_user_history_remember:
+ * @history: A #PolkitMateUserHistory.
+ * @action_id: An action id.
+ * @vendor: (allow-none): The vendor of @action_id or %NULL.
+ * @user: Who authenticated successfully for @action_id.
+ *
+ * Records @user as the identity to preselect for @action_id and @vendor.
+ * The history is written to disk a little later.
+ **/
+void
+polkit_mate_user_history_remember (PolkitMateUserHistory *history,
+                                   const gchar            *action_id,
+                                   const gchar            *vendor,
+                                   const gchar            *user)
+{
+  gboolean changed;
+
+  changed = g_strcmp0 (g_hash_table_lookup (history->by_action, action_id), user) != 0;
+  if (changed)
+    g_hash_table_replace (history->by_action, g_strdup (action_id), g_strdup (user));
+
+  if (vendor != NULL && g_strcmp0 (g_hash_table_lookup (history->by_vendor, vendor), user) != 0)
+    {
+      g_hash_table_replace (history->by_vendor, g_strdup (vendor), g_strdup (user));
+      changed = TRUE;
+    }
+
+  if (changed && history->save_id == 0)
+    history->save_id = g_timeout_add_seconds (SAVE_DELAY, on_save_timeout, history);
+}
+
+/**
+ * polkit_mate_user_history_flush:
+ * @history: A #PolkitMateUserHistory.
+ *
+ * Writes out changes not saved yet right away, e.g. when the agent exits.
+ * This includes changes a background save has not written yet; that
+ * save is then dropped.
+ **/
+void
+polkit_mate_user_history_flush (PolkitMateUserHistory *history)
+{
+  Snapshot *snapshot;
+
+  if (!history->loaded)
+    return;
+
+  if (history->save_id > 0)
+    {
+      g_source_remove (history->save_id);
+      history->save_id = 0;
+    }
+  else if (!has_unsaved_snapshot (history))
+    {
+      return;
+    }
+
+  /* supersedes any snapshot still waiting in a worker thread */
+  snapshot = take_snapshot (history);
+  save (history, snapshot);
+  snapshot_free (snapshot);
+}
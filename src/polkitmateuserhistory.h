@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __POLKIT_MATE_USER_HISTORY_H
+#define __POLKIT_MATE_USER_HISTORY_H
+
+#include <glib-object.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POLKIT_MATE_TYPE_USER_HISTORY          (polkit_mate_user_history_get_type())
+#define POLKIT_MATE_USER_HISTORY(o)            (G_TYPE_CHECK_INSTANCE_CAST ((o), POLKIT_MATE_TYPE_USER_HISTORY, PolkitMateUserHistory))
+#define POLKIT_MATE_USER_HISTORY_CLASS(k)      (G_TYPE_CHECK_CLASS_CAST((k), POLKIT_MATE_TYPE_USER_HISTORY, PolkitMateUserHistoryClass))
+#define POLKIT_MATE_USER_HISTORY_GET_CLASS(o)  (G_TYPE_INSTANCE_GET_CLASS ((o), POLKIT_MATE_TYPE_USER_HISTORY, PolkitMateUserHistoryClass))
+#define POLKIT_MATE_IS_USER_HISTORY(o)         (G_TYPE_CHECK_INSTANCE_TYPE ((o), POLKIT_MATE_TYPE_USER_HISTORY))
+#define POLKIT_MATE_IS_USER_HISTORY_CLASS(k)   (G_TYPE_CHECK_CLASS_TYPE ((k), POLKIT_MATE_TYPE_USER_HISTORY))
+
+typedef struct _PolkitMateUserHistory PolkitMateUserHistory;
+typedef struct _PolkitMateUserHistoryClass PolkitMateUserHistoryClass;
+
+GType                   polkit_mate_user_history_get_type    (void) G_GNUC_CONST;
+PolkitMateUserHistory *polkit_mate_user_history_get_default (void);
+const gchar            *polkit_mate_user_history_lookup      (PolkitMateUserHistory *history,
+                                                              const gchar            *action_id,
+                                                              const gchar            *vendor);
+void                    polkit_mate_user_history_remember    (PolkitMateUserHistory *history,
+                                                              const gchar            *action_id,
+                                                              const gchar            *vendor,
+                                                              const gchar            *user);
+void                    polkit_mate_user_history_flush       (PolkitMateUserHistory *history);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __POLKIT_MATE_USER_HISTORY_H */
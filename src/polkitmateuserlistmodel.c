@@ -0,0 +1,721 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include "config.h"
+
+#include <string.h>
+#include <glib/gi18n-lib.h>
+#include <cairo-gobject.h>
+
+#include "polkitmateuserlistmodel.h"
+#include "polkitmateavatarloader.h"
+#include "polkitmateidentityresolver.h"
+
+/* The users an authentication dialog offers, as a flat list sorted by
+ * name. polkitd may pass thousands of identities for a large admin group,
+ * so the list is built a chunk at a time from idle callbacks, each entry
+ * is a single small struct with its collation and search keys computed
+ * once, and pictures are only loaded for the rows a view actually asks
+ * for. Filtering walks the sorted array and reports the difference. */
+
+/* users added per main loop iteration; the first chunk is added right
+ * away so small lists are complete when the dialog is shown. Names come
+ * from the cache the authenticator filled off the main thread, what a
+ * chunk costs is collating, not NSS */
+#define CHUNK_SIZE 200
+
+typedef struct
+{
+  gchar *user;
+  gchar *text;
+  gchar *collation_key;
+  gchar *search_key;
+
+  /* NULL until loaded */
+  cairo_surface_t *icon;
+  gboolean icon_requested;
+} Entry;
+
+struct _PolkitMateUserListModel
+{
+  GObject parent_instance;
+
+  gint stamp;
+
+  gint icon_size;
+  gint icon_scale;
+  cairo_surface_t *placeholder;
+  GCancellable *cancellable;
+
+  /* every Entry resolved so far, sorted */
+  GPtrArray *entries;
+
+  /* the entries matching the filter, in the same order; these are the rows */
+  GPtrArray *rows;
+
+  /* normalized and casefolded, or NULL to show everyone */
+  gchar *filter;
+
+  /* users still to be resolved */
+  gchar **users;
+  guint next_user;
+  guint fill_id;
+};
+
+struct _PolkitMateUserListModelClass
+{
+  GObjectClass parent_class;
+};
+
+static void polkit_mate_user_list_model_tree_model_init (GtkTreeModelIface *iface);
+static guint find_row_position (PolkitMateUserListModel *model,
+                                const Entry              *entry);
+
+G_DEFINE_TYPE_WITH_CODE (PolkitMateUserListModel, polkit_mate_user_list_model, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL,
+                                                polkit_mate_user_list_model_tree_model_init));
+
+static void
+entry_free (Entry *entry)
+{
+  g_free (entry->user);
+  g_free (entry->text);
+  g_free (entry->collation_key);
+  g_free (entry->search_key);
+  if (entry->icon != NULL)
+    cairo_surface_destroy (entry->icon);
+  g_free (entry);
+}
+
+static gchar *
+get_search_key (const gchar *text)
+{
+  gchar *normalized;
+  gchar *key;
+
+  normalized = g_utf8_normalize (text, -1, G_NORMALIZE_ALL);
+  if (normalized == NULL)
+    return NULL;
+  key = g_utf8_casefold (normalized, -1);
+  g_free (normalized);
+
+  return key;
+}
+
+static Entry *
+entry_new (const gchar *user)
+{
+  PolkitMateUserInfo *info;
+  Entry *entry;
+  gchar *gecos;
+
+  /* never blocks; a user the authenticator did not resolve is listed by
+   * login name only */
+  info = polkit_mate_identity_resolver_lookup_name (polkit_mate_identity_resolver_get_default (), user);
+  gecos = info != NULL ? g_strdup (info->gecos) : NULL;
+  if (gecos != NULL && strlen (gecos) > 0)
+    {
+      gchar *first_comma;
+      first_comma = strchr (gecos, ',');
+      if (first_comma != NULL)
+        *first_comma = '\0';
+    }
+
+  entry = g_new0 (Entry, 1);
+  entry->user = g_strdup (user);
+  if (gecos != NULL && strlen (gecos) > 0 && strcmp (gecos, user) != 0)
+    entry->text = g_strdup_printf (_("%s (%s)"), gecos, user);
+  else
+    entry->text = g_strdup (user);
+  entry->collation_key = g_utf8_collate_key (entry->text, -1);
+  entry->search_key = get_search_key (entry->text);
+  if (entry->search_key == NULL)
+    entry->search_key = g_strdup (user);
+
+  g_free (gecos);
+  if (info != NULL)
+    polkit_mate_user_info_unref (info);
+
+  return entry;
+}
+
+static gint
+compare_entries (const Entry *a,
+                 const Entry *b)
+{
+  gint ret;
+
+  ret = strcmp (a->collation_key, b->collation_key);
+  if (ret == 0)
+    ret = strcmp (a->user, b->user);
+
+  return ret;
+}
+
+static gint
+compare_entries_indirect (gconstpointer a,
+                          gconstpointer b)
+{
+  return compare_entries (*(const Entry **) a, *(const Entry **) b);
+}
+
+static gboolean
+entry_matches (PolkitMateUserListModel *model,
+               const Entry              *entry)
+{
+  return model->filter == NULL || strstr (entry->search_key, model->filter) != NULL;
+}
+
+static void
+polkit_mate_user_list_model_init (PolkitMateUserListModel *model)
+{
+  model->stamp = g_random_int ();
+  model->entries = g_ptr_array_new_with_free_func ((GDestroyNotify) entry_free);
+  model->rows = g_ptr_array_new ();
+}
+
+static void
+polkit_mate_user_list_model_finalize (GObject *object)
+{
+  PolkitMateUserListModel *model;
+
+  model = POLKIT_MATE_USER_LIST_MODEL (object);
+
+  if (model->fill_id > 0)
+    g_source_remove (model->fill_id);
+  g_strfreev (model->users);
+  g_ptr_array_unref (model->rows);
+  g_ptr_array_unref (model->entries);
+  g_free (model->filter);
+  if (model->placeholder != NULL)
+    cairo_surface_destroy (model->placeholder);
+  if (model->cancellable != NULL)
+    g_object_unref (model->cancellable);
+
+  if (G_OBJECT_CLASS (polkit_mate_user_list_model_parent_class)->finalize != NULL)
+    G_OBJECT_CLASS (polkit_mate_user_list_model_parent_class)->finalize (object);
+}
+
+static void
+polkit_mate_user_list_model_class_init (PolkitMateUserListModelClass *klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = polkit_mate_user_list_model_finalize;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+set_iter (PolkitMateUserListModel *model,
+          GtkTreeIter              *iter,
+          guint                     n)
+{
+  iter->stamp = model->stamp;
+  iter->user_data = GUINT_TO_POINTER (n);
+}
+
+static void
+emit_row_inserted (PolkitMateUserListModel *model,
+                   guint                     n)
+{
+  GtkTreePath *path;
+  GtkTreeIter iter;
+
+  /* rows are addressed by position, so any change invalidates iters */
+  model->stamp++;
+  set_iter (model, &iter, n);
+  path = gtk_tree_path_new_from_indices (n, -1);
+  gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+  gtk_tree_path_free (path);
+}
+
+static void
+emit_row_deleted (PolkitMateUserListModel *model,
+                  guint                     n)
+{
+  GtkTreePath *path;
+
+  model->stamp++;
+  path = gtk_tree_path_new_from_indices (n, -1);
+  gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+  gtk_tree_path_free (path);
+}
+
+typedef struct
+{
+  PolkitMateUserListModel *model;
+  Entry *entry;
+} IconRequest;
+
+static void
+icon_loaded_cb (GObject      *source_object,
+                GAsyncResult *res,
+                gpointer      user_data)
+{
+  IconRequest *request = user_data;
+  PolkitMateUserListModel *model = request->model;
+  GError *error;
+  guint n;
+
+  error = NULL;
+  request->entry->icon = polkit_mate_avatar_loader_load_finish (POLKIT_MATE_AVATAR_LOADER (source_object),
+                                                                res,
+                                                                &error);
+  if (error != NULL)
+    g_error_free (error);
+
+  /* the row may have been filtered out meanwhile */
+  n = find_row_position (model, request->entry);
+  if (request->entry->icon != NULL &&
+      n < model->rows->len &&
+      g_ptr_array_index (model->rows, n) == request->entry)
+    {
+      GtkTreePath *path;
+      GtkTreeIter iter;
+
+      set_iter (model, &iter, n);
+      path = gtk_tree_path_new_from_indices (n, -1);
+      gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, &iter);
+      gtk_tree_path_free (path);
+    }
+
+  g_object_unref (model);
+  g_free (request);
+}
+
+static void
+request_icon (PolkitMateUserListModel *model,
+              Entry                    *entry)
+{
+  IconRequest *request;
+
+  entry->icon_requested = TRUE;
+
+  request = g_new0 (IconRequest, 1);
+  request->model = g_object_ref (model);
+  request->entry = entry;
+  polkit_mate_avatar_loader_load (polkit_mate_avatar_loader_get_default (),
+                                  entry->user,
+                                  model->icon_size,
+                                  model->icon_scale,
+                                  model->cancellable,
+                                  icon_loaded_cb,
+                                  request);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static GtkTreeModelFlags
+user_list_model_get_flags (GtkTreeModel *tree_model)
+{
+  return GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint
+user_list_model_get_n_columns (GtkTreeModel *tree_model)
+{
+  return POLKIT_MATE_USER_LIST_N_COLUMNS;
+}
+
+static GType
+user_list_model_get_column_type (GtkTreeModel *tree_model,
+                                 gint          index)
+{
+  switch (index)
+    {
+    case POLKIT_MATE_USER_LIST_COLUMN_ICON:
+      return CAIRO_GOBJECT_TYPE_SURFACE;
+    case POLKIT_MATE_USER_LIST_COLUMN_TEXT:
+    case POLKIT_MATE_USER_LIST_COLUMN_USER:
+      return G_TYPE_STRING;
+    default:
+      g_return_val_if_reached (G_TYPE_INVALID);
+    }
+}
+
+static gboolean
+user_list_model_iter_nth_child (GtkTreeModel *tree_model,
+                                GtkTreeIter  *iter,
+                                GtkTreeIter  *parent,
+                                gint          n)
+{
+  PolkitMateUserListModel *model = POLKIT_MATE_USER_LIST_MODEL (tree_model);
+
+  if (parent != NULL || n < 0 || (guint) n >= model->rows->len)
+    return FALSE;
+
+  set_iter (model, iter, n);
+  return TRUE;
+}
+
+static gboolean
+user_list_model_get_iter (GtkTreeModel *tree_model,
+                          GtkTreeIter  *iter,
+                          GtkTreePath  *path)
+{
+  if (gtk_tree_path_get_depth (path) != 1)
+    return FALSE;
+
+  return user_list_model_iter_nth_child (tree_model, iter, NULL, gtk_tree_path_get_indices (path)[0]);
+}
+
+static GtkTreePath *
+user_list_model_get_path (GtkTreeModel *tree_model,
+                          GtkTreeIter  *iter)
+{
+  PolkitMateUserListModel *model = POLKIT_MATE_USER_LIST_MODEL (tree_model);
+
+  g_return_val_if_fail (iter->stamp == model->stamp, NULL);
+
+  return gtk_tree_path_new_from_indices (GPOINTER_TO_UINT (iter->user_data), -1);
+}
+
+static void
+user_list_model_get_value (GtkTreeModel *tree_model,
+                           GtkTreeIter  *iter,
+                           gint          column,
+                           GValue       *value)
+{
+  PolkitMateUserListModel *model = POLKIT_MATE_USER_LIST_MODEL (tree_model);
+  Entry *entry;
+
+  g_return_if_fail (iter->stamp == model->stamp);
+
+  entry = g_ptr_array_index (model->rows, GPOINTER_TO_UINT (iter->user_data));
+
+  g_value_init (value, user_list_model_get_column_type (tree_model, column));
+  switch (column)
+    {
+    case POLKIT_MATE_USER_LIST_COLUMN_ICON:
+      /* only the rows that are looked at get their picture loaded */
+      if (!entry->icon_requested)
+        request_icon (model, entry);
+      g_value_set_boxed (value, entry->icon != NULL ? entry->icon : model->placeholder);
+      break;
+
+    case POLKIT_MATE_USER_LIST_COLUMN_TEXT:
+      g_value_set_string (value, entry->text);
+      break;
+
+    case POLKIT_MATE_USER_LIST_COLUMN_USER:
+      g_value_set_string (value, entry->user);
+      break;
+
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+static gboolean
+user_list_model_iter_next (GtkTreeModel *tree_model,
+                           GtkTreeIter  *iter)
+{
+  PolkitMateUserListModel *model = POLKIT_MATE_USER_LIST_MODEL (tree_model);
+  guint n;
+
+  g_return_val_if_fail (iter->stamp == model->stamp, FALSE);
+
+  n = GPOINTER_TO_UINT (iter->user_data) + 1;
+  if (n >= model->rows->len)
+    {
+      iter->stamp = 0;
+      return FALSE;
+    }
+
+  iter->user_data = GUINT_TO_POINTER (n);
+  return TRUE;
+}
+
+static gboolean
+user_list_model_iter_children (GtkTreeModel *tree_model,
+                               GtkTreeIter  *iter,
+                               GtkTreeIter  *parent)
+{
+  return user_list_model_iter_nth_child (tree_model, iter, parent, 0);
+}
+
+static gboolean
+user_list_model_iter_has_child (GtkTreeModel *tree_model,
+                                GtkTreeIter  *iter)
+{
+  return FALSE;
+}
+
+static gint
+user_list_model_iter_n_children (GtkTreeModel *tree_model,
+                                 GtkTreeIter  *iter)
+{
+  PolkitMateUserListModel *model = POLKIT_MATE_USER_LIST_MODEL (tree_model);
+
+  if (iter != NULL)
+    return 0;
+
+  return model->rows->len;
+}
+
+static gboolean
+user_list_model_iter_parent (GtkTreeModel *tree_model,
+                             GtkTreeIter  *iter,
+                             GtkTreeIter  *child)
+{
+  return FALSE;
+}
+
+static void
+polkit_mate_user_list_model_tree_model_init (GtkTreeModelIface *iface)
+{
+  iface->get_flags       = user_list_model_get_flags;
+  iface->get_n_columns   = user_list_model_get_n_columns;
+  iface->get_column_type = user_list_model_get_column_type;
+  iface->get_iter        = user_list_model_get_iter;
+  iface->get_path        = user_list_model_get_path;
+  iface->get_value       = user_list_model_get_value;
+  iface->iter_next       = user_list_model_iter_next;
+  iface->iter_children   = user_list_model_iter_children;
+  iface->iter_has_child  = user_list_model_iter_has_child;
+  iface->iter_n_children = user_list_model_iter_n_children;
+  iface->iter_nth_child  = user_list_model_iter_nth_child;
+  iface->iter_parent     = user_list_model_iter_parent;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* index of the first row sorting after @entry */
+static guint
+find_row_position (PolkitMateUserListModel *model,
+                   const Entry              *entry)
+{
+  guint lo, hi;
+
+  lo = 0;
+  hi = model->rows->len;
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+
+      if (compare_entries (g_ptr_array_index (model->rows, mid), entry) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  return lo;
+}
+
+static void
+resolve_chunk (PolkitMateUserListModel *model)
+{
+  GPtrArray *chunk;
+  GPtrArray *merged;
+  guint i, j, n;
+
+  chunk = g_ptr_array_new ();
+  for (n = 0; n < CHUNK_SIZE && model->users[model->next_user] != NULL; n++)
+    g_ptr_array_add (chunk, entry_new (model->users[model->next_user++]));
+  g_ptr_array_sort (chunk, compare_entries_indirect);
+
+  /* merge rather than insert one by one, the list may be long */
+  merged = g_ptr_array_new_full (model->entries->len + chunk->len, (GDestroyNotify) entry_free);
+  for (i = 0, j = 0; i < model->entries->len || j < chunk->len; )
+    {
+      if (j == chunk->len ||
+          (i < model->entries->len &&
+           compare_entries (g_ptr_array_index (model->entries, i), g_ptr_array_index (chunk, j)) < 0))
+        g_ptr_array_add (merged, g_ptr_array_index (model->entries, i++));
+      else
+        g_ptr_array_add (merged, g_ptr_array_index (chunk, j++));
+    }
+  g_ptr_array_set_free_func (model->entries, NULL);
+  g_ptr_array_unref (model->entries);
+  model->entries = merged;
+
+  for (n = 0; n < chunk->len; n++)
+    {
+      Entry *entry = g_ptr_array_index (chunk, n);
+      guint position;
+
+      if (!entry_matches (model, entry))
+        continue;
+
+      position = find_row_position (model, entry);
+      g_ptr_array_insert (model->rows, position, entry);
+      emit_row_inserted (model, position);
+    }
+
+  g_ptr_array_unref (chunk);
+}
+
+static gboolean
+fill_idle_cb (gpointer user_data)
+{
+  PolkitMateUserListModel *model = POLKIT_MATE_USER_LIST_MODEL (user_data);
+
+  /* nobody is going to look at the rest */
+  if (model->cancellable != NULL && g_cancellable_is_cancelled (model->cancellable))
+    {
+      model->fill_id = 0;
+      return G_SOURCE_REMOVE;
+    }
+
+  resolve_chunk (model);
+  if (model->users[model->next_user] != NULL)
+    return G_SOURCE_CONTINUE;
+
+  model->fill_id = 0;
+  return G_SOURCE_REMOVE;
+}
+
+/**
+ * polkit_mate_user_list_model_new:
+ * @users: The login names to list.
+ * @icon_size: The size of the pictures in application pixels.
+ * @icon_scale: The scale factor of the device the pictures are shown on.
+ * @cancellable: (allow-none): Stops filling the list and loading pictures when cancelled.
+ *
+ * Creates a list of @users sorted by the name shown for them. The first
+ * users are listed right away, the rest are added when the main loop is
+ * idle.
+ *
+ * Returns: A new #PolkitMateUserListModel.
+ **/
+PolkitMateUserListModel *
+polkit_mate_user_list_model_new (gchar        **users,
+                                 gint           icon_size,
+                                 gint           icon_scale,
+                                 GCancellable  *cancellable)
+{
+  PolkitMateUserListModel *model;
+
+  model = POLKIT_MATE_USER_LIST_MODEL (g_object_new (POLKIT_MATE_TYPE_USER_LIST_MODEL, NULL));
+
+  model->icon_size = icon_size;
+  model->icon_scale = icon_scale;
+  if (cancellable != NULL)
+    model->cancellable = g_object_ref (cancellable);
+
+  /* shown until the picture of a user has been loaded, or if there is none */
+  model->placeholder = gtk_icon_theme_load_surface (gtk_icon_theme_get_default (),
+                                                    "stock_person",
+                                                    icon_size,
+                                                    icon_scale,
+                                                    NULL,
+                                                    0,
+                                                    NULL);
+
+  model->users = g_strdupv (users);
+  resolve_chunk (model);
+  if (model->users[model->next_user] != NULL)
+    model->fill_id = g_idle_add (fill_idle_cb, model);
+
+  return model;
+}
+
+/**
+ * polkit_mate_user_list_model_set_filter:
+ * @model: A #PolkitMateUserListModel.
+ * @text: (allow-none): Text to look for, or %NULL.
+ *
+ * Limits the rows to users whose name or login name contains @text,
+ * ignoring case. Users still being added are filtered as they arrive.
+ * Every row that disappears or appears is reported, so for a large list
+ * it is faster to detach @model from its view while changing the filter.
+ **/
+void
+polkit_mate_user_list_model_set_filter (PolkitMateUserListModel *model,
+                                        const gchar              *text)
+{
+  gchar *filter;
+  guint i, j;
+
+  filter = text != NULL && text[0] != '\0' ? get_search_key (text) : NULL;
+  if (g_strcmp0 (filter, model->filter) == 0)
+    {
+      g_free (filter);
+      return;
+    }
+  g_free (model->filter);
+  model->filter = filter;
+
+  /* drop the rows no longer matching, from the end so the positions of
+   * those before stay the same */
+  for (i = model->rows->len; i-- > 0; )
+    {
+      if (!entry_matches (model, g_ptr_array_index (model->rows, i)))
+        {
+          g_ptr_array_remove_index (model->rows, i);
+          emit_row_deleted (model, i);
+        }
+    }
+
+  /* the rows left are in the order of the entries, so one pass over
+   * both finds where the newly matching ones go */
+  for (i = 0, j = 0; i < model->entries->len; i++)
+    {
+      Entry *entry = g_ptr_array_index (model->entries, i);
+
+      if (!entry_matches (model, entry))
+        continue;
+
+      if (j < model->rows->len && g_ptr_array_index (model->rows, j) == entry)
+        {
+          j++;
+          continue;
+        }
+
+      g_ptr_array_insert (model->rows, j, entry);
+      emit_row_inserted (model, j);
+      j++;
+    }
+}
+
+/**
+ * polkit_mate_user_list_model_find_user:
+ * @model: A #PolkitMateUserListModel.
+ * @user: A login name.
+ * @iter: (out): Return location for the row of @user.
+ *
+ * Looks for the row of @user.
+ *
+ * Returns: %TRUE if @iter was set, %FALSE if @user is not listed (yet) or
+ *          filtered out.
+ **/
+gboolean
+polkit_mate_user_list_model_find_user (PolkitMateUserListModel *model,
+                                       const gchar              *user,
+                                       GtkTreeIter              *iter)
+{
+  guint n;
+
+  for (n = 0; n < model->rows->len; n++)
+    {
+      Entry *entry = g_ptr_array_index (model->rows, n);
+
+      if (g_strcmp0 (entry->user, user) == 0)
+        {
+          set_iter (model, iter, n);
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __POLKIT_MATE_USER_LIST_MODEL_H
+#define __POLKIT_MATE_USER_LIST_MODEL_H
+
+#include <gtk/gtk.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POLKIT_MATE_TYPE_USER_LIST_MODEL          (polkit_mate_user_list_model_get_type())
+#define POLKIT_MATE_USER_LIST_MODEL(o)            (G_TYPE_CHECK_INSTANCE_CAST ((o), POLKIT_MATE_TYPE_USER_LIST_MODEL, PolkitMateUserListModel))
+#define POLKIT_MATE_USER_LIST_MODEL_CLASS(k)      (G_TYPE_CHECK_CLASS_CAST((k), POLKIT_MATE_TYPE_USER_LIST_MODEL, PolkitMateUserListModelClass))
+#define POLKIT_MATE_USER_LIST_MODEL_GET_CLASS(o)  (G_TYPE_INSTANCE_GET_CLASS ((o), POLKIT_MATE_TYPE_USER_LIST_MODEL, PolkitMateUserListModelClass))
+#define POLKIT_MATE_IS_USER_LIST_MODEL(o)         (G_TYPE_CHECK_INSTANCE_TYPE ((o), POLKIT_MATE_TYPE_USER_LIST_MODEL))
+#define POLKIT_MATE_IS_USER_LIST_MODEL_CLASS(k)   (G_TYPE_CHECK_CLASS_TYPE ((k), POLKIT_MATE_TYPE_USER_LIST_MODEL))
+
+typedef struct _PolkitMateUserListModel PolkitMateUserListModel;
+typedef struct _PolkitMateUserListModelClass PolkitMateUserListModelClass;
+
+enum
+{
+  POLKIT_MATE_USER_LIST_COLUMN_ICON,  /* cairo_surface_t */
+  POLKIT_MATE_USER_LIST_COLUMN_TEXT,  /* gchararray, the name to show */
+  POLKIT_MATE_USER_LIST_COLUMN_USER,  /* gchararray, the login name */
+  POLKIT_MATE_USER_LIST_N_COLUMNS
+};
+
+GType                     polkit_mate_user_list_model_get_type    (void) G_GNUC_CONST;
+PolkitMateUserListModel *polkit_mate_user_list_model_new         (gchar                   **users,
+                                                                   gint                      icon_size,
+                                                                   gint                      icon_scale,
+                                                                   GCancellable             *cancellable);
+void                      polkit_mate_user_list_model_set_filter  (PolkitMateUserListModel  *model,
+                                                                   const gchar              *text);
+gboolean                  polkit_mate_user_list_model_find_user   (PolkitMateUserListModel  *model,
+                                                                   const gchar              *user,
+                                                                   GtkTreeIter              *iter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __POLKIT_MATE_USER_LIST_MODEL_H */
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include "config.h"
+
+#include <gtk/gtk.h>
+
+#include "polkitmatewarmup.h"
+#include "polkitmateauthenticationdialog.h"
+
+/* Everything the first dialog of a session would otherwise pay for on the
+ * spot: loading the icon theme and decoding its icons, parsing the theme
+ * CSS, and loading and shaping the fonts. Each step runs in an idle of
+ * its own at low priority, so a request arriving meanwhile is not held up
+ * by more than one step. */
+
+/* icons used by the dialog, with their size in pixels or as GtkIconSize */
+static const struct
+{
+  const gchar *name;
+  gint size;
+  gboolean is_icon_size;
+} warm_icons[] = {
+  { "dialog-password", 48,                    FALSE },  /* blended with the vendor icon */
+  { "dialog-password", GTK_ICON_SIZE_DIALOG,  TRUE },
+  { "stock_person",    16,                    FALSE },  /* see fill_user_picker() */
+  { "process-stop",    GTK_ICON_SIZE_BUTTON,  TRUE },
+};
+
+/* markup in the styles the dialog uses */
+static const gchar *warm_markup[] = {
+  "<big><b>Authenticate</b></big>",
+  "An application is attempting to perform an action that requires privileges.",
+  "<small><b>Action:</b></small>",
+};
+
+/* looked up icons; the icon theme caches them for as long as we hold them */
+static GPtrArray *icon_infos = NULL;
+
+static guint step = 0;
+static gint64 busy_time = 0;
+static gint64 started = 0;
+
+static void
+warm_icon_theme (void)
+{
+  GtkIconTheme *icon_theme;
+  guint n;
+
+  icon_theme = gtk_icon_theme_get_default ();
+  icon_infos = g_ptr_array_new_with_free_func (g_object_unref);
+
+  for (n = 0; n < G_N_ELEMENTS (warm_icons); n++)
+    {
+      GtkIconInfo *info;
+      GdkPixbuf *pixbuf;
+      gint size;
+
+      size = warm_icons[n].size;
+      if (warm_icons[n].is_icon_size && !gtk_icon_size_lookup (size, &size, NULL))
+        continue;
+
+      info = gtk_icon_theme_lookup_icon (icon_theme, warm_icons[n].name, size, 0);
+      if (info == NULL)
+        continue;
+
+      pixbuf = gtk_icon_info_load_icon (info, NULL);
+      if (pixbuf != NULL)
+        g_object_unref (pixbuf);
+      g_ptr_array_add (icon_infos, info);
+    }
+}
+
+static void
+warm_fonts (void)
+{
+  PangoContext *context;
+  PangoLayout *layout;
+  guint n;
+
+  context = gdk_pango_context_get ();
+  layout = pango_layout_new (context);
+  for (n = 0; n < G_N_ELEMENTS (warm_markup); n++)
+    {
+      pango_layout_set_markup (layout, warm_markup[n], -1);
+      pango_layout_get_pixel_size (layout, NULL, NULL);
+    }
+  g_object_unref (layout);
+  g_object_unref (context);
+}
+
+static void
+warm_dialog (void)
+{
+  /* resolves the theme CSS for every widget of the dialog */
+  polkit_mate_authentication_dialog_prepare_spare ();
+}
+
+static void (*const steps[]) (void) = {
+  warm_icon_theme,
+  warm_fonts,
+  warm_dialog,
+};
+
+static gboolean
+warmup_idle_cb (gpointer user_data)
+{
+  gint64 now;
+
+  now = g_get_monotonic_time ();
+  steps[step++] ();
+  busy_time += g_get_monotonic_time () - now;
+
+  if (step < G_N_ELEMENTS (steps))
+    return G_SOURCE_CONTINUE;
+
+  g_debug ("Warm-up took %.1f ms, finished %.1f ms after it was started",
+           busy_time / 1000.0,
+           (g_get_monotonic_time () - started) / 1000.0);
+
+  return G_SOURCE_REMOVE;
+}
+
+/**
+ * polkit_mate_warmup_start:
+ *
+ * Starts preparing, whenever the main loop is idle, the caches the first
+ * dialog would otherwise fill, and a spare dialog. Does nothing if called
+ * again.
+ **/
+void
+polkit_mate_warmup_start (void)
+{
+  if (started > 0)
+    return;
+
+  started = g_get_monotonic_time ();
+  g_idle_add_full (G_PRIORITY_LOW, warmup_idle_cb, NULL, NULL);
+}